@@ -42,7 +42,8 @@ dirs:
 objs/%.cpp objs/%.o objs/%.h: dirs
 
 clean:
-	/bin/rm -rf objs *~ $(EXAMPLE) $(EXAMPLE)-sse4 $(EXAMPLE)-generic16
+	/bin/rm -rf objs *~ $(EXAMPLE) $(EXAMPLE)-sse4 $(EXAMPLE)-generic16 \
+		$(EXAMPLE)-avx2x2 $(EXAMPLE)-avx512x2
 
 $(EXAMPLE): $(OBJS)
 	$(CXX) $(CXXFLAGS) -o $@ $^ $(LIBS)
@@ -79,6 +80,24 @@ objs/$(ISPC_SRC:.ispc=)_generic16.o: objs/$(ISPC_SRC:.ispc=)_generic16.cpp
 $(EXAMPLE)-generic16: $(CPP_OBJS) objs/$(ISPC_SRC:.ispc=)_generic16.o
 	$(CXX) $(CXXFLAGS) -o $@ $^ $(LIBS)
 
+objs/$(ISPC_SRC:.ispc=)_avx2x2.cpp: $(ISPC_SRC)
+	$(ISPC) $< -o $@ --target=generic-16 --emit-c++ --c++-include-file=avx2x2.h
+
+objs/$(ISPC_SRC:.ispc=)_avx2x2.o: objs/$(ISPC_SRC:.ispc=)_avx2x2.cpp
+	$(CXX) -I../intrinsics -mavx2 $< $(CXXFLAGS) -c -o $@
+
+$(EXAMPLE)-avx2x2: $(CPP_OBJS) objs/$(ISPC_SRC:.ispc=)_avx2x2.o
+	$(CXX) $(CXXFLAGS) -o $@ $^ $(LIBS)
+
+objs/$(ISPC_SRC:.ispc=)_avx512x2.cpp: $(ISPC_SRC)
+	$(ISPC) $< -o $@ --target=generic-32 --emit-c++ --c++-include-file=avx512x2.h
+
+objs/$(ISPC_SRC:.ispc=)_avx512x2.o: objs/$(ISPC_SRC:.ispc=)_avx512x2.cpp
+	$(CXX) -I../intrinsics -mavx512f -mavx512cd $< $(CXXFLAGS) -c -o $@
+
+$(EXAMPLE)-avx512x2: $(CPP_OBJS) objs/$(ISPC_SRC:.ispc=)_avx512x2.o
+	$(CXX) $(CXXFLAGS) -o $@ $^ $(LIBS)
+
 objs/$(ISPC_SRC:.ispc=)_scalar.o: $(ISPC_SRC)
 	$(ISPC) $< -o $@ --target=generic-1
 
@@ -38,8 +38,56 @@
 #include "algorithm.h"
 #include "stdio.h"
 #include "debug.h"
+#include <algorithm>
 
 
+/*===========================================================================*\
+|* Small dense helpers for block orthogonalization
+\*===========================================================================*/
+// A pivot of the Gram matrix below BLOCK_RANK_TOL times its diagonal entry
+// means a column lies (numerically) in the span of the ones before it.
+#define BLOCK_RANK_TOL 1e-12
+
+/* Cholesky factorization G = U^T U of the k x k symmetric G, both
+ * row-major, with U upper triangular.  Returns false if G is not
+ * numerically positive definite.
+ */
+static bool cholesky (const std::vector<double> &G, std::vector<double> &U, int k)
+{
+    std::fill(U.begin(), U.end(), 0.);
+    for (int i = 0; i < k; i++) {
+        double d = G[i*k + i];
+        for (int p = 0; p < i; p++)
+            d -= U[p*k + i] * U[p*k + i];
+        if (!(d > BLOCK_RANK_TOL * G[i*k + i]))
+            return false;
+        U[i*k + i] = sqrt(d);
+        for (int j = i + 1; j < k; j++) {
+            double t = G[i*k + j];
+            for (int p = 0; p < i; p++)
+                t -= U[p*k + i] * U[p*k + j];
+            U[i*k + j] = t / U[i*k + i];
+        }
+    }
+    return true;
+}
+
+/* Inverse of the k x k upper triangular U, row-major.
+ */
+static void upper_inverse (const std::vector<double> &U, std::vector<double> &Uinv, int k)
+{
+    std::fill(Uinv.begin(), Uinv.end(), 0.);
+    for (int j = 0; j < k; j++) {
+        Uinv[j*k + j] = 1 / U[j*k + j];
+        for (int i = j - 1; i >= 0; i--) {
+            double t = 0;
+            for (int p = i + 1; p <= j; p++)
+                t -= U[i*k + p] * Uinv[p*k + j];
+            Uinv[i*k + j] = t / U[i*k + i];
+        }
+    }
+}
+
 /*===========================================================================*\
 |* GMRES
 \*===========================================================================*/
@@ -47,25 +95,24 @@
  * ----------------------------
  * Given upper triangular matrix R and rhs vector b, solve for
  * x.  This "solve" ignores the rows, columns of R that are greater than the
- * dimensions of x.
+ * dimensions of x.  Column-oriented: once x[col] is known, column col of
+ * R (contiguous in the packed storage) is subtracted from the rest of the
+ * right-hand side in one pass.
  */
-void upper_triangular_right_solve (const DenseMatrix &R, const Vector &b, Vector &x) 
+void upper_triangular_right_solve (const HessenbergMatrix &R, const Vector &b, Vector &x) 
 {
     // Dimensionality check
     ASSERT(R.rows() >= b.size());
     ASSERT(R.cols() >= x.size());
     ASSERT(b.size() >= x.size());
 
-    int max_row = x.size() - 1;
+    for (int row = 0; row < x.size(); row++)
+        x[row] = b[row];
 
-    // first solve step:
-    x[max_row] = b[max_row] / R(max_row, max_row);
-
-    for (int row = max_row - 1; row >= 0; row--) {
-        double xi = b[row];
-        for (int col = max_row; col > row; col--)
-            xi -= x[col] * R(row, col);
-        x[row] = xi / R(row, row);
+    for (int col = x.size() - 1; col >= 0; col--) {
+        const double *r = R.column(col);
+        x[col] /= r[col];
+        ispc::vector_add_ax(&x[0], -x[col], r, col);
     }
 }
 
@@ -75,10 +122,11 @@ void upper_triangular_right_solve (const DenseMatrix &R, const Vector &b, Vector
  * factored Hessenburg matrix.  Note that the previous Givens rotations should be
  * applied to this column before creating a new rotation.
  */
-void create_rotation (const DenseMatrix &H, size_t col, Vector &Cn, Vector &Sn) 
+void create_rotation (const HessenbergMatrix &H, size_t col, Vector &Cn, Vector &Sn) 
 {
-    double a = H(col,     col);
-    double b = H(col + 1, col);
+    const double *h = H.column(col);
+    double a = h[col];
+    double b = h[col + 1];
     double r;
 
     if (b == 0) {
@@ -97,17 +145,18 @@ void create_rotation (const DenseMatrix &H, size_t col, Vector &Cn, Vector &Sn)
 }
 
 /* Applies the 'col'th Givens rotation stored in vectors Sn and Cn to the 'col'th 
- * column of the DenseMatrix M.  (Previous columns don't need the rotation applied b/c
+ * column of the HessenbergMatrix H.  (Previous columns don't need the rotation applied b/c
  * presumeably, the first col-1 columns are already upper triangular, and so their
  * entries in the col and col+1 rows are 0.)
  */
-void apply_rotation (DenseMatrix &H, size_t col, Vector &Cn, Vector &Sn) 
+void apply_rotation (HessenbergMatrix &H, size_t col, Vector &Cn, Vector &Sn) 
 {
+    double *h = H.column(col);
     double c = Cn[col];
     double s = Sn[col];
-    double tmp    = c * H(col, col) - s * H(col+1, col);
-    H(col+1, col) = s * H(col, col) + c * H(col+1, col);
-    H(col,   col) = tmp;
+    double tmp = c * h[col] - s * h[col+1];
+    h[col+1]   = s * h[col] + c * h[col+1];
+    h[col]     = tmp;
 }
 
 /* Applies the 'col'th Givens rotation to the vector.
@@ -127,15 +176,20 @@ void apply_rotation (Vector &v, size_t col, Vector &Cn, Vector &Sn)
 /* Applies the first 'col' Givens rotations to the newly-created column
  * of H.  (Leaves other columns alone.)
  */
-void update_column (DenseMatrix &H, size_t col, Vector &Cn, Vector &Sn) 
+void update_column (HessenbergMatrix &H, size_t col, Vector &Cn, Vector &Sn) 
 {
+    // Each rotation's output row feeds the next one, so carry it in a
+    // register down the (contiguous) column
+    double *h = H.column(col);
+    double top = h[0];
     for (int i = 0; i < col; i++) {
-        double c    = Cn[i];
-        double s    = Sn[i];
-        double t    = c * H(i,col) - s * H(i+1,col);
-        H(i+1, col) = s * H(i,col) + c * H(i+1,col);
-        H(i,   col) = t;
+        double c = Cn[i];
+        double s = Sn[i];
+        double b = h[i+1];
+        h[i]     = c * top - s * b;
+        top      = s * top + c * b;
     }
+    h[col] = top;
 }
 
 /* After a new column has been added to the hessenburg matrix, factor it back into
@@ -145,7 +199,7 @@ void update_column (DenseMatrix &H, size_t col, Vector &Cn, Vector &Sn)
  * - applying the new Givens rotation to the column, and
  * - applying the new Givens rotation to the solution vector
  */
-void update_qr_decomp (DenseMatrix &H, Vector &s, size_t col, Vector &Cn, Vector &Sn)
+void update_qr_decomp (HessenbergMatrix &H, Vector &s, size_t col, Vector &Cn, Vector &Sn)
 {
     update_column(  H, col, Cn, Sn);
     create_rotation(H, col, Cn, Sn);
@@ -153,79 +207,1164 @@ void update_qr_decomp (DenseMatrix &H, Vector &s, size_t col, Vector &Cn, Vector
     apply_rotation( s, col, Cn, Sn);
 }
 
-void gmres (const Matrix &A, const Vector &b, Vector &x, int num_iters, double max_err)  
+/* Orthogonalizes w against rows 0..k of Q, storing the projections in
+ * column k of H, and returns the norm of the result.  MGS makes one fused
+ * pass over w per basis vector, subtracting the projection on q_j while
+ * computing the one on q_j+1 (or, after the last, the norm); CGS2
+ * projects against the whole basis at once (h = Q w, w -= Q^T h) and
+ * repeats that once to recover the orthogonality MGS would give.  h is
+ * scratch space of at least k+1 entries, partial that of the reductions.
+ */
+static double orthogonalize (DenseMatrix &Q, int k, Vector &w,
+                             HessenbergMatrix &H, Orthogonalization method, 
+                             Vector &h, ReductionScratch *partial)
 {
-    DEBUG_PRINT("gmres starting!\n");
-    x.zero();
+    double *hcol = H.column(k);
+    if (method == ORTHOGONALIZE_MGS) {
+        Vector q(Q.row(0));
+        Vector q_next(Q.row(0));
+        hcol[0] = q.dot(w, partial);
+        for (int row = 0; row < k; row++) {
+            q_next.bind(Q.row(row + 1));
+            hcol[row + 1] = w.add_ax_dot(-hcol[row], q, q_next, partial);
+            q.bind(Q.row(row + 1));
+        }
+        return sqrt(w.add_ax_dot(-hcol[k], q, w, partial));
+    }
 
-    ASSERT(A.rows() == A.cols());
-    DenseMatrix Qstar(num_iters + 1, A.rows());
-    DenseMatrix H(num_iters + 1, num_iters);
+    Vector hk(h.view(0, k + 1));
+    ispc::zero(hcol, k + 1);
+    for (int pass = 0; pass < 2; pass++) {
+        Q.multiply_leading_rows(w, hk, partial);
+        Q.subtract_transpose_multiply_leading_rows(hk, w);
+        ispc::vector_add(hcol, &hk[0], k + 1);
+    }
+    return w.norm(partial);
+}
 
-    // arrays for storing parameters of givens rotations
-    Vector Sn(num_iters);
-    Vector Cn(num_iters);
+int arnoldi (const Matrix &A, const Vector &b, DenseMatrix &Q, HessenbergMatrix &H,
+             Orthogonalization method)
+{
+    int m = H.cols();
+    ASSERT(Q.rows() == m + 1);
 
-    // array for storing the rhs projected onto the hessenburg's column space
-    Vector G(num_iters+1);
-    G.zero();
+    Vector w(b.size());
+    Vector h(m + 1);
+    ReductionScratch partial;
+
+    w.copy(b);
+    w.normalize(&partial);
+    Q.set_row(0, w);
+
+    for (int k = 0; k < m; k++) {
+        A.multiply(Vector(Q.row(k)), w);
+        H(k+1, k) = orthogonalize(Q, k, w, H, method, h, &partial);
+        if (H(k+1, k) == 0)
+            return k + 1;
+        w.divide(H(k+1, k));
+        Q.set_row(k+1, w);
+    }
+    return m;
+}
 
-    double beta = b.norm();
-    G[0] = beta;
+double orthogonality_loss (const DenseMatrix &Q, int k)
+{
+    Vector h(k);
+    ReductionScratch partial;
+    double sum = 0;
 
-    // temp vector, stores Aqi
-    Vector w(A.rows());
+    for (int i = 0; i < k; i++) {
+        Q.multiply_leading_rows(Vector(Q.row(i)), h, &partial);
+        h[i] -= 1;
+        sum += h.dot(h, &partial);
+    }
+    return sqrt(sum);
+}
 
-    w.copy(b);
-    w.normalize();
+/* w = op(q), the operator GMRES builds its Krylov space from: A, M^-1 A
+ * (left preconditioning) or A M^-1 (right).  z is scratch space.
+ */
+static void apply_operator (const Matrix &A, const Preconditioner *M,
+                            PreconditionSide side, const Vector &q, 
+                            Vector &z, Vector &w)
+{
+    if (M == NULL)
+        A.multiply(q, w);
+    else if (side == PRECONDITION_LEFT) {
+        A.multiply(q, z);
+        M->apply(z, w);
+    }
+    else {
+        M->apply(q, z);
+        A.multiply(z, w);
+    }
+}
+
+/* One s-step block (communication-avoiding Arnoldi): from the last basis
+ * vector q_j (row j of Qstar), s products with the operator scaled by
+ * 1/scale fill rows j+1..j+s with a monomial basis v_1..v_s, which is
+ * then orthogonalized as a block by two passes of block CGS with Cholesky
+ * QR.  Each pass takes the inner products with the basis and the Gram
+ * matrix of the block in a single reduction, the latter corrected by
+ * Pythagoras (P P^T - C^T C), so the block costs 2 global reductions
+ * instead of the 3 (CGS2) or j+2 (MGS) per step of the standard process.
+ *
+ * With V = [q_j v_1 .. v_s] = Q B for the new basis Q, op V_0..s-1 =
+ * scale V_1..s turns into columns j..j+s-1 of H:
+ *     H(:, j..j+s-1) = (scale B_1..s - H(:, 0..j-1) B_top) T^-1
+ * where T (upper triangular) is rows j..j+s-1 of B_0..s-1 and B_top the
+ * rows above.  Hraw keeps H before the rotations, which this needs.  The
+ * columns are then triangularized one by one, stopping at convergence.
+ * partial is scratch for the reductions.  Returns the number of columns
+ * added, or 0 if the block was numerically rank deficient, leaving rows
+ * after j of Qstar undefined.
+ */
+static int sstep_block (const Matrix &A, const Preconditioner *M,
+                        PreconditionSide side, int s, int j,
+                        DenseMatrix &Qstar, HessenbergMatrix &Hraw, HessenbergMatrix &H,
+                        Vector &G, Vector &Cn, Vector &Sn, Vector &z,
+                        SStepScratch &scratch, ReductionScratch *partial,
+                        double &scale, double ref_norm, double max_err, 
+                        double &rel_err)
+{
+    for (int i = 1; i <= s; i++) {
+        Vector prev(Qstar.row(j + i - 1)), next(Qstar.row(j + i));
+        apply_operator(A, M, side, prev, z, next);
+        next.divide(scale);
+    }
+
+    // V_1..s = Q_0..j C + P R, P the orthonormalized rows j+1..j+s
+    int k = j + 1;
+    std::vector<double> &X = scratch.X, &C = scratch.C, &R = scratch.R, &RC = scratch.RC;
+    std::vector<double> &Gp = scratch.Gp, &U = scratch.U, &Uinv = scratch.Uinv;
+    std::vector<double> &L = scratch.L;
+    for (int pass = 0; pass < 2; pass++) {
+        Qstar.multiply_leading_rows_block(k + s, k, s, &X[0], partial);
+        Qstar.subtract_transpose_multiply_leading_rows_block(k, &X[0], k, s);
+
+        for (int p = 0; p < s; p++)
+            for (int q = 0; q < s; q++) {
+                double g = X[(k + p) * s + q];
+                for (int i = 0; i < k; i++)
+                    g -= X[i * s + p] * X[i * s + q];
+                Gp[p * s + q] = g;
+            }
+        for (int p = 0; p < s; p++)
+            if (!(Gp[p * s + p] > BLOCK_RANK_TOL * X[(k + p) * s + p]))
+                return 0;
+        if (!cholesky(Gp, U, s))
+            return 0;
+
+        // P = U^-T P
+        upper_inverse(U, Uinv, s);
+        for (int p = 0; p < s; p++)
+            for (int q = 0; q < s; q++)
+                L[p * s + q] = Uinv[q * s + p];
+        Qstar.lower_multiply_rows_block(&L[0], k, s);
+
+        // V = Q C1 + P1 U1 and P1 = Q C2 + P2 U2 give C = C1 + C2 U1,
+        // R = U2 U1
+        if (pass == 0) {
+            std::copy(X.begin(), X.begin() + k * s, C.begin());
+            std::copy(U.begin(), U.begin() + s * s, R.begin());
+        }
+        else {
+            for (int i = 0; i < k; i++)
+                for (int p = 0; p < s; p++) {
+                    double c = C[i * s + p];
+                    for (int q = 0; q <= p; q++)
+                        c += X[i * s + q] * R[q * s + p];
+                    RC[i * s + p] = c;
+                }
+            std::copy(RC.begin(), RC.begin() + k * s, C.begin());
+            for (int p = 0; p < s; p++)
+                for (int q = s - 1; q >= p; q--) {
+                    double t = 0;
+                    for (int l = p; l <= q; l++)
+                        t += U[p * s + l] * R[l * s + q];
+                    R[p * s + q] = t;
+                }
+        }
+    }
+
+    // B(i, c) for rows 0..j+s, columns 0..s
+#define B(i, c) ((c) == 0 ? ((i) == j ? 1. : 0.)                          \
+                 : (i) < k ? C[(i) * s + (c) - 1] : R[((i) - k) * s + (c) - 1])
+
+    // The new columns over all rows 0..j+s, row-major; only their part
+    // down to the subdiagonal (the rest vanishes in exact arithmetic) is
+    // kept in Hraw
+    std::vector<double> &Hnew = scratch.Hnew;
+    for (int i = 0; i <= j + s; i++) {
+        // row i of (scale B_1..s - H(:, 0..j-1) B_top) T^-1, by forward
+        // substitution over the columns
+        for (int c = 0; c < s; c++) {
+            double t = scale * B(i, c + 1);
+            for (int l = std::max(0, i - 1); l < j; l++)
+                t -= Hraw(i, l) * B(l, c);
+            for (int d = 0; d < c; d++)
+                t -= Hnew[i * s + d] * B(j + d, c);
+            Hnew[i * s + c] = t / B(j + c, c);
+        }
+    }
+#undef B
+    for (int c = 0; c < s; c++)
+        for (int i = 0; i <= j + c + 1; i++)
+            Hraw(i, j + c) = Hnew[i * s + c];
+
+    double max_norm = 0;
+    for (int c = 0; c < s; c++) {
+        int col = j + c;
+        std::copy(Hraw.column(col), Hraw.column(col) + col + 2, H.column(col));
+        max_norm = std::max(max_norm, sqrt(ispc::vector_dot(H.column(col), H.column(col),
+                                                            col + 2)));
+
+        update_qr_decomp(H, G, col, Cn, Sn);
+        rel_err = fabs(G[col + 1] / ref_norm);
+        if (rel_err < max_err)
+            return c + 1;
+    }
+
+    // |op q| for the next block, so its monomial basis neither grows nor
+    // shrinks geometrically
+    if (max_norm > 0)
+        scale = max_norm;
+    return s;
+}
+
+/* One GMRES(m) cycle: builds a Krylov basis of at most Qstar.rows()-1
+ * vectors starting from the (preconditioned, for left preconditioning)
+ * residual r, and adds the resulting correction to x.  Qstar, H, Cn, Sn,
+ * G, y, w, z, h and partial (for the reductions) are scratch space that
+ * the caller reuses across cycles.
+ * With s > 1 the basis is built s vectors at a time by sstep_block(),
+ * with Hraw and block as its scratch and scale carried over between cycles (0 until
+ * a first standard step has estimated |op|); if a block turns out rank
+ * deficient the rest of the cycle falls back to one vector at a time.
+ * Returns the number of Arnoldi steps taken and leaves the estimated
+ * residual, relative to ref_norm, in rel_err.
+ */
+static int gmres_cycle (const Matrix &A, const Preconditioner *M,
+                        PreconditionSide side, Orthogonalization method,
+                        const Vector &r, Vector &x, 
+                        double ref_norm, int max_steps, double max_err,
+                        DenseMatrix &Qstar, HessenbergMatrix &H, 
+                        Vector &Cn, Vector &Sn, Vector &G, Vector &y, 
+                        Vector &w, Vector &z, Vector &h, 
+                        ReductionScratch *partial, int s, 
+                        HessenbergMatrix *Hraw, SStepScratch &block,
+                        double &scale, double &rel_err)
+{
+    int m = H.cols();
+    if (max_steps > m)
+        max_steps = m;
+
+    G.zero();
+    G[0] = r.norm(partial);
+
+    w.copy(r);
+    w.divide(G[0]);
     Qstar.set_row(0, w);
 
     int iter = 0;
-    Vector temp(A.rows(), false);
-    double rel_err;
+    bool blocks = s > 1;
 
-    while (iter < num_iters) 
+    while (iter < max_steps) 
     {
-        // w = Aqi
-        Qstar.row(iter, temp);
-        A.multiply(temp, w);
+        if (blocks && scale > 0 && max_steps - iter > 1) {
+            int steps = sstep_block(A, M, side, std::min(s, max_steps - iter), iter,
+                                    Qstar, *Hraw, H, G, Cn, Sn, z, block, partial,
+                                    scale, ref_norm, max_err, rel_err);
+            if (steps > 0) {
+                iter += steps;
+                if (rel_err < max_err)
+                    break;
+                continue;
+            }
+            DEBUG_PRINT("s-step block at step %d is rank deficient, "
+                        "continuing one vector at a time\n", iter);
+            blocks = false;
+        }
 
-        // construct ith column of H, i+1th row of Qstar:        
-        for (int row = 0; row <= iter; row++) {
-            Qstar.row(row, temp);
-            H(row, iter) = temp.dot(w);
-            w.add_ax(-H(row, iter), temp);
+        // w = op(qi)
+        apply_operator(A, M, side, Vector(Qstar.row(iter)), z, w);
+
+        // construct ith column of H, i+1th row of Qstar.  A zero norm
+        // means the basis already contains the solution; the rotation
+        // below then drives the residual estimate to zero.
+        H(iter+1, iter) = orthogonalize(Qstar, iter, w, H, method, h, partial);
+        if (H(iter+1, iter) != 0) {
+            w.divide(H(iter+1, iter));
+            Qstar.set_row(iter+1, w);
         }
 
-        H(iter+1, iter) = w.norm();
-        w.divide(H(iter+1, iter));
-        Qstar.set_row(iter+1, w);
+        if (Hraw != NULL) {
+            const double *col = H.column(iter);
+            std::copy(col, col + iter + 2, Hraw->column(iter));
+            if (scale == 0)
+                scale = sqrt(ispc::vector_dot(col, col, iter + 2));
+        }
 
         update_qr_decomp (H, G, iter, Cn, Sn);
 
-        rel_err = fabs(G[iter+1] / beta);
+        rel_err = fabs(G[iter+1] / ref_norm);
+        iter++;
 
         if (rel_err < max_err)
             break;
+    }
+
+    // z = Qstar^T y, where H y = G on the leading iter x iter block; with
+    // right preconditioning the correction to x is M^-1 z.
+    Vector y_iter(y.view(0, iter));
+    upper_triangular_right_solve(H, G, y_iter);
+    y_iter.multiply(-1);
+    z.zero();
+    Qstar.subtract_transpose_multiply_leading_rows(y_iter, z);
+    if (M != NULL && side == PRECONDITION_RIGHT) {
+        M->apply(z, w);
+        x.add(w);
+    }
+    else
+        x.add(z);
+    return iter;
+}
+
+// Entries rounded up to whole 64-byte cache lines, so that each buffer
+// in a workspace starts on one
+static size_t cache_lines (size_t entries)
+{
+    return (entries + 7) & ~(size_t)7;
+}
+
+// A block starts at step j <= restart - 2 and has at most restart - j
+// steps, so its k = j + 1 leading rows and s new ones fit in restart + 1
+SStepScratch::SStepScratch (int restart, int s)
+    : X((restart + 1) * s), C(restart * s), RC(restart * s), R(s * s),
+      Gp(s * s), U(s * s), Uinv(s * s), L(s * s), Hnew((restart + 1) * s)
+{
+}
+
+static double *allocate_workspace (size_t n, int restart)
+{
+    size_t size = cache_lines((restart + 1) * n) + 3 * cache_lines(n)
+                + 3 * cache_lines(restart) + 2 * cache_lines(restart + 1);
+    void *p;
+    if (posix_memalign(&p, 64, size * sizeof(double)) != 0) {
+        fprintf(stderr, "Error: failed to allocate a gmres workspace of %lu doubles\n",
+                (unsigned long)size);
+        exit(-1);
+    }
+    return (double *)p;
+}
+
+GmresWorkspace::GmresWorkspace (size_t n, int restart, int s)
+    : storage(allocate_workspace(n, restart)),
+      Qstar(restart + 1, n, VectorView(storage, (restart + 1) * n)),
+      H(restart + 1, restart), Hraw(restart + 1, s > 1 ? restart : 0),
+      block(restart, s > 1 ? s : 0),
+      Sn(restart, false), Cn(restart, false), 
+      G(restart + 1, false), y(restart, false), h(restart + 1, false),
+      r(n, false), w(n, false), z(n, false),
+      partial(std::max(Vector::scratch_size(n), 
+                       Qstar.scratch_size(restart + 1, std::max(s, 1))))
+{
+    double *next = storage + cache_lines((restart + 1) * n);
+    Vector *vectors[] = { &r, &w, &z, &Sn, &Cn, &y, &G, &h };
+    for (int i = 0; i < 8; i++) {
+        vectors[i]->bind(VectorView(next, vectors[i]->size()));
+        next += cache_lines(vectors[i]->size());
+    }
+}
+
+bool GmresWorkspace::fits (size_t n, int restart, int s) const
+{
+    return Qstar.cols() == n && H.cols() == (size_t)restart &&
+           (s <= 1 || (Hraw.cols() == (size_t)restart && block.R.size() >= (size_t)(s * s)));
+}
+
+int gmres (const Matrix &A, const Vector &b, Vector &x, int restart, 
+           int max_iters, double max_err, const Preconditioner *M,
+           PreconditionSide side, Orthogonalization method, int s,
+           GmresWorkspace *work)
+{
+    if (s > 1)
+        DEBUG_PRINT("gmres(%d) starting, %d-step!\n", restart, s);
+    else
+        DEBUG_PRINT("gmres(%d) starting!\n", restart);
+    x.zero();
+
+    ASSERT(A.rows() == A.cols());
+    ASSERT(restart > 0);
+
+    // The Krylov basis, the Hessenberg factorization and the other
+    // buffers are sized by the restart length and reused by every cycle
+    // (and, given work, every solve).
+    GmresWorkspace *local = NULL;
+    if (work == NULL)
+        work = local = new GmresWorkspace(A.rows(), restart, s);
+    else if (!work->fits(A.rows(), restart, s)) {
+        fprintf(stderr, "Error: gmres workspace does not fit gmres(%d) on %lu unknowns\n",
+                restart, (unsigned long)A.rows());
+        exit(-1);
+    }
+    ReductionScratch *partial = &work->partial;
+
+    double bnorm = b.norm(partial);
+    double rel_err = 1;
+    int iter = 0;
+    int cycle = 0;
+
+    if (bnorm == 0) {
+        delete local;
+        return 0;
+    }
+    DenseMatrix &Qstar = work->Qstar;
+    HessenbergMatrix &H = work->H;
+    Vector &Sn = work->Sn, &Cn = work->Cn;
+
+    // G is the rhs projected onto the hessenburg's column space; r = b -
+    // Ax, the true residual at the start of each cycle; w and z are
+    // scratch (w stores op(qi))
+    Vector &G = work->G, &y = work->y, &h = work->h;
+    Vector &r = work->r, &w = work->w, &z = work->z;
+
+    // s-step: H before the Givens rotations, and the scale of the
+    // monomial basis (unknown until the first step)
+    HessenbergMatrix *Hraw = s > 1 ? &work->Hraw : NULL;
+    double scale = 0;
+
+    // With left preconditioning the inner iterations see M^-1 r, so their
+    // residual estimates are relative to |M^-1 b|.
+    bool left = (M != NULL && side == PRECONDITION_LEFT);
+    double ref_norm = bnorm;
+    if (left) {
+        M->apply(b, z);
+        ref_norm = z.norm(partial);
+    }
+
+    while (true) 
+    {
+        A.multiply(x, r);
+        r.multiply(-1);
+        r.add(b);
+
+        rel_err = r.norm(partial) / bnorm;
+        if (rel_err < max_err || iter >= max_iters)
+            break;
+
+        if (cycle % 10 == 0)
+            DEBUG_PRINT("Restart %d, iter %d: %f err\n", cycle, iter, rel_err);
+
+        if (left) {
+            M->apply(r, z);
+            r.copy(z);
+        }
+
+        double est_err;
+        iter += gmres_cycle(A, M, side, method, r, x, ref_norm, 
+                            max_iters - iter, max_err, Qstar, H, Cn, Sn, G, 
+                            y, w, z, h, partial, s, Hraw, work->block, scale, 
+                            est_err);
+        cycle++;
+    }
+    delete local;
+
+    if (rel_err >= max_err) {
+        fprintf(stderr, "Error: gmres failed to converge in %d iterations (relative err: %f)\n", max_iters, rel_err);
+        return -1;
+    }
+
+    DEBUG_PRINT("gmres completed in %d iterations, %d restarts (rel. resid. %f, max %f)\n", iter, cycle, rel_err, max_err);
+    return iter;
+}
+
+/*===========================================================================*\
+|* CG and BiCGSTAB
+\*===========================================================================*/
+/* Sets r to the true residual b - Ax and returns whether it is below
+ * max_err relative to bnorm, leaving that in rel_err.  The short
+ * recurrences below check this before accepting their own residual, and
+ * restart from it otherwise.
+ */
+static bool true_residual_converged (const Matrix &A, const Vector &b, 
+                                     const Vector &x, Vector &r, double bnorm,
+                                     double max_err, double &rel_err,
+                                     ReductionScratch *partial)
+{
+    A.multiply(x, r);
+    r.multiply(-1);
+    r.add(b);
+    rel_err = r.norm(partial) / bnorm;
+    return rel_err < max_err;
+}
+
+int cg (const Matrix &A, const Vector &b, Vector &x, int max_iters,
+        double max_err, const Preconditioner *M)
+{
+    DEBUG_PRINT("cg starting!\n");
+    ASSERT(A.rows() == A.cols());
+    int n = A.rows();
+
+    // Without a preconditioner z = M^-1 r is r itself
+    Vector r(n), p(n), q(n);
+    Vector *z = M != NULL ? new Vector(n) : &r;
+    ReductionScratch partial(Vector::scratch_size(n));
+
+    x.zero();
+    r.copy(b);
+    double bnorm = b.norm(&partial);
+    double rel_err = bnorm > 0 ? 1 : 0;
+    double rz = 0;
+    int iter = 0;
+    bool restart = true;
+
+    while (rel_err >= max_err && iter < max_iters)
+    {
+        if (restart) {
+            if (M != NULL)
+                M->apply(r, *z);
+            rz = r.dot(*z, &partial);
+            p.copy(*z);
+            restart = false;
+        }
+
+        A.multiply(p, q);
+        double pq = p.dot(q, &partial);
+        if (!(pq > 0)) {
+            fprintf(stderr, "Error: cg needs a positive definite matrix (p'Ap = %g)\n", pq);
+            break;
+        }
+
+        double alpha = rz / pq;
+        x.add_ax(alpha, p);
+        double rr = r.add_ax_dot(-alpha, q, r, &partial);
+        rel_err = sqrt(rr) / bnorm;
+        iter++;
 
         if (iter % 100 == 0)
             DEBUG_PRINT("Iter %d: %f err\n", iter, rel_err);
 
+        if (rel_err < max_err) {
+            if (!true_residual_converged(A, b, x, r, bnorm, max_err, rel_err, 
+                                         &partial))
+                restart = true;
+            continue;
+        }
+
+        double rz_next = rr;
+        if (M != NULL) {
+            M->apply(r, *z);
+            rz_next = r.dot(*z, &partial);
+        }
+        p.multiply(rz_next / rz);
+        p.add(*z);
+        rz = rz_next;
+    }
+
+    if (M != NULL)
+        delete z;
+
+    if (rel_err >= max_err) {
+        fprintf(stderr, "Error: cg failed to converge in %d iterations (relative err: %f)\n", iter, rel_err);
+        return -1;
+    }
+
+    DEBUG_PRINT("cg completed in %d iterations (rel. resid. %g, max %g)\n", iter, rel_err, max_err);
+    return iter;
+}
+
+int bicgstab (const Matrix &A, const Vector &b, Vector &x, int max_iters,
+              double max_err, const Preconditioner *M)
+{
+    DEBUG_PRINT("bicgstab starting!\n");
+    ASSERT(A.rows() == A.cols());
+    int n = A.rows();
+
+    // r doubles as s = r - alpha v; without a preconditioner the
+    // preconditioned p and s are p and s themselves.
+    Vector r(n), r0(n), p(n), v(n), t(n);
+    Vector *p_hat = M != NULL ? new Vector(n) : &p;
+    Vector *s_hat = M != NULL ? new Vector(n) : &r;
+    ReductionScratch partial(Vector::scratch_size(n));
+
+    x.zero();
+    r.copy(b);
+    double bnorm = b.norm(&partial);
+    double rel_err = bnorm > 0 ? 1 : 0;
+    double rho = 1, alpha = 1, omega = 1;
+    int iter = 0;
+    bool restart = true;
+    bool fresh = false;   // no iteration completed since the restart
+
+    while (rel_err >= max_err && iter < max_iters)
+    {
+        if (restart) {
+            r0.copy(r);
+            p.zero();
+            v.zero();
+            rho = alpha = omega = 1;
+            restart = false;
+            fresh = true;
+        }
+
+        double rho_next = r0.dot(r, &partial);
+        if (rho_next == 0) {
+            restart = !true_residual_converged(A, b, x, r, bnorm, max_err, rel_err,
+                                               &partial);
+            continue;
+        }
+
+        // p = r + beta (p - omega v)
+        double beta = (rho_next / rho) * (alpha / omega);
+        rho = rho_next;
+        p.add_ax(-omega, v);
+        p.multiply(beta);
+        p.add(r);
+
+        if (M != NULL)
+            M->apply(p, *p_hat);
+        A.multiply(*p_hat, v);
+        double r0v = r0.dot(v, &partial);
+        if (r0v == 0 && fresh) {
+            fprintf(stderr, "Error: bicgstab broke down (r0'v = 0 after a restart)\n");
+            break;
+        }
+        if (r0v == 0) {
+            restart = !true_residual_converged(A, b, x, r, bnorm, max_err, rel_err,
+                                               &partial);
+            continue;
+        }
+
+        alpha = rho / r0v;
+        x.add_ax(alpha, *p_hat);
+        double ss = r.add_ax_dot(-alpha, v, r, &partial);
         iter++;
+        fresh = false;
+
+        if (iter % 100 == 0)
+            DEBUG_PRINT("Iter %d: %f err\n", iter, sqrt(ss) / bnorm);
+
+        if (sqrt(ss) / bnorm < max_err) {
+            restart = !true_residual_converged(A, b, x, r, bnorm, max_err, rel_err,
+                                               &partial);
+            continue;
+        }
+
+        if (M != NULL)
+            M->apply(r, *s_hat);
+        A.multiply(*s_hat, t);
+        double ts, tnorm;
+        t.dot_norm(r, ts, tnorm, &partial);
+        omega = tnorm > 0 ? ts / (tnorm * tnorm) : 0;
+        if (omega == 0) {
+            restart = !true_residual_converged(A, b, x, r, bnorm, max_err, rel_err,
+                                               &partial);
+            continue;
+        }
+
+        x.add_ax(omega, *s_hat);
+        rel_err = sqrt(r.add_ax_dot(-omega, t, r, &partial)) / bnorm;
+        if (rel_err < max_err)
+            restart = !true_residual_converged(A, b, x, r, bnorm, max_err, rel_err,
+                                               &partial);
     }
 
-    if (iter == num_iters) {
-        fprintf(stderr, "Error: gmres failed to converge in %d iterations (relative err: %f)\n", num_iters, rel_err);
-        exit(-1);
+    if (M != NULL) {
+        delete p_hat;
+        delete s_hat;
+    }
+
+    if (rel_err >= max_err) {
+        fprintf(stderr, "Error: bicgstab failed to converge in %d iterations (relative err: %f)\n", iter, rel_err);
+        return -1;
+    }
+
+    DEBUG_PRINT("bicgstab completed in %d iterations (rel. resid. %g, max %g)\n", iter, rel_err, max_err);
+    return iter;
+}
+
+// Smallest reduction of the residual asked of one single precision cycle;
+// float rounding makes a smaller one unreliable, and the outer loop
+// refines from there.
+#define FLOAT_CYCLE_REDUCTION 1e-5
+
+int gmres_mixed (const CRSMatrix &A, const Vector &b, Vector &x, int restart, 
+                 int max_iters, double max_err)
+{
+    DEBUG_PRINT("mixed-precision gmres(%d) starting!\n", restart);
+    x.zero();
+
+    ASSERT(A.rows() == A.cols());
+    ASSERT(restart > 0);
+    int n = A.rows();
+
+    FloatCRSMatrix Af(A);
+    FloatBasis Q(restart + 1, n);
+    std::vector<float> w(n);
+    std::vector<float> h(restart + 1);
+
+    HessenbergMatrix H(restart + 1, restart);
+    Vector Sn(restart);
+    Vector Cn(restart);
+    Vector G(restart + 1);
+    Vector y(restart);
+    Vector r(n);
+    ReductionScratch partial(std::max(Vector::scratch_size(n), 
+                                      Q.scratch_size(restart + 1)));
+
+    double bnorm = b.norm(&partial);
+    double rel_err = 1;
+    int iter = 0;
+    int cycle = 0;
+
+    if (bnorm == 0)
+        return 0;
+
+    while (true)
+    {
+        // r = b - Ax in double
+        A.multiply(x, r);
+        r.multiply(-1);
+        r.add(b);
+
+        double rnorm = r.norm(&partial);
+        rel_err = rnorm / bnorm;
+        if (rel_err < max_err || iter >= max_iters)
+            break;
+
+        if (cycle % 10 == 0)
+            DEBUG_PRINT("Restart %d, iter %d: %f err\n", cycle, iter, rel_err);
+
+        // Solve A d = r / |r| in float, so d is well scaled for float
+        double cycle_err = std::max(max_err / rel_err, FLOAT_CYCLE_REDUCTION);
+        int max_steps = std::min(restart, max_iters - iter);
+        ispc::vector_to_float(Q.row(0), &r[0], 1 / rnorm, n);
+        G.zero();
+        G[0] = 1;
+
+        int k = 0;
+        while (k < max_steps) {
+            Af.multiply(Q.row(k), &w[0]);
+
+            // CGS2 against rows 0..k
+            for (int row = 0; row <= k; row++)
+                H(row, k) = 0;
+            for (int pass = 0; pass < 2; pass++) {
+                Q.multiply_leading_rows(k + 1, &w[0], &h[0], &partial);
+                Q.subtract_transpose_multiply_leading_rows(k + 1, &h[0], &w[0]);
+                for (int row = 0; row <= k; row++)
+                    H(row, k) += h[row];
+            }
+
+            H(k+1, k) = sqrt(ispc::vector_dot_float(&w[0], &w[0], n));
+            if (H(k+1, k) != 0) {
+                ispc::vector_mult_float(&w[0], 1 / H(k+1, k), n);
+                memcpy(Q.row(k+1), &w[0], n * sizeof(float));
+            }
+
+            update_qr_decomp(H, G, k, Cn, Sn);
+            k++;
+
+            if (fabs(G[k]) < cycle_err)
+                break;
+        }
+
+        // x += |r| Q^T y
+        Vector y_k(y.view(0, k));
+        upper_triangular_right_solve(H, G, y_k);
+        for (int i = 0; i < k; i++)
+            h[i] = -y_k[i];
+        std::fill(w.begin(), w.end(), 0.f);
+        Q.subtract_transpose_multiply_leading_rows(k, &h[0], &w[0]);
+        ispc::vector_add_ax_float(&x[0], rnorm, &w[0], n);
+
+        iter += k;
+        cycle++;
+    }
+
+    if (rel_err >= max_err) {
+        fprintf(stderr, "Error: gmres failed to converge in %d iterations (relative err: %f)\n", max_iters, rel_err);
+        return -1;
+    }
+
+    DEBUG_PRINT("mixed-precision gmres completed in %d iterations, %d restarts (rel. resid. %g, max %g)\n", iter, cycle, rel_err, max_err);
+    return iter;
+}
+
+/*===========================================================================*\
+|* GMRES with multiple right-hand sides
+\*===========================================================================*/
+/* W = Q S with orthonormal columns Q (left in W) and upper triangular S,
+ * by Cholesky QR twice: the second pass restores the orthogonality the
+ * first loses to the squared condition number of the Gram matrix.  tmp
+ * is scratch of the shape of W, partial that of the reductions.  Returns
+ * false if W is rank deficient.
+ */
+static bool orthonormalize_block (MultiVector &W, std::vector<double> &S,
+                                  MultiVector &tmp, ReductionScratch *partial)
+{
+    int k = W.cols();
+    std::vector<double> G(k*k), U(k*k), Uinv(k*k), US(k*k);
+
+    for (int pass = 0; pass < 2; pass++) {
+        W.inner(W, &G[0], partial);
+        if (!cholesky(G, U, k))
+            return false;
+
+        // W = W U^-1
+        upper_inverse(U, Uinv, k);
+        tmp.zero();
+        tmp.add_mult(W, &Uinv[0]);
+        W.swap(tmp);
+
+        // S = U S
+        if (pass == 0)
+            S = U;
+        else {
+            for (int i = 0; i < k; i++)
+                for (int j = 0; j < k; j++) {
+                    double t = 0;
+                    for (int p = i; p <= j; p++)
+                        t += U[i*k + p] * S[p*k + j];
+                    US[i*k + j] = t;
+                }
+            S = US;
+        }
+    }
+    return true;
+}
+
+/* One cycle of independent GMRES(m) on each column of R, in lockstep:
+ * every step is one SpMM and column-wise MGS, and each column keeps its
+ * own Hessenberg matrix and rotations.  Column j stops updating once its
+ * residual estimate is below tol[j].  Adds the corrections to D and
+ * returns the number of steps.  V is scratch for the basis, partial for
+ * the reductions.
+ */
+static int lockstep_cycle (const CRSMatrix &A, const MultiVector &R,
+                           int max_steps, const std::vector<double> &tol,
+                           std::vector<MultiVector *> &V, MultiVector &D,
+                           ReductionScratch *partial)
+{
+    int k = R.cols();
+    std::vector<double> norm(k), scale(k), h(k);
+    std::vector<HessenbergMatrix *> H(k);
+    std::vector<Vector *> G(k), Cn(k), Sn(k);
+    std::vector<int> steps(k, 0);
+    std::vector<bool> done(k);
+
+    R.dot(R, &norm[0], partial);
+    int remaining = 0;
+    for (int j = 0; j < k; j++) {
+        norm[j]  = sqrt(norm[j]);
+        scale[j] = norm[j] > 0 ? 1 / norm[j] : 0;
+        H[j]  = new HessenbergMatrix(max_steps + 1, max_steps);
+        G[j]  = new Vector(max_steps + 1);
+        Cn[j] = new Vector(max_steps);
+        Sn[j] = new Vector(max_steps);
+        G[j]->zero();
+        (*G[j])[0] = norm[j];
+        done[j] = !(norm[j] >= tol[j]);
+        remaining += !done[j];
     }
+    V[0]->copy(R);
+    V[0]->scale(&scale[0], partial);
+
+    int s = 0;
+    while (s < max_steps && remaining > 0) {
+        MultiVector &W = *V[s+1];
+        A.multiply(*V[s], W);
 
-    // We've reached an acceptable solution (?):
+        // MGS, pipelined as in orthogonalize(): each pass subtracts the
+        // projections on V_i and computes those on V_i+1 (after the last,
+        // the squared norms).
+        V[0]->dot(W, &h[0], partial);
+        for (int i = 0; i <= s; i++) {
+            for (int j = 0; j < k; j++) {
+                (*H[j])(i, s) = h[j];
+                scale[j] = -h[j];
+            }
+            if (i < s)
+                W.add_ax_dot(&scale[0], *V[i], *V[i+1], &h[0], partial);
+            else
+                W.add_ax_dot(&scale[0], *V[i], W, &norm[0], partial);
+        }
+
+        for (int j = 0; j < k; j++) {
+            norm[j]  = sqrt(norm[j]);
+            scale[j] = norm[j] > 0 ? 1 / norm[j] : 0;
+            (*H[j])(s+1, s) = norm[j];
+        }
+        W.scale(&scale[0], partial);
+
+        for (int j = 0; j < k; j++) {
+            if (done[j])
+                continue;
+            update_qr_decomp(*H[j], *G[j], s, *Cn[j], *Sn[j]);
+            steps[j] = s + 1;
+            if (fabs((*G[j])[s+1]) < tol[j]) {
+                done[j] = true;
+                remaining--;
+            }
+        }
+        s++;
+    }
+
+    // D += V_i y_i over the basis, one coefficient per column
+    std::vector<Vector *> y(k);
+    for (int j = 0; j < k; j++) {
+        y[j] = new Vector(steps[j]);
+        if (steps[j] > 0)
+            upper_triangular_right_solve(*H[j], *G[j], *y[j]);
+    }
+    for (int i = 0; i < s; i++) {
+        for (int j = 0; j < k; j++)
+            h[j] = i < steps[j] ? (*y[j])[i] : 0;
+        D.add_ax(&h[0], *V[i], partial);
+    }
 
-    DEBUG_PRINT("gmres completed in %d iterations (rel. resid. %f, max %f)\n", num_iters, rel_err, max_err);
-    Vector y(iter+1);
-    upper_triangular_right_solve(H, G, y);
-    for (int i = 0; i < iter + 1; i++) {
-        Qstar.row(i, temp);
-        x.add_ax(y[i], temp);
+    for (int j = 0; j < k; j++) {
+        delete H[j];
+        delete G[j];
+        delete Cn[j];
+        delete Sn[j];
+        delete y[j];
     }
+    return s;
+}
+
+// A Givens rotation of rows row and row+1
+struct BlockRotation {
+    int    row;
+    double c, s;
+};
+
+static void rotate_rows (DenseMatrix &M, const BlockRotation &r, int col)
+{
+    double a = M(r.row, col), b = M(r.row + 1, col);
+    M(r.row,     col) = r.c * a - r.s * b;
+    M(r.row + 1, col) = r.s * a + r.c * b;
+}
+
+static void rotate_rows (HessenbergMatrix &H, const BlockRotation &r, int col)
+{
+    double *h = H.column(col) + r.row;
+    double a = h[0], b = h[1];
+    h[0] = r.c * a - r.s * b;
+    h[1] = r.s * a + r.c * b;
+}
+
+/* One cycle of block GMRES(m) on the k columns of R: block Arnoldi with
+ * block MGS between blocks and Cholesky QR within them, so that H is
+ * block upper Hessenberg with k subdiagonals, reduced to triangular form
+ * by k Givens rotations per column.  The least squares right-hand side is
+ * k wide, one column per right-hand side, and the cycle ends once every
+ * column's residual estimate is below its tol.  Adds the correction to D
+ * and returns the number of steps, or 0 if R (or the first new block) is
+ * rank deficient.  V, tmp and partial are scratch.
+ */
+static int block_cycle (const CRSMatrix &A, const MultiVector &R,
+                        int max_steps, const std::vector<double> &tol,
+                        std::vector<MultiVector *> &V, MultiVector &tmp,
+                        MultiVector &D, ReductionScratch *partial)
+{
+    int k = R.cols();
+    std::vector<double> S(k*k), T(k*k);
+
+    V[0]->copy(R);
+    if (!orthonormalize_block(*V[0], S, tmp, partial))
+        return 0;
+
+    HessenbergMatrix H((max_steps + 1) * k, max_steps * k, k);
+    DenseMatrix G((max_steps + 1) * k, k);
+    H.zero();
+    G.zero();
+    for (int p = 0; p < k; p++)
+        for (int q = 0; q < k; q++)
+            G(p, q) = S[p*k + q];
+
+    std::vector<BlockRotation> rotations;
+    int steps = 0;
+    while (steps < max_steps) {
+        int j = steps;
+        MultiVector &W = *V[j+1];
+        A.multiply(*V[j], W);
+
+        for (int i = 0; i <= j; i++) {
+            V[i]->inner(W, &T[0], partial);
+            for (int p = 0; p < k; p++)
+                for (int q = 0; q < k; q++) {
+                    H(i*k + p, j*k + q) = T[p*k + q];
+                    T[p*k + q] = -T[p*k + q];
+                }
+            W.add_mult(*V[i], &T[0]);
+        }
+        if (!orthonormalize_block(W, S, tmp, partial))
+            break;
+        // S is upper triangular, which keeps H within k subdiagonals
+        for (int p = 0; p < k; p++)
+            for (int q = p; q < k; q++)
+                H((j+1)*k + p, j*k + q) = S[p*k + q];
+        steps++;
+
+        // Triangularize the new block column; column c has nonzeroes down
+        // to row c + k.
+        for (int c = j*k; c < (j+1)*k; c++) {
+            for (int r = 0; r < rotations.size(); r++)
+                rotate_rows(H, rotations[r], c);
+            for (int row = c + k; row > c; row--) {
+                double a = H(row - 1, c), b = H(row, c);
+                if (b == 0)
+                    continue;
+                BlockRotation r;
+                double len = sqrt(a*a + b*b);
+                r.row = row - 1;
+                r.c   =  a / len;
+                r.s   = -b / len;
+                rotate_rows(H, r, c);
+                for (int q = 0; q < k; q++)
+                    rotate_rows(G, r, q);
+                rotations.push_back(r);
+            }
+        }
+
+        // The residual of column q is the norm of column q of the last block
+        bool converged = true;
+        for (int q = 0; q < k; q++) {
+            double res = 0;
+            for (int p = 0; p < k; p++)
+                res += G((j+1)*k + p, q) * G((j+1)*k + p, q);
+            converged &= sqrt(res) < tol[q];
+        }
+        if (converged)
+            break;
+    }
+    if (steps == 0)
+        return 0;
+
+    // Y = H^-1 G on the leading steps*k rows, D += V_i Y_i
+    int m = steps * k;
+    DenseMatrix Y(m, k);
+    Vector g(m), y(m);
+    for (int q = 0; q < k; q++) {
+        for (int i = 0; i < m; i++)
+            g[i] = G(i, q);
+        upper_triangular_right_solve(H, g, y);
+        for (int i = 0; i < m; i++)
+            Y(i, q) = y[i];
+    }
+    for (int i = 0; i < steps; i++) {
+        for (int p = 0; p < k; p++)
+            for (int q = 0; q < k; q++)
+                T[p*k + q] = Y(i*k + p, q);
+        D.add_mult(*V[i], &T[0]);
+    }
+    return steps;
+}
+
+static void free_workspace (std::vector<MultiVector *> &V)
+{
+    for (int i = 0; i < V.size(); i++)
+        delete V[i];
+    V.clear();
+}
+
+int gmres_multi (const CRSMatrix &A, const MultiVector &B, MultiVector &X,
+                 int restart, int max_iters, double max_err, MultiSolve method)
+{
+    int n = A.rows();
+    int k = B.cols();
+    DEBUG_PRINT("%s gmres(%d) starting with %d right-hand sides!\n",
+                method == MULTI_BLOCK ? "block" : "lockstep", restart, k);
+
+    ASSERT(A.rows() == A.cols());
+    ASSERT(B.rows() == n && X.rows() == n && X.cols() == k);
+    ASSERT(restart > 0);
+    X.zero();
+
+    MultiVector R(n, k);
+    std::vector<double> bnorm(k), rnorm(k), ones(k, 1.), minus(k, -1.);
+    ReductionScratch partial;
+    B.dot(B, &bnorm[0], &partial);
+    for (int j = 0; j < k; j++)
+        bnorm[j] = sqrt(bnorm[j]);
+
+    // Workspace for the active columns, reallocated as columns converge:
+    // the basis, R and D restricted to them, and Cholesky QR scratch.
+    std::vector<MultiVector *> V, work;
+    std::vector<int> active;
+    std::vector<double> tol;
+
+    double rel_err = 0;
+    int iter = 0;
+    int cycle = 0;
+
+    while (true)
+    {
+        A.multiply(X, R);
+        R.scale(&minus[0], &partial);
+        R.add_ax(&ones[0], B, &partial);
+        R.dot(R, &rnorm[0], &partial);
+
+        rel_err = 0;
+        active.clear();
+        tol.clear();
+        for (int j = 0; j < k; j++) {
+            double err = bnorm[j] > 0 ? sqrt(rnorm[j]) / bnorm[j] : 0;
+            rel_err = std::max(rel_err, err);
+            if (err >= max_err) {
+                active.push_back(j);
+                tol.push_back(max_err * bnorm[j]);
+            }
+        }
+        if (active.empty() || iter >= max_iters)
+            break;
+
+        if (cycle % 10 == 0)
+            DEBUG_PRINT("Restart %d, iter %d: %f max err, %lu active\n", 
+                        cycle, iter, rel_err, active.size());
+
+        int ka = active.size();
+        if (work.empty() || work[0]->cols() != ka) {
+            free_workspace(V);
+            free_workspace(work);
+            for (int i = 0; i <= restart; i++)
+                V.push_back(new MultiVector(n, ka));
+            for (int i = 0; i < 3; i++)
+                work.push_back(new MultiVector(n, ka));
+        }
+        MultiVector &Ra = *work[0], &Da = *work[1], &tmp = *work[2];
+        for (int i = 0; i < n; i++)
+            for (int j = 0; j < ka; j++)
+                Ra(i, j) = R(i, active[j]);
+        Da.zero();
+
+        int max_steps = std::min(restart, max_iters - iter);
+        int steps = 0;
+        if (method == MULTI_BLOCK)
+            steps = block_cycle(A, Ra, max_steps, tol, V, tmp, Da, &partial);
+        // Rank deficient blocks (e.g. equal right-hand sides) fall back to
+        // lockstep for the cycle.
+        if (steps == 0)
+            steps = lockstep_cycle(A, Ra, max_steps, tol, V, Da, &partial);
+
+        for (int i = 0; i < n; i++)
+            for (int j = 0; j < ka; j++)
+                X(i, active[j]) += Da(i, j);
+
+        iter += steps;
+        cycle++;
+    }
+    free_workspace(V);
+    free_workspace(work);
+
+    if (rel_err >= max_err) {
+        fprintf(stderr, "Error: gmres failed to converge in %d iterations (relative err: %f)\n", max_iters, rel_err);
+        return -1;
+    }
+
+    DEBUG_PRINT("%s gmres completed in %d iterations, %d restarts (max rel. resid. %g, max %g)\n", 
+                method == MULTI_BLOCK ? "block" : "lockstep", iter, cycle, rel_err, max_err);
+    return iter;
 }
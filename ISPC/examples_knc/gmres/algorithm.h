@@ -38,13 +38,152 @@
 #include "matrix.h"
 
 
+enum PreconditionSide {
+    PRECONDITION_LEFT,   // solve M^-1 A x = M^-1 b
+    PRECONDITION_RIGHT   // solve A M^-1 u = b, x = M^-1 u
+};
+
+// How each new Krylov vector is orthogonalized against the basis
+enum Orthogonalization {
+    ORTHOGONALIZE_MGS,   // modified Gram-Schmidt, one vector at a time
+    ORTHOGONALIZE_CGS2   // classical Gram-Schmidt, twice, against all at once
+};
+
+// How gmres_multi treats its right-hand sides
+enum MultiSolve {
+    MULTI_LOCKSTEP,      // one GMRES per column, stepping together
+    MULTI_BLOCK          // block GMRES over all columns at once
+};
+
+// Scratch for one s-step block (see sstep_block() in algorithm.cpp): the
+// block's coefficients in the basis and its small dense factors, sized
+// for the largest block of a GMRES(restart) cycle.
+struct SStepScratch {
+    SStepScratch (int restart, int s);
+
+    std::vector<double> X, C, RC, R, Gp, U, Uinv, L, Hnew;
+};
+
+/* GMRES workspace:
+ * ---------------
+ * Every buffer gmres() needs for n unknowns and GMRES(restart), s-step
+ * or not: the Krylov basis, the n-vectors and the rotation and least
+ * squares vectors are carved out of one 64-byte aligned allocation, and
+ * the (small) Hessenberg matrices and the reductions' partial sums are
+ * allocated alongside it, once.
+ * Passing the same workspace to repeated solves makes gmres() itself
+ * allocation free.
+ */
+class GmresWorkspace {
+ public:
+    GmresWorkspace (size_t n, int restart, int s = 1);
+    ~GmresWorkspace () { free(storage); }
+
+    // Whether this can serve gmres() on an n x n matrix with these
+    // restart and s
+    bool fits (size_t n, int restart, int s) const;
+
+ private:
+    // Leading member: the other members are views into it
+    double *storage;
+
+ public:
+    DenseMatrix      Qstar;      // Krylov basis, in the rows
+    HessenbergMatrix H;          // rotated to triangular as it is built
+    HessenbergMatrix Hraw;       // H before the rotations (s-step only)
+    SStepScratch     block;      // (s-step only)
+    Vector Sn, Cn;               // Givens rotations
+    Vector G, y, h;              // least squares rhs, solution, scratch
+    Vector r, w, z;              // residual and scratch n-vectors
+    ReductionScratch partial;    // the reductions' per-task sums
+};
+
+/* Arnoldi process:
+ * ---------------
+ * Builds an orthonormal basis of the Krylov space K_m(A, b) in the rows
+ * of Q (which has m+1 rows) along with the (m+1) x m Hessenberg matrix H
+ * such that A Q_m^T = Q^T H.  Returns the number of steps taken, which is
+ * less than m if the space is invariant.
+ */
+int arnoldi (const Matrix &A, const Vector &b, DenseMatrix &Q, HessenbergMatrix &H,
+             Orthogonalization method);
+
+/* Loss of orthogonality |I - Q Q^T| (Frobenius norm) of the first k rows
+ * of Q.
+ */
+double orthogonality_loss (const DenseMatrix &Q, int k);
+
 /* Generalized Minimal Residual Method:
  * -----------------------------------
  * Takes a square matrix and an rhs and uses GMRES to find an estimate for x.
- * The specified error is relative.
+ * The specified error is relative.  The Krylov basis is restarted every
+ * 'restart' iterations (GMRES(m)), so memory use is about (restart+1)
+ * vectors; convergence is checked against the true residual b - Ax at
+ * each restart.  Gives up after max_iters iterations in total.  M, if
+ * given, preconditions the system from the given side.  With s > 1 the
+ * basis is built s vectors at a time (s-step GMRES): s products with
+ * the operator, then one block orthogonalization with 2 global reductions
+ * instead of 2 or more per vector, falling back to method, one vector at
+ * a time, for the rest of a cycle if a block is numerically rank
+ * deficient.  work, if given, must fit (see GmresWorkspace) and is used
+ * instead of allocating the buffers for this solve.  Returns the number
+ * of iterations taken, or -1 (after printing why) if max_iters is reached
+ * first.
+ */
+int gmres (const Matrix &A, const Vector &b, Vector &x, int restart,
+           int max_iters, double err, const Preconditioner *M = NULL,
+           PreconditionSide side = PRECONDITION_RIGHT,
+           Orthogonalization method = ORTHOGONALIZE_MGS, int s = 1,
+           GmresWorkspace *work = NULL);
+
+/* Conjugate Gradient:
+ * ------------------
+ * For symmetric positive definite A (and M, if given).  Keeps three
+ * vectors besides x and b (four with M), whatever the iteration count.  When the
+ * recursive residual reaches err (relative to |b|) the true residual
+ * b - Ax is checked, and replaces the recursive one if it has drifted.
+ * Returns the number of iterations taken, or -1 (after printing why) if
+ * A turns out not to be positive definite or max_iters is reached.
  */
-void gmres (const Matrix &A, const Vector &b, Vector &x, int num_iters, double err);
+int cg (const Matrix &A, const Vector &b, Vector &x, int max_iters, double err,
+        const Preconditioner *M = NULL);
 
+/* BiCGSTAB:
+ * --------
+ * Biconjugate gradient stabilized, for nonsymmetric A, right
+ * preconditioned by M if given.  Two products with A per iteration and
+ * constant memory (five vectors, seven with M).  Breakdowns restart from
+ * the true residual.  Returns as cg().
+ */
+int bicgstab (const Matrix &A, const Vector &b, Vector &x, int max_iters,
+              double err, const Preconditioner *M = NULL);
+
+/* Mixed-precision GMRES:
+ * ---------------------
+ * GMRES(m) with iterative refinement: each cycle runs in single precision
+ * (float matrix values, basis and kernels, CGS2 orthogonalization) on the
+ * residual b - Ax, which the outer loop computes in double along with the
+ * update of x.  Reaches the same accuracy as gmres() while moving about
+ * half the bytes per iteration.  Returns as gmres().
+ */
+int gmres_mixed (const CRSMatrix &A, const Vector &b, Vector &x, int restart,
+                 int max_iters, double err);
+
+/* Multiple right-hand sides:
+ * -------------------------
+ * Solves A X = B for the k columns of B together, sharing one SpMM
+ * (A times all k vectors, see CRSMatrix::multiply) per step.  With
+ * MULTI_LOCKSTEP this runs k independent GMRES(m) in lockstep, each
+ * column with its own Hessenberg matrix and rotations; with MULTI_BLOCK
+ * it runs block GMRES(m), whose Krylov space is shared by all columns
+ * and so converges in fewer steps when the right-hand sides are related.
+ * Columns that have converged at a restart drop out of the next cycle.
+ * err is relative to each column of B.  Returns the number of SpMMs, or
+ * -1 (after printing why) if some column has not converged by max_iters.
+ */
+int gmres_multi (const CRSMatrix &A, const MultiVector &B, MultiVector &X,
+                 int restart, int max_iters, double err,
+                 MultiSolve method = MULTI_LOCKSTEP);
 
 
 #endif
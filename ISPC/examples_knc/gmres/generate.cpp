@@ -0,0 +1,274 @@
+/*
+  Copyright (c) 2012, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  
+*/
+
+
+/**************************************************************\
+| Includes
+\**************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "matrix.h"
+
+/**************************************************************\
+| Helpers
+\**************************************************************/
+// xorshift64*: the same matrices on every platform, unlike rand()
+class Random {
+ public:
+    Random (uint64_t seed) : state(seed) {}
+
+    // Uniform in [0, 1)
+    double uniform ()
+    {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return ((state * 2685821657736338717ULL) >> 11) * (1. / 9007199254740992.);
+    }
+
+    int below (int n) { return std::min(n - 1, (int)(uniform() * n)); }
+
+ private:
+    uint64_t state;
+};
+
+// Rows are appended in order, each with ascending columns
+struct RowBuilder {
+    std::vector<int>    row_offsets;
+    std::vector<int>    columns;
+    std::vector<double> entries;
+
+    RowBuilder () : row_offsets(1, 0) {}
+
+    void add (int col, double val)
+    {
+        columns.push_back(col);
+        entries.push_back(val);
+    }
+
+    void end_row () { row_offsets.push_back(columns.size()); }
+};
+
+// Row 'row' of a stencil on an nx x ny x nz grid (natural ordering, x
+// fastest): weight(dx, dy, dz) for each neighbour in the grid, with
+// Dirichlet boundaries dropping the ones outside.  The neighbours are
+// visited in increasing index order, so the columns come out sorted.
+template <typename Weight>
+static void stencil_row (RowBuilder &rows, int nx, int ny, int nz, int row,
+                         int reach_z, Weight weight)
+{
+    int x = row % nx, y = (row / nx) % ny, z = row / (nx * ny);
+    for (int dz = -reach_z; dz <= reach_z; dz++)
+        for (int dy = -1; dy <= 1; dy++)
+            for (int dx = -1; dx <= 1; dx++) {
+                if (x + dx < 0 || x + dx >= nx || y + dy < 0 || y + dy >= ny ||
+                    z + dz < 0 || z + dz >= nz)
+                    continue;
+                double w = weight(dx, dy, dz);
+                if (w != 0)
+                    rows.add(row + dx + nx * (dy + ny * dz), w);
+            }
+    rows.end_row();
+}
+
+struct Poisson5 {
+    double operator () (int dx, int dy, int) const
+    {
+        if (dx == 0 && dy == 0)
+            return 4;
+        return dx == 0 || dy == 0 ? -1 : 0;
+    }
+};
+
+struct Poisson7 {
+    double operator () (int dx, int dy, int dz) const
+    {
+        int dist = abs(dx) + abs(dy) + abs(dz);
+        return dist == 0 ? 6 : dist == 1 ? -1 : 0;
+    }
+};
+
+struct Poisson27 {
+    double operator () (int dx, int dy, int dz) const
+    {
+        return dx == 0 && dy == 0 && dz == 0 ? 26 : -1;
+    }
+};
+
+// -laplace(u) + w . grad(u), central differences, with the cell Peclet
+// number folded into beta: the upwind neighbours get -1-beta and the
+// downwind ones -1+beta, so beta = 0 is the symmetric 5-point Laplacian
+// and beta -> 1 approaches pure upwinding.
+struct ConvectionDiffusion {
+    double beta;
+    ConvectionDiffusion (double b) : beta(b) {}
+
+    double operator () (int dx, int dy, int) const
+    {
+        if (dx == 0 && dy == 0)
+            return 4;
+        if (dx != 0 && dy != 0)
+            return 0;
+        return dx + dy < 0 ? -1 - beta : -1 + beta;
+    }
+};
+
+// Random off-diagonal values in [-1, 1) at the given (sorted, distinct)
+// columns, and a diagonal that makes the row strictly dominant.
+static void dominant_row (RowBuilder &rows, Random &rng, int row,
+                          const std::vector<int> &cols)
+{
+    std::vector<double> vals(cols.size());
+    double sum = 0;
+    for (int i = 0; i < cols.size(); i++) {
+        vals[i] = 2 * rng.uniform() - 1;
+        sum += fabs(vals[i]);
+    }
+    bool diagonal = false;
+    for (int i = 0; i < cols.size(); i++) {
+        if (!diagonal && cols[i] > row) {
+            rows.add(row, sum + 1);
+            diagonal = true;
+        }
+        rows.add(cols[i], vals[i]);
+    }
+    if (!diagonal)
+        rows.add(row, sum + 1);
+    rows.end_row();
+}
+
+/**************************************************************\
+| CRSMatrix generator
+\**************************************************************/
+CRSMatrix *CRSMatrix::generate (const char *spec)
+{
+    char kind[32];
+    int n = 0;
+    double param = -1;
+    if (sscanf(spec, "%31[^:]:%d:%lf", kind, &n, &param) < 2 || n <= 0) {
+        fprintf(stderr, "Error: bad matrix specification '%s'\n", spec);
+        return NULL;
+    }
+
+    // The grids have n^2 or n^3 rows, in size_t so a large n is caught
+    // here rather than wrapping; CRSMatrix indexes with int.
+    size_t grid = (size_t)n;
+    if (strcmp(kind, "poisson2d") == 0 || strcmp(kind, "convdiff") == 0)
+        grid = (size_t)n * n;
+    else if (strcmp(kind, "poisson3d") == 0 || strcmp(kind, "poisson3d-27") == 0)
+        grid = (size_t)n * n * n;
+    if (grid > INT_MAX) {
+        fprintf(stderr, "Error: '%s' has %lu rows, more than a matrix can index\n", 
+                spec, (unsigned long)grid);
+        return NULL;
+    }
+
+    RowBuilder rows;
+    Random rng(0x9e3779b97f4a7c15ULL ^ n);
+    int size = (int)grid;
+
+    if (strcmp(kind, "poisson2d") == 0) {
+        for (int row = 0; row < size; row++)
+            stencil_row(rows, n, n, 1, row, 0, Poisson5());
+    }
+    else if (strcmp(kind, "poisson3d") == 0 || strcmp(kind, "poisson3d-27") == 0) {
+        bool full = strcmp(kind, "poisson3d-27") == 0;
+        for (int row = 0; row < size; row++) {
+            if (full)
+                stencil_row(rows, n, n, n, row, 1, Poisson27());
+            else
+                stencil_row(rows, n, n, n, row, 1, Poisson7());
+        }
+    }
+    else if (strcmp(kind, "convdiff") == 0) {
+        double beta = param < 0 ? .5 : param;
+        if (beta >= 1) {
+            fprintf(stderr, "Error: convdiff needs beta in [0, 1)\n");
+            return NULL;
+        }
+        for (int row = 0; row < size; row++)
+            stencil_row(rows, n, n, 1, row, 0, ConvectionDiffusion(beta));
+    }
+    else if (strcmp(kind, "banded") == 0) {
+        // Each entry within the half-bandwidth present with probability 1/2
+        int width = param < 0 ? 8 : (int)param;
+        std::vector<int> cols;
+        for (int row = 0; row < size; row++) {
+            cols.clear();
+            for (int col = std::max(0, row - width); col <= std::min(size - 1, row + width); col++)
+                if (col != row && rng.uniform() < .5)
+                    cols.push_back(col);
+            dominant_row(rows, rng, row, cols);
+        }
+    }
+    else if (strcmp(kind, "powerlaw") == 0) {
+        // Row lengths from a Pareto distribution with exponent alpha
+        // (at least 2 off-diagonals), at uniformly random columns
+        double alpha = param < 0 ? 2.5 : param;
+        if (alpha <= 1) {
+            fprintf(stderr, "Error: powerlaw needs alpha > 1\n");
+            return NULL;
+        }
+        std::vector<int> cols;
+        for (int row = 0; row < size; row++) {
+            double len = 2 * pow(1 - rng.uniform(), -1 / (alpha - 1));
+            int count = (int)std::min(len, (double)(size - 1));
+            cols.clear();
+            for (int i = 0; i < count; i++) {
+                int col = rng.below(size - 1);
+                cols.push_back(col < row ? col : col + 1);
+            }
+            std::sort(cols.begin(), cols.end());
+            cols.erase(std::unique(cols.begin(), cols.end()), cols.end());
+            dominant_row(rows, rng, row, cols);
+        }
+    }
+    else {
+        fprintf(stderr, "Error: unknown matrix kind '%s'\n", kind);
+        return NULL;
+    }
+
+    CRSMatrix *M = new CRSMatrix(size, size, rows.columns.size());
+    M->row_offsets.swap(rows.row_offsets);
+    M->columns.swap(rows.columns);
+    M->entries.swap(rows.entries);
+    M->partition_rows(std::max(1, std::min(size, (int)M->_nonzeroes / NONZEROES_PER_TASK)));
+    return M;
+}
@@ -36,44 +36,764 @@
 #include "algorithm.h"
 #include "util.h"
 #include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <sys/time.h>
 #include "../timing.h"
 
 
-int main (int argc, char **argv) 
+static double wall_seconds ()
 {
-    if (argc < 4) {
-        printf("usage: %s <input-matrix> <input-rhs> <output-file>\n", argv[0]);
-        return -1;
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+/* Times A * b with each multiply implementation of the CRS and SELL-C-sigma
+ * formats, reporting the minimum over a few runs as the other examples do,
+ * along with the throughput (2 flops per nonzero).
+ */
+static void time_multiply (CRSMatrix &A, SellCSigmaMatrix &S, const Vector &b)
+{
+    static const char *names[] = { "serial", "ispc", "ispc + tasks" };
+    double min_cycles[2][3];
+    Vector r(A.rows());
+
+    // How uneven the rows are decides how much CRS loses to idle lanes
+    double mean = (double)A.nonzeroes() / A.rows();
+    double var = 0;
+    int max_len = 0;
+    for (int row = 0; row < A.rows(); row++) {
+        int len = A.row_length(row);
+        var += (len - mean) * (len - mean);
+        max_len = std::max(max_len, len);
+    }
+    printf("[spmv]: %lu rows, %lu nonzeroes; row length mean %.1f, "
+           "stddev %.1f, max %d\n", A.rows(), A.nonzeroes(), mean, 
+           sqrt(var / A.rows()), max_len);
+    printf("[spmv]: SELL-%d-sigma stores %lu entries (%.1f%% padding)\n",
+           S.chunk_height(), S.stored_entries(), 
+           100. * (S.stored_entries() - S.nonzeroes()) / S.stored_entries());
+
+    for (int format = 0; format < 2; format++) {
+        Matrix &M = format == 0 ? (Matrix &)A : (Matrix &)S;
+        for (int mode = 0; mode < 3; mode++) {
+            A.set_multiply_mode((CRSMatrix::MultiplyMode)mode);
+            S.set_multiply_mode((CRSMatrix::MultiplyMode)mode);
+            min_cycles[format][mode] = 1e30;
+            double min_seconds = 1e30;
+            for (int i = 0; i < 10; i++) {
+                double t = wall_seconds();
+                reset_and_start_timer();
+                M.multiply(b, r);
+                min_cycles[format][mode] = std::min(min_cycles[format][mode], 
+                                                    get_elapsed_mcycles());
+                min_seconds = std::min(min_seconds, wall_seconds() - t);
+            }
+            printf("[spmv %s %s]:\t\t[%.3f] M cycles (%.2f GFLOP/s)\n",
+                   format == 0 ? "crs" : "sell", names[mode], 
+                   min_cycles[format][mode], 
+                   2e-9 * A.nonzeroes() / std::max(min_seconds, 1e-9));
+        }
+    }
+    printf("\t\t\t\t(%.2fx speedup from ISPC, %.2fx speedup from ISPC + tasks)\n",
+           min_cycles[0][0] / min_cycles[0][1], min_cycles[0][0] / min_cycles[0][2]);
+    printf("\t\t\t\t(%.2fx speedup from SELL with ISPC, %.2fx with ISPC + tasks)\n",
+           min_cycles[0][1] / min_cycles[1][1], min_cycles[0][2] / min_cycles[1][2]);
+
+    A.set_multiply_mode(CRSMatrix::MULTIPLY_ISPC_TASKS);
+    S.set_multiply_mode(CRSMatrix::MULTIPLY_ISPC_TASKS);
+}
+
+
+/* Times the BLAS-1 building blocks of the Arnoldi loop on vectors of
+ * length n: single- vs multi-task dot products, and an MGS step (w -= h q,
+ * then q'.w) and a dot product plus norm, each as two passes vs one fused
+ * pass.
+ */
+static void time_vector_ops (size_t n)
+{
+    std::vector<double> w(n, 1.), q(n, .5), q_next(n, .25);
+    int num_tasks = (n + VECTOR_CHUNK - 1) / VECTOR_CHUNK;
+    double min_cycles[6] = { 1e30, 1e30, 1e30, 1e30, 1e30, 1e30 };
+    double result[2];
+    std::vector<double> partial(Vector::scratch_size(n));
+
+    for (int i = 0; i < 10; i++) {
+        reset_and_start_timer();
+        ispc::vector_dot(&w[0], &q[0], n);
+        min_cycles[0] = std::min(min_cycles[0], get_elapsed_mcycles());
+
+        reset_and_start_timer();
+        ispc::vector_dot_tasks(&w[0], &q[0], n, VECTOR_CHUNK, &partial[0]);
+        min_cycles[1] = std::min(min_cycles[1], get_elapsed_mcycles());
+
+        reset_and_start_timer();
+        ispc::vector_add_ax_tasks(&w[0], -1e-3, &q[0], n, VECTOR_CHUNK);
+        ispc::vector_dot_tasks(&w[0], &q_next[0], n, VECTOR_CHUNK, &partial[0]);
+        min_cycles[2] = std::min(min_cycles[2], get_elapsed_mcycles());
+
+        reset_and_start_timer();
+        ispc::vector_add_ax_dot_tasks(&w[0], -1e-3, &q[0], &q_next[0], 
+                                      n, VECTOR_CHUNK, &partial[0]);
+        min_cycles[3] = std::min(min_cycles[3], get_elapsed_mcycles());
+
+        reset_and_start_timer();
+        ispc::vector_dot_tasks(&w[0], &q[0], n, VECTOR_CHUNK, &partial[0]);
+        ispc::vector_dot_tasks(&w[0], &w[0], n, VECTOR_CHUNK, &partial[0]);
+        min_cycles[4] = std::min(min_cycles[4], get_elapsed_mcycles());
+
+        reset_and_start_timer();
+        ispc::vector_dot_norm_tasks(&w[0], &q[0], n, VECTOR_CHUNK, result, &partial[0]);
+        min_cycles[5] = std::min(min_cycles[5], get_elapsed_mcycles());
+    }
+    printf("[dot ispc]:\t\t[%.3f] M cycles (%lu entries)\n", min_cycles[0], n);
+    printf("[dot ispc + tasks]:\t[%.3f] M cycles (%d tasks)\n", min_cycles[1], num_tasks);
+    printf("[add_ax, dot]:\t\t[%.3f] M cycles\n", min_cycles[2]);
+    printf("[add_ax_dot fused]:\t[%.3f] M cycles\n", min_cycles[3]);
+    printf("[dot, norm]:\t\t[%.3f] M cycles\n", min_cycles[4]);
+    printf("[dot_norm fused]:\t[%.3f] M cycles\n", min_cycles[5]);
+    printf("\t\t\t\t(%.2fx speedup from tasks, %.2fx and %.2fx from fusing)\n",
+           min_cycles[0] / min_cycles[1], min_cycles[2] / min_cycles[3],
+           min_cycles[4] / min_cycles[5]);
+}
+
+/* Misses on v in a direct-mapped cache of cache_bytes during A v: a rough,
+ * machine-independent measure of how local the column accesses are.
+ */
+static long v_cache_misses (const CRSMatrix &A, int cache_bytes)
+{
+    int lines = cache_bytes / 64;
+    std::vector<long> tags(lines, -1);
+    long misses = 0;
+
+    for (int row = 0; row < A.rows(); row++) {
+        const int *columns = A.row_columns(row);
+        for (int j = 0; j < A.row_length(row); j++) {
+            long line = columns[j] / (64 / sizeof(double));
+            if (tags[line % lines] != line) {
+                tags[line % lines] = line;
+                misses++;
+            }
+        }
+    }
+    return misses;
+}
+
+static double time_spmv (const CRSMatrix &A, const Vector &b)
+{
+    Vector r(A.rows());
+    double min_cycles = 1e30;
+    for (int i = 0; i < 10; i++) {
+        reset_and_start_timer();
+        A.multiply(b, r);
+        min_cycles = std::min(min_cycles, get_elapsed_mcycles());
+    }
+    return min_cycles;
+}
+
+
+/* Builds a restart-step Arnoldi basis from b with each orthogonalization
+ * method, reporting the time and how far the basis is from orthonormal.
+ */
+static void time_orthogonalize (const CRSMatrix &A, const Vector &b, int restart)
+{
+    static const char *names[] = { "mgs", "cgs2" };
+    double min_cycles[2];
+    DenseMatrix Q(restart + 1, A.cols());
+    HessenbergMatrix H(restart + 1, restart);
+
+    for (int method = 0; method < 2; method++) {
+        int steps = 0;
+        min_cycles[method] = 1e30;
+        for (int i = 0; i < 3; i++) {
+            reset_and_start_timer();
+            steps = arnoldi(A, b, Q, H, (Orthogonalization)method);
+            min_cycles[method] = std::min(min_cycles[method], get_elapsed_mcycles());
+        }
+        printf("[arnoldi %s]:\t\t[%.3f] M cycles (%d steps, |I - QQ^T| = %.3e)\n",
+               names[method], min_cycles[method], steps, 
+               orthogonality_loss(Q, steps));
+    }
+    printf("\t\t\t\t(%.2fx speedup from CGS2)\n", min_cycles[0] / min_cycles[1]);
+}
+
+
+/* Times R = A B for the k columns of B as one SpMM against k SpMVs.
+ */
+static void time_spmm (const CRSMatrix &A, const MultiVector &B)
+{
+    int k = B.cols();
+    MultiVector R(A.rows(), k);
+    std::vector<Vector *> b(k);
+    for (int j = 0; j < k; j++) {
+        b[j] = new Vector(A.cols());
+        B.column(j, *b[j]);
+    }
+    Vector r(A.rows());
+
+    double spmm_cycles = 1e30, spmv_cycles = 1e30;
+    for (int i = 0; i < 10; i++) {
+        reset_and_start_timer();
+        A.multiply(B, R);
+        spmm_cycles = std::min(spmm_cycles, get_elapsed_mcycles());
+
+        reset_and_start_timer();
+        for (int j = 0; j < k; j++)
+            A.multiply(*b[j], r);
+        spmv_cycles = std::min(spmv_cycles, get_elapsed_mcycles());
     }
+    printf("[spmm %d columns]:\t[%.3f] M cycles\n", k, spmm_cycles);
+    printf("[spmv x %d]:\t\t[%.3f] M cycles\n", k, spmv_cycles);
+    printf("\t\t\t\t(%.2fx speedup from SpMM)\n", spmv_cycles / spmm_cycles);
 
-    double gmres_cycles;
+    for (int j = 0; j < k; j++)
+        delete b[j];
+}
 
-    DEBUG_PRINT("Loading A...\n");
-    Matrix *A = CRSMatrix::matrix_from_mtf(argv[1]);
-    if (A == NULL) 
+/* Solves for all columns of the right-hand side file at once with
+ * gmres_multi, and for comparison one column at a time with gmres.
+ */
+static int solve_multi (const CRSMatrix &A, char *rhs_path, char *out_path,
+                        int restart, double tolerance, MultiSolve method)
+{
+    DEBUG_PRINT("Loading B...\n");
+    reset_and_start_timer();
+    MultiVector *B = MultiVector::multivector_from_mtf(rhs_path);
+    if (B == NULL)
+        exit(-1);
+    if (B->rows() != A.rows()) {
+        fprintf(stderr, "Error: %s has %lu rows, expected %lu\n", rhs_path, 
+                B->rows(), A.rows());
+        exit(-1);
+    }
+    printf("[load B]:\t\t[%.3f] M cycles (%lu columns)\n", get_elapsed_mcycles(),
+           B->cols());
+
+    time_spmm(A, *B);
+
+    int k = B->cols();
+    MultiVector X(A.cols(), k);
+    reset_and_start_timer();
+    int iters = gmres_multi(A, *B, X, restart, 10 * A.cols(), tolerance, method);
+    double multi_cycles = get_elapsed_mcycles();
+    if (iters < 0) {
+        printf("[gmres(%d) %s x %d]:\t[%.3f] M cycles, did not converge\n",
+               restart, method == MULTI_BLOCK ? "block" : "lockstep", k, 
+               multi_cycles);
+        delete B;
         return -1;
-    DEBUG_PRINT("... size: %lu\n", A->cols());
+    }
+
+    // Worst relative residual over the columns
+    MultiVector R(A.rows(), k);
+    std::vector<double> rnorm(k), bnorm(k), minus(k, -1.);
+    A.multiply(X, R);
+    R.add_ax(&minus[0], *B);
+    R.dot(R, &rnorm[0]);
+    B->dot(*B, &bnorm[0]);
+    double worst = 0;
+    for (int j = 0; j < k; j++)
+        if (bnorm[j] > 0)
+            worst = std::max(worst, sqrt(rnorm[j] / bnorm[j]));
+    printf("[gmres(%d) %s x %d]:\t[%.3f] M cycles, %d SpMMs (max rel. resid. %.3e)\n",
+           restart, method == MULTI_BLOCK ? "block" : "lockstep", k, multi_cycles,
+           iters, worst);
+
+    // One after the other, sharing one workspace
+    Vector b(A.rows()), x(A.cols());
+    int single_iters = 0;
+    reset_and_start_timer();
+    GmresWorkspace work(A.rows(), restart);
+    bool converged = true;
+    for (int j = 0; j < k && converged; j++) {
+        B->column(j, b);
+        int column_iters = gmres(A, b, x, restart, 10 * A.cols(), tolerance, NULL,
+                                 PRECONDITION_RIGHT, ORTHOGONALIZE_MGS, 1, &work);
+        converged = column_iters >= 0;
+        single_iters += column_iters;
+    }
+    double single_cycles = get_elapsed_mcycles();
+    if (!converged)
+        printf("[gmres(%d) x %d separately]:\t[%.3f] M cycles, did not converge\n",
+               restart, k, single_cycles);
+    else {
+        printf("[gmres(%d) x %d separately]:\t[%.3f] M cycles, %d SpMVs\n",
+           restart, k, single_cycles, single_iters);
+        printf("\t\t\t\t(%.2fx speedup from solving together)\n", 
+               single_cycles / multi_cycles);
+    }
+
+    X.to_mtf(out_path);
+    delete B;
+    return 0;
+}
+
 
-    DEBUG_PRINT("Loading b...\n");
-    Vector *b = Vector::vector_from_mtf(argv[2]);
-    if (b == NULL)
+static const char *preconditioners[] = { "none", "jacobi", "block-jacobi", "ilu0" };
+
+// The preconditioner called name (one of the above) for A, or NULL for
+// none.  Sets failed (and returns NULL) when A does not admit it.
+static Preconditioner *make_preconditioner (const char *name, const CRSMatrix &A,
+                                            int block_size, bool &failed)
+{
+    failed = false;
+    if (strcmp(name, "jacobi") == 0)
+        return new JacobiPreconditioner(A);
+    if (strcmp(name, "block-jacobi") == 0)
+        return new BlockJacobiPreconditioner(A, block_size);
+    if (strcmp(name, "ilu0") == 0) {
+        ILU0Preconditioner *ilu = new ILU0Preconditioner(A);
+        if (!ilu->ok()) {
+            delete ilu;
+            failed = true;
+            return NULL;
+        }
+        DEBUG_PRINT("ILU(0) levels: %d lower, %d upper\n",
+                    ilu->lower_levels(), ilu->upper_levels());
+        return ilu;
+    }
+    return NULL;
+}
+
+/* The right-hand side for a generated A: b = A x for x uniform in [0, 1),
+ * always the same, so the solution is well scaled and runs compare.
+ */
+static Vector *generated_rhs (const CRSMatrix &A)
+{
+    Vector x(A.cols());
+    srand48(1);
+    for (int i = 0; i < x.size(); i++)
+        x[i] = drand48();
+    Vector *b = new Vector(A.rows());
+    A.multiply(x, *b);
+    return b;
+}
+
+/* Benchmark mode: the SpMV throughput of each format and multiply, the
+ * vector kernels and one Arnoldi cycle with each orthogonalization, then
+ * the time to tolerance of every solver with every format and
+ * preconditioner, counting setup (the preconditioner, and the conversion
+ * for SELL) along with the solve.  CG only runs on symmetric A.  The CRS
+ * SpMV speedups are the first of the four "speedup" lines (SpMV, SELL,
+ * vector kernels, CGS2), which perf.ini's "! 1 4" picks out for perf.py.
+ */
+static void benchmark (CRSMatrix &A, const Vector &b, int restart, double tolerance,
+                       int sigma, int block_size)
+{
+    static const char *solvers[] = { "gmres", "cg", "bicgstab" };
+
+    reset_and_start_timer();
+    SellCSigmaMatrix S(A, sigma);
+    double sell_cycles = get_elapsed_mcycles();
+    printf("[sell setup]:\t\t[%.3f] M cycles\n", sell_cycles);
+    time_multiply(A, S, b);
+    time_vector_ops(A.rows());
+    time_orthogonalize(A, b, std::min((size_t)restart, A.cols() - 1));
+
+    bool symmetric = A.is_symmetric();
+    if (!symmetric)
+        printf("[cg]: A is not symmetric, skipped\n");
+    Vector x(A.cols());
+    double best_cycles = 1e30;
+    char best[64] = "none";
+    for (int p = 0; p < 4; p++) {
+        reset_and_start_timer();
+        bool failed;
+        Preconditioner *M = make_preconditioner(preconditioners[p], A, block_size,
+                                                failed);
+        double precond_cycles = get_elapsed_mcycles();
+        if (failed) {
+            printf("[%s]: not applicable to A, skipped\n", preconditioners[p]);
+            continue;
+        }
+
+        for (int format = 0; format < 2; format++) {
+            const Matrix &op = format == 1 ? (const Matrix &)S : (const Matrix &)A;
+            double setup_cycles = precond_cycles + (format == 1 ? sell_cycles : 0);
+            for (int i = 0; i < 3; i++) {
+                if (i == 1 && !symmetric)
+                    continue;
+                char name[64];
+                sprintf(name, "%s %s %s", solvers[i], preconditioners[p],
+                        format == 1 ? "sell" : "crs");
+
+                reset_and_start_timer();
+                int iters;
+                if (i == 0)
+                    iters = gmres(op, b, x, restart, 10 * A.cols(), tolerance, M);
+                else if (i == 1)
+                    iters = cg(op, b, x, 10 * A.cols(), tolerance, M);
+                else
+                    iters = bicgstab(op, b, x, 10 * A.cols(), tolerance, M);
+                double solve_cycles = get_elapsed_mcycles();
+
+                if (iters < 0) {
+                    printf("[%s]:	[%.3f] M cycles, did not converge\n", name, 
+                           solve_cycles);
+                    continue;
+                }
+                double total = setup_cycles + solve_cycles;
+                printf("[%s]:	[%.3f] M cycles to tolerance (%.3f setup), "
+                       "%d iterations\n", name, total, setup_cycles, iters);
+                if (total < best_cycles) {
+                    best_cycles = total;
+                    strcpy(best, name);
+                }
+            }
+        }
+        delete M;
+    }
+    printf("[fastest]: %s, [%.3f] M cycles to tolerance %g\n", best, best_cycles,
+           tolerance);
+}
+
+
+static void usage (const char *name)
+{
+    printf("usage: %s [--restart=<m>] [--precond=none|jacobi|block-jacobi|ilu0]\n"
+           "       [--block-size=<n>] [--left] [--orthogonalize=mgs|cgs2] [--s-step=<s>]\n"
+           "       [--format=crs|sell] [--sigma=<n>] [--cache]\n"
+           "       [--precision=double|mixed|both] [--tolerance=<err>]\n"
+           "       [--reorder=none|rcm] [--multi=lockstep|block]\n"
+           "       [--solver=gmres|cg|bicgstab|all] [--generate=<spec>] [--benchmark]\n"
+           "       <input-matrix> <input-rhs> <output-file>\n"
+           "With --multi, <input-rhs> may hold several columns, which are solved\n"
+           "for together (CRS, no preconditioner or reordering).\n"
+           "With --generate=<kind>:<n>[:<param>] the input files are left out and\n"
+           "A is a synthetic matrix, with b = A x for a random x; kind is one of\n"
+           "poisson2d, poisson3d, poisson3d-27, convdiff (param beta, default .5),\n"
+           "banded (param half-bandwidth, default 8) or powerlaw (param exponent,\n"
+           "default 2.5).  --benchmark times the SpMV, vector and orthogonalization\n"
+           "kernels, then every solver, format and preconditioner, instead of one\n"
+           "solve; <output-file> is then optional.\n",
+           name);
+    exit(-1);
+}
+
+
+int main (int argc, char **argv) 
+{
+    // Krylov basis size between restarts; memory is about (restart+1)*N
+    int restart = 50;
+    const char *precond = "none";
+    int block_size = 4;
+    PreconditionSide side = PRECONDITION_RIGHT;
+    Orthogonalization method = ORTHOGONALIZE_MGS;
+    int s_step = 1;
+    bool sell = false;
+    int sigma = 1024;
+    bool use_cache = false;
+    const char *precision = "double";
+    double tolerance = .01;
+    bool reorder = false;
+    const char *solver = "gmres";
+    bool multi = false;
+    MultiSolve multi_method = MULTI_LOCKSTEP;
+    const char *generate_spec = NULL;
+    bool bench = false;
+    char *paths[3];
+    int num_paths = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--restart=", 10) == 0) {
+            restart = atoi(argv[i] + 10);
+            if (restart <= 0)
+                usage(argv[0]);
+        }
+        else if (strncmp(argv[i], "--precond=", 10) == 0) {
+            precond = argv[i] + 10;
+            bool known = false;
+            for (int p = 0; p < 4; p++)
+                known |= strcmp(precond, preconditioners[p]) == 0;
+            if (!known)
+                usage(argv[0]);
+        }
+        else if (strncmp(argv[i], "--block-size=", 13) == 0) {
+            block_size = atoi(argv[i] + 13);
+            if (block_size <= 0)
+                usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "--left") == 0)
+            side = PRECONDITION_LEFT;
+        else if (strcmp(argv[i], "--orthogonalize=mgs") == 0)
+            method = ORTHOGONALIZE_MGS;
+        else if (strcmp(argv[i], "--orthogonalize=cgs2") == 0)
+            method = ORTHOGONALIZE_CGS2;
+        else if (strncmp(argv[i], "--s-step=", 9) == 0) {
+            s_step = atoi(argv[i] + 9);
+            if (s_step <= 0)
+                usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "--format=crs") == 0)
+            sell = false;
+        else if (strcmp(argv[i], "--format=sell") == 0)
+            sell = true;
+        else if (strcmp(argv[i], "--cache") == 0)
+            use_cache = true;
+        else if (strncmp(argv[i], "--precision=", 12) == 0) {
+            precision = argv[i] + 12;
+            if (strcmp(precision, "double") != 0 && strcmp(precision, "mixed") != 0 &&
+                strcmp(precision, "both") != 0)
+                usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "--reorder=none") == 0)
+            reorder = false;
+        else if (strcmp(argv[i], "--reorder=rcm") == 0)
+            reorder = true;
+        else if (strncmp(argv[i], "--solver=", 9) == 0) {
+            solver = argv[i] + 9;
+            if (strcmp(solver, "gmres") != 0 && strcmp(solver, "cg") != 0 &&
+                strcmp(solver, "bicgstab") != 0 && strcmp(solver, "all") != 0)
+                usage(argv[0]);
+        }
+        else if (strcmp(argv[i], "--multi=lockstep") == 0) {
+            multi = true;
+            multi_method = MULTI_LOCKSTEP;
+        }
+        else if (strcmp(argv[i], "--multi=block") == 0) {
+            multi = true;
+            multi_method = MULTI_BLOCK;
+        }
+        else if (strncmp(argv[i], "--tolerance=", 12) == 0) {
+            tolerance = atof(argv[i] + 12);
+            if (tolerance <= 0)
+                usage(argv[0]);
+        }
+        else if (strncmp(argv[i], "--generate=", 11) == 0)
+            generate_spec = argv[i] + 11;
+        else if (strcmp(argv[i], "--benchmark") == 0)
+            bench = true;
+        else if (strncmp(argv[i], "--sigma=", 8) == 0) {
+            sigma = atoi(argv[i] + 8);
+            if (sigma <= 0)
+                usage(argv[0]);
+        }
+        else if (num_paths == 3)
+            usage(argv[0]);
+        else
+            paths[num_paths++] = argv[i];
+    }
+    // The inputs, unless generated, then the output (optional when
+    // benchmarking)
+    int num_inputs = generate_spec != NULL ? 0 : 2;
+    if (num_paths != num_inputs + 1 && !(bench && num_paths == num_inputs))
+        usage(argv[0]);
+    if (multi && (generate_spec != NULL || bench))
+        usage(argv[0]);
+    char *out_path = num_paths > num_inputs ? paths[num_inputs] : NULL;
+
+    double setup_cycles, gmres_cycles;
+
+    CRSMatrix *A;
+    Vector *b;
+    reset_and_start_timer();
+    if (generate_spec != NULL) {
+        DEBUG_PRINT("Generating %s...\n", generate_spec);
+        A = CRSMatrix::generate(generate_spec);
+        if (A == NULL)
+            return -1;
+        b = generated_rhs(*A);
+        printf("[generate %s]:\t[%.3f] M cycles (%lu rows, %lu nonzeroes)\n", 
+               generate_spec, get_elapsed_mcycles(), A->rows(), A->nonzeroes());
+    }
+    else {
+        DEBUG_PRINT("Loading A...\n");
+        A = CRSMatrix::matrix_from_mtf(paths[0], use_cache);
+        if (A == NULL) 
+            return -1;
+        DEBUG_PRINT("... size: %lu\n", A->cols());
+
+        if (multi) {
+            printf("[load A]:\t\t[%.3f] M cycles\n", get_elapsed_mcycles());
+            int status = solve_multi(*A, paths[1], out_path, 
+                                     std::min((size_t)restart, A->cols()), 
+                                     tolerance, multi_method);
+            delete A;
+            return status;
+        }
+
+        DEBUG_PRINT("Loading b...\n");
+        b = Vector::vector_from_mtf(paths[1]);
+        if (b == NULL)
+            return -1;
+        printf("[load]:\t\t\t[%.3f] M cycles\n", get_elapsed_mcycles());
+    }
+
+    // Solve P A P^T (P x) = P b instead, and map x back at the end
+    std::vector<int> perm;
+    if (reorder) {
+        reset_and_start_timer();
+        perm = A->rcm_ordering();
+        CRSMatrix *B = A->permute(perm);
+        double reorder_cycles = get_elapsed_mcycles();
+
+        Vector *Pb = new Vector(b->size());
+        Pb->permute(*b, perm);
+
+        printf("[rcm]:\t\t\t[%.3f] M cycles (bandwidth %d -> %d)\n",
+               reorder_cycles, A->bandwidth(), B->bandwidth());
+        printf("[rcm]: spmv [%.3f] -> [%.3f] M cycles, v misses in a 32KB "
+               "direct-mapped cache %ld -> %ld\n", time_spmv(*A, *b), 
+               time_spmv(*B, *Pb), v_cache_misses(*A, 32 << 10), 
+               v_cache_misses(*B, 32 << 10));
+
+        delete A;
+        delete b;
+        A = B;
+        b = Pb;
+    }
+
+    if (bench) {
+        benchmark(*A, *b, std::min((size_t)restart, A->cols()), tolerance, sigma, 
+                  block_size);
+        if (out_path != NULL)
+            printf("Note: nothing is written to %s in benchmark mode\n", out_path);
+        delete A;
+        delete b;
+        return 0;
+    }
+
+    SellCSigmaMatrix *S = sell ? new SellCSigmaMatrix(*A, sigma) : NULL;
+
+    reset_and_start_timer();
+    bool failed;
+    Preconditioner *M = make_preconditioner(precond, *A, block_size, failed);
+    setup_cycles = get_elapsed_mcycles();
+    if (failed) {
+        fprintf(stderr, "Error: cannot build the %s preconditioner for A\n",
+                precond);
+        delete S;
+        delete A;
+        delete b;
         return -1;
+    }
 
-    Vector x(A->cols());
-    DEBUG_PRINT("Beginning gmres...\n");
-    gmres(*A, *b, x, A->cols() / 2, .01);
+    // With --solver=all every solver starts over in x, so the last converged
+    // solution is kept aside in x_solved and that is what gets written out.
+    Vector x(A->cols()), x_solved(A->cols());
+    bool solved = false;
+    restart = std::min((size_t)restart, A->cols());
+    double double_cycles = 0;
+    const Matrix &op = sell ? (const Matrix &)*S : (const Matrix &)*A;
+    bool all = strcmp(solver, "all") == 0;
+    if (strcmp(precision, "mixed") != 0 && (all || strcmp(solver, "gmres") == 0)) {
+        DEBUG_PRINT("Beginning gmres...\n");
+        reset_and_start_timer();
+        int iters = gmres(op, *b, x, restart, 10 * A->cols(), tolerance, M, side, 
+                          method, s_step);
+        gmres_cycles = get_elapsed_mcycles();
+
+        char ortho[32];
+        if (s_step > 1)
+            sprintf(ortho, "%d-step", s_step);
+        else
+            strcpy(ortho, method == ORTHOGONALIZE_CGS2 ? "cgs2" : "mgs");
+        if (iters < 0) {
+            printf("[gmres(%d) %s%s %s %s]:\t[%.3f] M cycles, did not converge\n",
+                   restart, precond, (M != NULL && side == PRECONDITION_LEFT) ? " left" : "",
+                   ortho, sell ? "sell" : "crs", gmres_cycles);
+            if (!all)
+                return -1;
+        }
+        else {
+            double_cycles = gmres_cycles;
+            printf("[gmres(%d) %s%s %s %s]:\t[%.3f] M cycles (%.3f setup), %d iterations\n",
+                   restart, precond, (M != NULL && side == PRECONDITION_LEFT) ? " left" : "",
+                   ortho, sell ? "sell" : "crs", setup_cycles + gmres_cycles, setup_cycles, 
+                   iters);
+            x_solved.copy(x);
+            solved = true;
+        }
+    }
+
+    // Time to the same tolerance with the constant-memory solvers; CG
+    // needs A (and M) symmetric positive definite.
+    static const char *solvers[] = { "cg", "bicgstab" };
+    bool symmetric = A->is_symmetric();
+    for (int i = 0; i < 2; i++) {
+        if (!all && strcmp(solver, solvers[i]) != 0)
+            continue;
+        if (i == 0 && !symmetric) {
+            printf("[cg]: A is not symmetric%s\n", all ? ", skipped" : ", cg may not converge");
+            if (all)
+                continue;
+        }
+        DEBUG_PRINT("Beginning %s...\n", solvers[i]);
+        reset_and_start_timer();
+        int iters = i == 0 ? cg(op, *b, x, 10 * A->cols(), tolerance, M) 
+                           : bicgstab(op, *b, x, 10 * A->cols(), tolerance, M);
+        gmres_cycles = get_elapsed_mcycles();
+
+        if (iters < 0) {
+            printf("[%s %s %s]:\t\t[%.3f] M cycles, did not converge\n",
+                   solvers[i], precond, sell ? "sell" : "crs", gmres_cycles);
+            if (!all)
+                return -1;
+            continue;
+        }
+        printf("[%s %s %s]:\t\t[%.3f] M cycles (%.3f setup), %d iterations\n",
+               solvers[i], precond, sell ? "sell" : "crs",
+               setup_cycles + gmres_cycles, setup_cycles, iters);
+        x_solved.copy(x);
+        solved = true;
+        if (double_cycles > 0)
+            printf("\t\t\t\t(%.2fx speedup over gmres)\n", 
+                   (setup_cycles + double_cycles) / (setup_cycles + gmres_cycles));
+    }
+
+    // The mixed-precision solver always uses CRS, CGS2 and no preconditioner
+    if (strcmp(precision, "double") != 0) {
+        DEBUG_PRINT("Beginning mixed-precision gmres...\n");
+        reset_and_start_timer();
+        int iters = gmres_mixed(*A, *b, x, restart, 10 * A->cols(), tolerance);
+        gmres_cycles = get_elapsed_mcycles();
+        if (iters < 0) {
+            printf("[gmres(%d) mixed]:\t\t[%.3f] M cycles, did not converge\n",
+                   restart, gmres_cycles);
+            return -1;
+        }
+
+        Vector resid(A->rows());
+        A->multiply(x, resid);
+        resid.subtract(*b);
+        printf("[gmres(%d) mixed]:\t\t[%.3f] M cycles, %d iterations (rel. resid. %.3e)\n",
+               restart, gmres_cycles, iters, resid.norm() / b->norm());
+        x_solved.copy(x);
+        solved = true;
+        if (double_cycles > 0)
+            printf("\t\t\t\t(%.2fx speedup from mixed precision)\n", 
+                   double_cycles / gmres_cycles);
+    }
+
+    if (!solved) {
+        printf("No solver converged, nothing is written to %s\n", out_path);
+        delete M;
+        delete S;
+        return -1;
+    }
 
     // Write result out to file
-    x.to_mtf(argv[argc-1]);
+    if (reorder) {
+        Vector x_file(x_solved.size());
+        x_file.unpermute(x_solved, perm);
+        x_file.to_mtf(out_path);
+    }
+    else
+        x_solved.to_mtf(out_path);
 
     // Compute residual (double-check)
 #ifdef DEBUG
     Vector bprime(b->size());
-    A->multiply(x, bprime);
+    A->multiply(x_solved, bprime);
     Vector resid(bprime.size(), &(bprime[0]));
     resid.subtract(*b);
     DEBUG_PRINT("residual error check: %lg\n", resid.norm() / b->norm());
 #endif
     // Print profiling results
     DEBUG_PRINT("-- Total mcycles to solve : %.03f --\n", gmres_cycles);
+
+    delete M;
+    delete S;
 }
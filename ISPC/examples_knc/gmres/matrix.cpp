@@ -45,23 +45,70 @@ extern "C" {
 /**************************************************************\
 | DenseMatrix methods
 \**************************************************************/
+// Column block size for the task-parallel dense kernels
+#define COLUMNS_PER_TASK 8192
+
 void DenseMatrix::multiply (const Vector &v, Vector &r) const 
 {
     // Dimensionality check
     ASSERT(v.size() == cols());
     ASSERT(r.size() == rows());
 
-    for (int i = 0; i < rows(); i++)
-        r[i] = v.dot(entries + i * num_cols);
+    ReductionScratch partial;
+    ispc::dense_multiply_tasks(entries, rows(), cols(), COLUMNS_PER_TASK,
+                               v.entries, r.entries, partial.get(scratch_size(rows())));
 }
 
-const Vector *DenseMatrix::row (size_t row) const {
-    return new Vector(num_cols, entries + row * num_cols, true);
+void DenseMatrix::multiply_leading_rows (const Vector &v, Vector &r,
+                                         ReductionScratch *scratch) const
+{
+    ASSERT(v.size() == cols());
+    ASSERT(r.size() <= rows());
+
+    ReductionScratch local;
+    ispc::dense_multiply_tasks(entries, r.size(), cols(), COLUMNS_PER_TASK,
+                               v.entries, r.entries,
+                               reduction_scratch(scratch, local, scratch_size(r.size())));
 }
 
-void DenseMatrix::row (size_t row, Vector &r) {
-    r.entries = entries + row * cols();
-    r._size   = cols();
+void DenseMatrix::subtract_transpose_multiply_leading_rows (const Vector &h, Vector &v) const
+{
+    ASSERT(v.size() == cols());
+    ASSERT(h.size() <= rows());
+
+    ispc::dense_transpose_multiply_sub_tasks(entries, h.size(), cols(),
+                                             COLUMNS_PER_TASK, h.entries,
+                                             v.entries);
+}
+
+void DenseMatrix::multiply_leading_rows_block (int k, int first, int count, double *r,
+                                               ReductionScratch *scratch) const
+{
+    ASSERT(k <= rows() && first + count <= rows());
+    ReductionScratch local;
+    ispc::dense_block_multiply_tasks(entries, k, cols(), COLUMNS_PER_TASK,
+                                     first, count, r,
+                                     reduction_scratch(scratch, local, scratch_size(k, count)));
+}
+
+void DenseMatrix::subtract_transpose_multiply_leading_rows_block (int k, const double *h,
+                                                                  int first, int count)
+{
+    ASSERT(k <= first && first + count <= rows());
+    ispc::dense_block_transpose_multiply_sub_tasks(entries, k, cols(), COLUMNS_PER_TASK,
+                                                   h, first, count);
+}
+
+void DenseMatrix::lower_multiply_rows_block (const double *L, int first, int count)
+{
+    ASSERT(first + count <= rows());
+    ispc::dense_block_lower_multiply_tasks(entries, cols(), COLUMNS_PER_TASK,
+                                           L, first, count);
+}
+
+size_t DenseMatrix::scratch_size (int rows, int count) const
+{
+    return (cols() + COLUMNS_PER_TASK - 1) / COLUMNS_PER_TASK * rows * count;
 }
 
 void DenseMatrix::set_row(size_t row, const Vector &v) 
@@ -70,47 +117,366 @@ void DenseMatrix::set_row(size_t row, const Vector &v)
     memcpy(entries + row * num_cols, v.entries, num_cols * sizeof(double));
 }
 
-
 /**************************************************************\
-| CRSMatrix Methods
+| HessenbergMatrix methods
 \**************************************************************/
+HessenbergMatrix::HessenbergMatrix (size_t size_r, size_t size_c, int subdiagonals)
+    : Matrix(size_r, size_c), num_sub(subdiagonals), offsets(size_c + 1)
+{
+    offsets[0] = 0;
+    for (size_t c = 0; c < size_c; c++)
+        offsets[c+1] = offsets[c] + std::min(size_r, c + subdiagonals + 1);
+    entries.assign(offsets[size_c], 0.);
+}
+
+// r = H v, as one axpy per (contiguous) column
+void HessenbergMatrix::multiply (const Vector &v, Vector &r) const
+{
+    ASSERT(v.size() == cols());
+    ASSERT(r.size() == rows());
+
+    r.zero();
+    for (size_t c = 0; c < cols(); c++)
+        ispc::vector_add_ax(&r[0], v[c], column(c), column_length(c));
+}
+
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <vector>
+#include <string>
 #include <algorithm>
+#include <utility>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 
-struct entry {
-    int row;
-    int col;
-    double val;
+#define ERR_OUT(...) { fprintf(stderr, __VA_ARGS__); return NULL; }
+
+/**************************************************************\
+| Matrix Market parsing
+\**************************************************************/
+// The body of a Matrix Market file is mapped into memory and split at
+// line boundaries into one chunk per hardware thread; each thread parses
+// its chunk into its own arrays.
+
+static int num_threads ()
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+// Runs fn on each element of work in its own thread and waits for all.
+template <typename T>
+static void run_threads (std::vector<T> &work, void *(*fn)(void *))
+{
+    std::vector<pthread_t> threads(work.size());
+    for (int i = 0; i < work.size(); i++)
+        pthread_create(&threads[i], NULL, fn, &work[i]);
+    for (int i = 0; i < work.size(); i++)
+        pthread_join(threads[i], NULL);
+}
+
+struct ParseChunk {
+    const char          *begin, *end;
+    int                  fields;   // 1 (array), 2 (pattern) or 3 per line
+    std::vector<int>     rows;
+    std::vector<int>     cols;
+    std::vector<double>  vals;
+    bool                 error;
 };
 
-bool compare_entries(struct entry i, struct entry j) {
-    if (i.row < j.row)
-        return true;
-    if (i.row > j.row)
+static inline const char *skip_space (const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        p++;
+    return p;
+}
+
+static inline bool parse_int (const char *&p, const char *end, int &value)
+{
+    p = skip_space(p, end);
+    if (p == end || *p < '0' || *p > '9')
         return false;
+    value = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+        value = value * 10 + (*p++ - '0');
+    return true;
+}
+
+// strtod needs a terminated string, which the mapped file does not
+// guarantee at its end, so the token is copied out first.
+static inline bool parse_double (const char *&p, const char *end, double &value)
+{
+    char buf[64];
+    p = skip_space(p, end);
+    int n = 0;
+    while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && n < sizeof(buf) - 1)
+        buf[n++] = *p++;
+    buf[n] = '\0';
 
-    return i.col < j.col;
+    char *tail;
+    value = strtod(buf, &tail);
+    return n > 0 && *tail == '\0';
 }
 
-#define ERR_OUT(...) { fprintf(stderr, __VA_ARGS__); return NULL; }
+static void *parse_chunk (void *arg)
+{
+    ParseChunk *chunk = (ParseChunk *) arg;
+    const char *p = chunk->begin;
+    chunk->error = false;
 
-CRSMatrix *CRSMatrix::matrix_from_mtf (char *path) {
-    FILE *f;
-    MM_typecode matcode;
+    while (p < chunk->end) {
+        const char *eol = (const char *) memchr(p, '\n', chunk->end - p);
+        if (eol == NULL)
+            eol = chunk->end;
 
-    int m, n, nz;
+        const char *q = skip_space(p, eol);
+        if (q < eol && *q != '%') {
+            int row = 0, col = 0;
+            double val = 1;
+            bool ok = true;
+            if (chunk->fields > 1)
+                ok = parse_int(q, eol, row) && parse_int(q, eol, col);
+            if (ok && chunk->fields != 2)
+                ok = parse_double(q, eol, val);
+            if (!ok) {
+                chunk->error = true;
+                return NULL;
+            }
+            if (chunk->fields > 1) {
+                chunk->rows.push_back(row - 1);
+                chunk->cols.push_back(col - 1);
+            }
+            chunk->vals.push_back(val);
+        }
+        p = eol + 1;
+    }
+    return NULL;
+}
 
-    if ((f = fopen(path, "r")) == NULL) 
-        ERR_OUT("Error: %s does not name a valid/readable file.\n", path);
+/* Reads the banner and size line of path with mmio and parses the rest of
+ * the file in parallel.  Returns false (after printing why) on failure.
+ */
+static bool parse_mtf (char *path, MM_typecode &matcode, int &m, int &n, int &nz,
+                       std::vector<ParseChunk> &chunks)
+{
+    FILE *f;
+    if ((f = fopen(path, "r")) == NULL) {
+        fprintf(stderr, "Error: %s does not name a valid/readable file.\n", path);
+        return false;
+    }
 
+    bool ok = false;
     if (mm_read_banner(f, &matcode) != 0)
-        ERR_OUT("Error: Could not process Matrix Market banner.\n");
+        fprintf(stderr, "Error: Could not process Matrix Market banner.\n");
+    else if (mm_is_complex(matcode)) 
+        fprintf(stderr, "Error: Application does not support complex numbers.\n");
+    else if (mm_is_dense(matcode)) {
+        ok = mm_read_mtx_array_size(f, &m, &n) == 0;
+        nz = m * n;
+    }
+    else
+        ok = mm_read_mtx_crd_size(f, &m, &n, &nz) == 0;
+    if (!ok) {
+        fprintf(stderr, "Error: could not read matrix size from file.\n");
+        fclose(f);
+        return false;
+    }
+    long body = ftell(f);
+    fclose(f);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: cannot map %s\n", path);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        fprintf(stderr, "Error: cannot map %s\n", path);
+        close(fd);
+        return false;
+    }
+
+    const char *data = NULL;
+    if (st.st_size > body) {
+        data = (const char *) mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            fprintf(stderr, "Error: cannot map %s\n", path);
+            close(fd);
+            return false;
+        }
+        madvise((void *) data, st.st_size, MADV_SEQUENTIAL);
+    }
 
-    if (mm_is_complex(matcode)) 
-        ERR_OUT("Error: Application does not support complex numbers.\n")
+    // Chunks of at least 64KB, and a single empty one for an empty body
+    int fields = mm_is_dense(matcode) ? 1 : mm_is_pattern(matcode) ? 2 : 3;
+    int num_chunks = 1;
+    if (data != NULL)
+        num_chunks = std::max(1, std::min(num_threads(), 
+                                          (int)((st.st_size - body) >> 16)));
+    chunks.resize(num_chunks);
+    const char *end = data ? data + st.st_size : NULL;
+    const char *p = data ? data + body : NULL;
+    for (int i = 0; i < num_chunks; i++) {
+        const char *split = data + body + (st.st_size - body) * (i + 1) / num_chunks;
+        if (i == num_chunks - 1)
+            split = end;
+        else {
+            split = (const char *) memchr(split, '\n', end - split);
+            split = split ? split + 1 : end;
+        }
+        chunks[i].begin  = p;
+        chunks[i].end    = std::max(p, split);
+        chunks[i].fields = fields;
+        p = chunks[i].end;
+    }
+    if (data != NULL) {
+        run_threads(chunks, parse_chunk);
+        munmap((void *) data, st.st_size);
+    }
+    close(fd);
+
+    size_t count = 0;
+    for (int i = 0; i < num_chunks; i++) {
+        if (chunks[i].error) {
+            fprintf(stderr, "Error: malformed entry in %s\n", path);
+            return false;
+        }
+        count += chunks[i].vals.size();
+    }
+    if (count != nz) {
+        fprintf(stderr, "Error: %s has %lu entries, expected %d\n", path, count, nz);
+        return false;
+    }
+    return true;
+}
+
+/**************************************************************\
+| CRS construction
+\**************************************************************/
+// Built from the parsed chunks by a counting sort on the row: the threads
+// count entries per row, then scatter them to their rows' slots, then
+// sort each row by column.  Symmetric files store one triangle, which
+// is mirrored on the way.
+
+struct BuildChunk {
+    const ParseChunk  *parsed;
+    bool               symmetric;
+    int                rows, cols;
+    int               *counts;     // rows+1 entries, shifted by one
+    int               *cursors;    // next free slot in each row
+    int               *columns;
+    double            *entries;
+    int                row_begin, row_end;
+    const int         *row_offsets;
+    bool               error;
+};
+
+static void *count_rows (void *arg)
+{
+    BuildChunk *chunk = (BuildChunk *) arg;
+    const ParseChunk &p = *chunk->parsed;
+    chunk->error = false;
+
+    for (int i = 0; i < p.vals.size(); i++) {
+        int row = p.rows[i], col = p.cols[i];
+        if (row < 0 || row >= chunk->rows || col < 0 || col >= chunk->cols) {
+            chunk->error = true;
+            return NULL;
+        }
+        __sync_fetch_and_add(&chunk->counts[row + 1], 1);
+        if (chunk->symmetric && row != col)
+            __sync_fetch_and_add(&chunk->counts[col + 1], 1);
+    }
+    return NULL;
+}
+
+static void *scatter_rows (void *arg)
+{
+    BuildChunk *chunk = (BuildChunk *) arg;
+    const ParseChunk &p = *chunk->parsed;
+
+    for (int i = 0; i < p.vals.size(); i++) {
+        int row = p.rows[i], col = p.cols[i];
+        int slot = __sync_fetch_and_add(&chunk->cursors[row], 1);
+        chunk->columns[slot] = col;
+        chunk->entries[slot] = p.vals[i];
+        if (chunk->symmetric && row != col) {
+            slot = __sync_fetch_and_add(&chunk->cursors[col], 1);
+            chunk->columns[slot] = row;
+            chunk->entries[slot] = p.vals[i];
+        }
+    }
+    return NULL;
+}
+
+// Rows up to this length are insertion sorted; longer ones (dense rows,
+// coupling equations) go through std::sort, which stays O(n log n).
+#define SORT_ROWS_INSERTION_MAX 32
+
+static bool column_less (const std::pair<int, double> &a,
+                         const std::pair<int, double> &b)
+{
+    return a.first < b.first;
+}
+
+static void *sort_rows (void *arg)
+{
+    BuildChunk *chunk = (BuildChunk *) arg;
+    int *columns = chunk->columns;
+    double *entries = chunk->entries;
+    std::vector<std::pair<int, double> > pairs;
+
+    for (int row = chunk->row_begin; row < chunk->row_end; row++) {
+        int begin = chunk->row_offsets[row], end = chunk->row_offsets[row+1];
+        if (end - begin > SORT_ROWS_INSERTION_MAX) {
+            pairs.resize(end - begin);
+            for (int i = begin; i < end; i++)
+                pairs[i - begin] = std::make_pair(columns[i], entries[i]);
+            std::sort(pairs.begin(), pairs.end(), column_less);
+            for (int i = begin; i < end; i++) {
+                columns[i] = pairs[i - begin].first;
+                entries[i] = pairs[i - begin].second;
+            }
+            continue;
+        }
+        for (int i = begin + 1; i < end; i++) {
+            int col = columns[i];
+            double val = entries[i];
+            int j = i;
+            for (; j > begin && columns[j-1] > col; j--) {
+                columns[j] = columns[j-1];
+                entries[j] = entries[j-1];
+            }
+            columns[j] = col;
+            entries[j] = val;
+        }
+    }
+    return NULL;
+}
+
+/**************************************************************\
+| CRSMatrix Methods
+\**************************************************************/
+CRSMatrix *CRSMatrix::matrix_from_mtf (char *path, bool use_cache) {
+    if (use_cache) {
+        CRSMatrix *M = from_cache(path);
+        if (M != NULL)
+            return M;
+    }
+
+    MM_typecode matcode;
+    int m, n, nz;
+    std::vector<ParseChunk> parsed;
+
+    if (!parse_mtf(path, matcode, m, n, nz, parsed))
+        return NULL;
 
     if (mm_is_dense(matcode))
         ERR_OUT("Error: supplied matrix is dense (should be sparse.)\n");
@@ -118,104 +484,385 @@ CRSMatrix *CRSMatrix::matrix_from_mtf (char *path) {
     if (!mm_is_matrix(matcode))
         ERR_OUT("Error: %s does not encode a matrix.\n", path)
 
-    if (mm_read_mtx_crd_size(f, &m, &n, &nz) != 0)
-        ERR_OUT("Error: could not read matrix size from file.\n");
-
     if (m != n)
         ERR_OUT("Error: Application does not support non-square matrices.");
 
-    std::vector<struct entry> entries;
-    entries.resize(nz);
+    if (mm_is_skew(matcode) || mm_is_hermitian(matcode))
+        ERR_OUT("Error: Application does not support skew/hermitian matrices.\n");
+
+    bool symmetric = mm_is_symmetric(matcode);
 
-    for (int i = 0; i < nz; i++) {
-        fscanf(f, "%d %d %lg\n", &entries[i].row, &entries[i].col, &entries[i].val);
-        // Adjust from 1-based to 0-based
-        entries[i].row--;
-        entries[i].col--;
+    std::vector<int> counts(m + 1, 0);
+    std::vector<BuildChunk> chunks(parsed.size());
+    for (int i = 0; i < chunks.size(); i++) {
+        chunks[i].parsed    = &parsed[i];
+        chunks[i].symmetric = symmetric;
+        chunks[i].rows      = m;
+        chunks[i].cols      = n;
+        chunks[i].counts    = &counts[0];
     }
+    run_threads(chunks, count_rows);
+    for (int i = 0; i < chunks.size(); i++)
+        if (chunks[i].error)
+            ERR_OUT("Error: entry out of range in %s\n", path);
 
-    sort(entries.begin(), entries.end(), compare_entries);
+    for (int row = 0; row < m; row++)
+        counts[row + 1] += counts[row];
 
-    CRSMatrix *M = new CRSMatrix(m, n, nz);
-    int cur_row = -1;
-    for (int i = 0; i < nz; i++) {
-        while (entries[i].row > cur_row)
-            M->row_offsets[++cur_row] = i;
-        M->entries[i] = entries[i].val;
-        M->columns[i] = entries[i].col;
+    CRSMatrix *M = new CRSMatrix(m, n, counts[m]);
+    M->row_offsets = counts;
+    std::vector<int> cursors(counts.begin(), counts.end() - 1);
+
+    int rows_per_chunk = (m + chunks.size() - 1) / chunks.size();
+    for (int i = 0; i < chunks.size(); i++) {
+        chunks[i].cursors     = &cursors[0];
+        chunks[i].columns     = &M->columns[0];
+        chunks[i].entries     = &M->entries[0];
+        chunks[i].row_begin   = std::min(m, i * rows_per_chunk);
+        chunks[i].row_end     = std::min(m, (i + 1) * rows_per_chunk);
+        chunks[i].row_offsets = &M->row_offsets[0];
+    }
+    if (M->_nonzeroes > 0) {
+        run_threads(chunks, scatter_rows);
+        run_threads(chunks, sort_rows);
     }
 
+    M->partition_rows(std::max(1, std::min(m, (int)M->_nonzeroes / NONZEROES_PER_TASK)));
+
+    if (use_cache)
+        M->to_cache(path);
+
     return M;
 }
 
-Vector *Vector::vector_from_mtf (char *path) {
-    FILE *f;
-    MM_typecode matcode;
+/**************************************************************\
+| CRSMatrix binary cache
+\**************************************************************/
+// A cache file is this header followed by the raw entries, row_offsets
+// and columns arrays.  It is only used while the size and modification
+// time of the .mtx file it was built from still match.
+struct CRSCacheHeader {
+    char     magic[8];
+    int64_t  source_size;
+    int64_t  source_mtime;
+    int64_t  source_mtime_nsec;
+    int64_t  rows;
+    int64_t  cols;
+    int64_t  nonzeroes;
+    int64_t  reserved[1];
+};
 
-    int m, n, nz;
+static const char CRS_CACHE_MAGIC[8] = { 'G', 'M', 'R', 'E', 'S', 'C', 'R', '1' };
 
-    if ((f = fopen(path, "r")) == NULL) 
-        ERR_OUT("Error: %s does not name a valid/readable file.\n", path);
+static std::string cache_path (const char *path)
+{
+    return std::string(path) + ".crs";
+}
 
-    if (mm_read_banner(f, &matcode) != 0)
-        ERR_OUT("Error: Could not process Matrix Market banner.\n");
+CRSMatrix *CRSMatrix::from_cache (char *path)
+{
+    struct stat src, st;
+    if (stat(path, &src) != 0)
+        return NULL;
 
-    if (mm_is_complex(matcode)) 
-        ERR_OUT("Error: Application does not support complex numbers.\n")
+    std::string cpath = cache_path(path);
+    int fd = open(cpath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) != 0 || st.st_size < sizeof(CRSCacheHeader)) {
+        close(fd);
+        return NULL;
+    }
 
-    if (mm_is_dense(matcode)) {
-        if (mm_read_mtx_array_size(f, &m, &n) != 0)
-            ERR_OUT("Error: could not read matrix size from file.\n");
-    } else {
-        if (mm_read_mtx_crd_size(f, &m, &n, &nz) != 0)
-            ERR_OUT("Error: could not read matrix size from file.\n");
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+
+    const CRSCacheHeader *h = (const CRSCacheHeader *) data;
+    size_t expected = sizeof(CRSCacheHeader) + h->nonzeroes * sizeof(double) +
+        (h->rows + 1 + h->nonzeroes) * sizeof(int);
+
+    CRSMatrix *M = NULL;
+    if (memcmp(h->magic, CRS_CACHE_MAGIC, sizeof(h->magic)) == 0 &&
+        h->source_size == src.st_size && h->source_mtime == src.st_mtime &&
+        h->source_mtime_nsec == src.st_mtim.tv_nsec &&
+        st.st_size == expected) {
+        DEBUG_PRINT("Reading cached matrix %s\n", cpath.c_str());
+
+        M = new CRSMatrix(h->rows, h->cols, h->nonzeroes);
+        const double *entries = (const double *) (h + 1);
+        const int *row_offsets = (const int *) (entries + h->nonzeroes);
+        const int *columns = row_offsets + h->rows + 1;
+        std::copy(entries, entries + h->nonzeroes, M->entries.begin());
+        std::copy(row_offsets, row_offsets + h->rows + 1, M->row_offsets.begin());
+        std::copy(columns, columns + h->nonzeroes, M->columns.begin());
+
+        M->partition_rows(std::max(1, std::min((int)h->rows, 
+                                               (int)h->nonzeroes / NONZEROES_PER_TASK)));
+    }
+    munmap(data, st.st_size);
+    return M;
+}
+
+void CRSMatrix::to_cache (char *path) const
+{
+    struct stat src;
+    if (stat(path, &src) != 0)
+        return;
+
+    CRSCacheHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CRS_CACHE_MAGIC, sizeof(h.magic));
+    h.source_size  = src.st_size;
+    h.source_mtime = src.st_mtime;
+    h.source_mtime_nsec = src.st_mtim.tv_nsec;
+    h.rows         = rows();
+    h.cols         = cols();
+    h.nonzeroes    = _nonzeroes;
+
+    // Written under a temporary name and renamed, so a concurrent reader
+    // never sees a partial file.
+    std::string cpath = cache_path(path);
+    std::string tmp = cpath + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (f == NULL) {
+        fprintf(stderr, "Warning: cannot write matrix cache %s\n", cpath.c_str());
+        return;
+    }
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+        fwrite(&entries[0], sizeof(double), _nonzeroes, f) == _nonzeroes &&
+        fwrite(&row_offsets[0], sizeof(int), rows() + 1, f) == rows() + 1 &&
+        fwrite(&columns[0], sizeof(int), _nonzeroes, f) == _nonzeroes;
+    ok = (fclose(f) == 0) && ok;
+
+    if (!ok || rename(tmp.c_str(), cpath.c_str()) != 0) {
+        fprintf(stderr, "Warning: cannot write matrix cache %s\n", cpath.c_str());
+        unlink(tmp.c_str());
     }
+}
+
+/**************************************************************\
+| Vector I/O
+\**************************************************************/
+Vector *Vector::vector_from_mtf (char *path) {
+    MM_typecode matcode;
+    int m, n, nz;
+    std::vector<ParseChunk> parsed;
+
+    if (!parse_mtf(path, matcode, m, n, nz, parsed))
+        return NULL;
+
     if (n != 1)
         ERR_OUT("Error: %s does not describe a vector.\n", path);
 
     Vector *x = new Vector(m);
 
     if (mm_is_dense(matcode)) {
-        double val;
-        for (int i = 0; i < m; i++) {
-            fscanf(f, "%lg\n", &val);
-            (*x)[i] = val;
+        // Values are in order, so each chunk lands right after the last
+        int i = 0;
+        for (int c = 0; c < parsed.size(); c++) {
+            const std::vector<double> &vals = parsed[c].vals;
+            if (!vals.empty())
+                memcpy(&(*x)[i], &vals[0], vals.size() * sizeof(double));
+            i += vals.size();
         }
     }
     else {
         x->zero();
-        double val;
-        int row;
-        int col;
-        for (int i = 0; i < nz; i++) {
-            fscanf(f, "%d %d %lg\n", &row, &col, &val);
-            (*x)[row-1] = val;
-        }
+        for (int c = 0; c < parsed.size(); c++)
+            for (int i = 0; i < parsed[c].vals.size(); i++) {
+                int row = parsed[c].rows[i];
+                if (row < 0 || row >= m) {
+                    delete x;
+                    ERR_OUT("Error: entry out of range in %s\n", path);
+                }
+                (*x)[row] = parsed[c].vals[i];
+            }
     }
     return x;
 }
 
+/* An n x k Matrix Market array (stored column by column), or a
+ * coordinate file, read as k interleaved vectors.
+ */
+MultiVector *MultiVector::multivector_from_mtf (char *path) {
+    MM_typecode matcode;
+    int m, n, nz;
+    std::vector<ParseChunk> parsed;
+
+    if (!parse_mtf(path, matcode, m, n, nz, parsed))
+        return NULL;
+
+    if (n < 1)
+        ERR_OUT("Error: %s has no columns.\n", path);
+
+    MultiVector *X = new MultiVector(m, n);
+
+    if (mm_is_dense(matcode)) {
+        size_t i = 0;
+        for (int c = 0; c < parsed.size(); c++)
+            for (int j = 0; j < parsed[c].vals.size(); j++, i++)
+                (*X)(i % m, i / m) = parsed[c].vals[j];
+    }
+    else {
+        X->zero();
+        for (int c = 0; c < parsed.size(); c++)
+            for (int i = 0; i < parsed[c].vals.size(); i++) {
+                int row = parsed[c].rows[i], col = parsed[c].cols[i];
+                if (row < 0 || row >= m || col < 0 || col >= n) {
+                    delete X;
+                    ERR_OUT("Error: entry out of range in %s\n", path);
+                }
+                (*X)(row, col) = parsed[c].vals[i];
+            }
+    }
+    return X;
+}
+
 #define ERR(...) { fprintf(stderr, __VA_ARGS__); exit(-1); }
 
-void Vector::to_mtf (char *path) {
-    FILE *f;
-    MM_typecode matcode;
+/**************************************************************\
+| Dense output
+\**************************************************************/
+// Vectors and multivectors go out column by column (Matrix Market array
+// order), as text or, for a path ending in .bin, as the raw doubles.
+// Text is formatted in parallel: each thread formats a chunk of entries
+// into its own slice of one buffer, the slices are packed together, and
+// the whole file is handed to a single write().
+
+// "-1.2345678901234567e-308\n", the longest %.17g entry
+#define MAX_ENTRY_CHARS 25
 
-    mm_initialize_typecode(&matcode);
-    mm_set_matrix(&matcode);
-    mm_set_real(&matcode);
-    mm_set_dense(&matcode);
-    mm_set_general(&matcode);
+// Entries per thread below which formatting is not worth a thread
+#define ENTRIES_PER_THREAD 16384
 
-    if ((f = fopen(path, "w")) == NULL)
+// The shortest of %.15g, %.16g and %.17g that reads back as exactly v
+// (17 significant digits always do), then a newline; returns the length.
+static inline int format_double (char *out, double v)
+{
+    int len;
+    for (int digits = 15; ; digits++) {
+        len = snprintf(out, MAX_ENTRY_CHARS, "%.*g", digits, v);
+        if (digits == 17 || strtod(out, NULL) == v)
+            break;
+    }
+    out[len] = '\n';
+    return len + 1;
+}
+
+struct FormatChunk {
+    const double *data;          // rows x cols, row-major
+    size_t        rows, cols;
+    size_t        begin, end;    // entries, in column-major order
+    char         *out;           // room for MAX_ENTRY_CHARS per entry
+    size_t        length;
+};
+
+static void *format_chunk (void *arg)
+{
+    FormatChunk *chunk = (FormatChunk *) arg;
+    char *p = chunk->out;
+    for (size_t e = chunk->begin; e < chunk->end; e++) {
+        size_t i = e % chunk->rows, j = e / chunk->rows;
+        p += format_double(p, chunk->data[i * chunk->cols + j]);
+    }
+    chunk->length = p - chunk->out;
+    return NULL;
+}
+
+static bool write_all (int fd, const char *p, size_t size)
+{
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+// data is rows x cols, row-major
+static void write_dense (const char *path, const double *data, size_t rows,
+                         size_t cols)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
         ERR("Error: cannot open/write to %s\n", path);
 
-    mm_write_banner(f, matcode);
-    mm_write_mtx_array_size(f, size(), 1);
-    for (int i = 0; i < size(); i++)
-        fprintf(f, "%lg\n", entries[i]);
+    size_t n = rows * cols;
+    size_t path_len = strlen(path);
+    bool ok;
+    if (path_len >= 4 && strcmp(path + path_len - 4, ".bin") == 0) {
+        if (cols == 1)
+            ok = write_all(fd, (const char *) data, n * sizeof(double));
+        else {
+            std::vector<double> column_major(n);
+            for (size_t j = 0; j < cols; j++)
+                for (size_t i = 0; i < rows; i++)
+                    column_major[j * rows + i] = data[i * cols + j];
+            ok = write_all(fd, (const char *) &column_major[0], n * sizeof(double));
+        }
+    }
+    else {
+        char header[128];
+        int header_len = snprintf(header, sizeof(header), "%s matrix array real general\n%lu %lu\n",
+                                  MatrixMarketBanner, (unsigned long) rows,
+                                  (unsigned long) cols);
+        char *buffer = (char *) malloc(header_len + n * MAX_ENTRY_CHARS);
+        if (buffer == NULL)
+            ERR("Error: out of memory writing %s\n", path);
+        memcpy(buffer, header, header_len);
+
+        int num_chunks = std::max(1, std::min(num_threads(), (int)(n / ENTRIES_PER_THREAD)));
+        std::vector<FormatChunk> chunks(num_chunks);
+        for (int c = 0; c < num_chunks; c++) {
+            chunks[c].data  = data;
+            chunks[c].rows  = rows;
+            chunks[c].cols  = cols;
+            chunks[c].begin = n * c / num_chunks;
+            chunks[c].end   = n * (c + 1) / num_chunks;
+            chunks[c].out   = buffer + header_len + chunks[c].begin * MAX_ENTRY_CHARS;
+        }
+        run_threads(chunks, format_chunk);
 
-    fclose(f);
+        size_t size = header_len;
+        for (int c = 0; c < num_chunks; c++) {
+            memmove(buffer + size, chunks[c].out, chunks[c].length);
+            size += chunks[c].length;
+        }
+        ok = write_all(fd, buffer, size);
+        free(buffer);
+    }
+
+    if (close(fd) != 0)
+        ok = false;
+    if (!ok)
+        ERR("Error: cannot write to %s\n", path);
+}
+
+void Vector::to_mtf (char *path) {
+    write_dense(path, entries, size(), 1);
+}
+
+void MultiVector::to_mtf (char *path) {
+    write_dense(path, data(), rows(), cols());
+}
+
+void CRSMatrix::partition_rows (int num_blocks)
+{
+    ASSERT(num_blocks > 0);
+    row_blocks.resize(num_blocks + 1);
+    row_blocks[0] = 0;
+    for (int i = 1; i < num_blocks; i++) {
+        int target = (int)((long long)_nonzeroes * i / num_blocks);
+        row_blocks[i] = std::lower_bound(row_offsets.begin(), row_offsets.end(),
+                                         target) - row_offsets.begin();
+    }
+    row_blocks[num_blocks] = rows();
 }
 
 void CRSMatrix::multiply (const Vector &v, Vector &r) const
@@ -223,10 +870,49 @@ void CRSMatrix::multiply (const Vector &v, Vector &r) const
     ASSERT(v.size() == cols());
     ASSERT(r.size() == rows());
 
+    if (_nonzeroes == 0) {
+        r.zero();
+        return;
+    }
+
+    switch (multiply_mode) {
+    case MULTIPLY_SERIAL:
+        multiply_serial(v, r);
+        break;
+    case MULTIPLY_ISPC:
+        ispc::sparse_multiply(&entries[0], &columns[0], &row_offsets[0],
+                              rows(), &v[0], &r[0]);
+        break;
+    case MULTIPLY_ISPC_TASKS:
+        ispc::sparse_multiply_tasks(&entries[0], &columns[0], &row_offsets[0],
+                                    &row_blocks[0], row_blocks.size() - 1,
+                                    &v[0], &r[0]);
+        break;
+    }
+}
+
+void CRSMatrix::multiply (const MultiVector &V, MultiVector &R) const
+{
+    ASSERT(V.rows() == cols());
+    ASSERT(R.rows() == rows());
+    ASSERT(V.cols() == R.cols());
+
+    if (_nonzeroes == 0) {
+        R.zero();
+        return;
+    }
+
+    ispc::sparse_multiply_multi_tasks(&entries[0], &columns[0], &row_offsets[0],
+                                      &row_blocks[0], row_blocks.size() - 1,
+                                      V.cols(), V.data(), R.data());
+}
+
+void CRSMatrix::multiply_serial (const Vector &v, Vector &r) const
+{
     for (int row = 0; row < rows(); row++) 
     {
         int row_offset = row_offsets[row];
-        int next_offset = ((row + 1 == rows()) ? _nonzeroes : row_offsets[row + 1]);
+        int next_offset = row_offsets[row + 1];
 
         double sum = 0;
         for (int i = row_offset; i < next_offset; i++)
@@ -240,7 +926,362 @@ void CRSMatrix::multiply (const Vector &v, Vector &r) const
 void CRSMatrix::zero ( ) 
 {
     entries.clear();
-    row_offsets.clear();
+    row_offsets.assign(rows() + 1, 0);
     columns.clear();
+    row_blocks.clear();
     _nonzeroes = 0;
 }
+
+/**************************************************************\
+| CRSMatrix reordering
+\**************************************************************/
+bool CRSMatrix::is_symmetric () const
+{
+    if (rows() != cols())
+        return false;
+    for (int row = 0; row < rows(); row++)
+        for (int j = row_offsets[row]; j < row_offsets[row+1]; j++) {
+            // Rows are sorted by column, so A(c, row) is a binary search away
+            int c = columns[j];
+            const int *begin = &columns[0] + row_offsets[c];
+            const int *end = &columns[0] + row_offsets[c+1];
+            const int *t = std::lower_bound(begin, end, row);
+            if (t == end || *t != row || entries[t - &columns[0]] != entries[j])
+                return false;
+        }
+    return true;
+}
+
+int CRSMatrix::bandwidth () const
+{
+    int band = 0;
+    for (int row = 0; row < rows(); row++)
+        for (int j = row_offsets[row]; j < row_offsets[row+1]; j++)
+            band = std::max(band, std::abs(row - columns[j]));
+    return band;
+}
+
+// Breadth-first search from start over the graph (offsets, adj), leaving
+// each reached node's distance in level (which must be -1 for all nodes
+// on entry) and the nodes in visit order in nodes.  Returns the depth.
+static int bfs_levels (const std::vector<int> &offsets, const std::vector<int> &adj,
+                       int start, std::vector<int> &level, std::vector<int> &nodes)
+{
+    nodes.clear();
+    nodes.push_back(start);
+    level[start] = 0;
+    for (int i = 0; i < nodes.size(); i++) {
+        int u = nodes[i];
+        for (int j = offsets[u]; j < offsets[u+1]; j++)
+            if (level[adj[j]] < 0) {
+                level[adj[j]] = level[u] + 1;
+                nodes.push_back(adj[j]);
+            }
+    }
+    return level[nodes.back()];
+}
+
+struct CompareDegree {
+    const std::vector<int> &offsets;
+    CompareDegree (const std::vector<int> &o) : offsets(o) { }
+    bool operator () (int a, int b) const {
+        int da = offsets[a+1] - offsets[a], db = offsets[b+1] - offsets[b];
+        return da < db || (da == db && a < b);
+    }
+};
+
+std::vector<int> CRSMatrix::rcm_ordering () const
+{
+    ASSERT(rows() == cols());
+    int n = rows();
+
+    // Adjacency of A + A^T without the diagonal, duplicates removed
+    std::vector<int> offsets(n + 1, 0);
+    for (int row = 0; row < n; row++)
+        for (int j = row_offsets[row]; j < row_offsets[row+1]; j++)
+            if (columns[j] != row) {
+                offsets[row + 1]++;
+                offsets[columns[j] + 1]++;
+            }
+    for (int row = 0; row < n; row++)
+        offsets[row + 1] += offsets[row];
+
+    std::vector<int> adj(offsets[n]);
+    std::vector<int> next(offsets.begin(), offsets.end() - 1);
+    for (int row = 0; row < n; row++)
+        for (int j = row_offsets[row]; j < row_offsets[row+1]; j++)
+            if (columns[j] != row) {
+                adj[next[row]++] = columns[j];
+                adj[next[columns[j]]++] = row;
+            }
+
+    int unique_end = 0;
+    for (int row = 0; row < n; row++) {
+        int begin = offsets[row];
+        std::sort(adj.begin() + begin, adj.begin() + offsets[row+1]);
+        int end = std::unique(adj.begin() + begin, adj.begin() + offsets[row+1]) - adj.begin();
+        offsets[row] = unique_end;
+        for (int j = begin; j < end; j++)
+            adj[unique_end++] = adj[j];
+    }
+    offsets[n] = unique_end;
+    adj.resize(unique_end);
+
+    CompareDegree by_degree(offsets);
+    std::vector<int> candidates(n);
+    for (int i = 0; i < n; i++)
+        candidates[i] = i;
+    std::sort(candidates.begin(), candidates.end(), by_degree);
+
+    std::vector<int> order;
+    order.reserve(n);
+    std::vector<int> level(n, -1);
+    std::vector<int> nodes;
+    std::vector<char> visited(n, 0);
+
+    // One component at a time, from its lowest-degree unvisited node
+    for (int c = 0; c < n; c++) {
+        int start = candidates[c];
+        if (visited[start])
+            continue;
+
+        // Move to a pseudo-peripheral node (George & Liu): the
+        // lowest-degree node in the last BFS level, while that deepens
+        // the level structure.
+        int depth = bfs_levels(offsets, adj, start, level, nodes);
+        while (true) {
+            int best = -1;
+            for (int i = nodes.size() - 1; i >= 0 && level[nodes[i]] == depth; i--)
+                if (best < 0 || by_degree(nodes[i], best))
+                    best = nodes[i];
+            for (int i = 0; i < nodes.size(); i++)
+                level[nodes[i]] = -1;
+
+            int best_depth = bfs_levels(offsets, adj, best, level, nodes);
+            if (best_depth <= depth) {
+                for (int i = 0; i < nodes.size(); i++)
+                    level[nodes[i]] = -1;
+                break;
+            }
+            start = best;
+            depth = best_depth;
+        }
+
+        // Cuthill-McKee: breadth first, neighbours by increasing degree
+        int first = order.size();
+        order.push_back(start);
+        visited[start] = 1;
+        for (int i = first; i < order.size(); i++) {
+            int u = order[i];
+            int added = order.size();
+            for (int j = offsets[u]; j < offsets[u+1]; j++)
+                if (!visited[adj[j]]) {
+                    visited[adj[j]] = 1;
+                    order.push_back(adj[j]);
+                }
+            std::sort(order.begin() + added, order.end(), by_degree);
+        }
+    }
+
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+CRSMatrix *CRSMatrix::permute (const std::vector<int> &perm) const
+{
+    ASSERT(rows() == cols());
+    ASSERT(perm.size() == rows());
+    int n = rows();
+
+    std::vector<int> inverse(n);
+    for (int i = 0; i < n; i++)
+        inverse[perm[i]] = i;
+
+    CRSMatrix *B = new CRSMatrix(n, n, _nonzeroes);
+    B->row_offsets[0] = 0;
+    for (int i = 0; i < n; i++)
+        B->row_offsets[i+1] = B->row_offsets[i] + row_length(perm[i]);
+
+    for (int i = 0; i < n; i++) {
+        int dst = B->row_offsets[i];
+        for (int j = row_offsets[perm[i]]; j < row_offsets[perm[i]+1]; j++, dst++) {
+            B->columns[dst] = inverse[columns[j]];
+            B->entries[dst] = entries[j];
+        }
+    }
+
+    // Renumbering unsorts the columns within each row
+    if (_nonzeroes > 0) {
+        int num_chunks = num_threads();
+        int rows_per_chunk = (n + num_chunks - 1) / num_chunks;
+        std::vector<BuildChunk> chunks(num_chunks);
+        for (int i = 0; i < num_chunks; i++) {
+            chunks[i].columns     = &B->columns[0];
+            chunks[i].entries     = &B->entries[0];
+            chunks[i].row_begin   = std::min(n, i * rows_per_chunk);
+            chunks[i].row_end     = std::min(n, (i + 1) * rows_per_chunk);
+            chunks[i].row_offsets = &B->row_offsets[0];
+        }
+        run_threads(chunks, sort_rows);
+    }
+
+    B->partition_rows(std::max(1, (int)row_blocks.size() - 1));
+    B->multiply_mode = multiply_mode;
+    return B;
+}
+
+/**************************************************************\
+| SellCSigmaMatrix Methods
+\**************************************************************/
+SellCSigmaMatrix::SellCSigmaMatrix (const CRSMatrix &A, int sigma) :
+    Matrix(A.rows(), A.cols())
+{
+    ASSERT(sigma > 0);
+    int n = rows();
+    int C = _chunk_height = ispc::sell_chunk_height();
+    _nonzeroes = A.nonzeroes();
+    multiply_mode = CRSMatrix::MULTIPLY_ISPC_TASKS;
+
+    // Sort by decreasing length within each window of sigma rows; ties
+    // keep their original order.
+    std::vector<std::pair<int, int> > order(n);
+    for (int row = 0; row < n; row++)
+        order[row] = std::make_pair(A.row_offsets[row] - A.row_offsets[row+1], row);
+    for (int start = 0; start < n; start += sigma)
+        std::sort(order.begin() + start, order.begin() + std::min(start + sigma, n));
+
+    permutation.resize(n);
+    for (int pos = 0; pos < n; pos++)
+        permutation[pos] = order[pos].second;
+
+    int num_chunks = (n + C - 1) / C;
+    chunk_offsets.resize(num_chunks + 1);
+    chunk_widths.resize(num_chunks);
+    chunk_offsets[0] = 0;
+    for (int c = 0; c < num_chunks; c++) {
+        int width = 0;
+        for (int pos = c * C; pos < std::min((c + 1) * C, n); pos++)
+            width = std::max(width, -order[pos].first);
+        chunk_widths[c] = width;
+        chunk_offsets[c+1] = chunk_offsets[c] + width * C;
+    }
+
+    // Padding multiplies a zero by the row's own entry of v, which the
+    // gang is likely to touch anyway.
+    entries.assign(chunk_offsets[num_chunks], 0);
+    columns.resize(chunk_offsets[num_chunks]);
+    for (int c = 0; c < num_chunks; c++) {
+        for (int lane = 0; lane < C; lane++) {
+            int pos = c * C + lane;
+            int row = pos < n ? permutation[pos] : 0;
+            int j = 0;
+            if (pos < n)
+                for (int i = A.row_offsets[row]; i < A.row_offsets[row+1]; i++, j++) {
+                    entries[chunk_offsets[c] + j * C + lane] = A.entries[i];
+                    columns[chunk_offsets[c] + j * C + lane] = A.columns[i];
+                }
+            for (; j < chunk_widths[c]; j++)
+                columns[chunk_offsets[c] + j * C + lane] = std::min(row, (int)cols() - 1);
+        }
+    }
+
+    // Chunk blocks for the tasks, balanced on stored entries
+    int num_blocks = std::max(1, std::min(num_chunks, 
+                                          chunk_offsets[num_chunks] / NONZEROES_PER_TASK));
+    chunk_blocks.resize(num_blocks + 1);
+    chunk_blocks[0] = 0;
+    for (int i = 1; i < num_blocks; i++) {
+        int target = (int)((long long)chunk_offsets[num_chunks] * i / num_blocks);
+        chunk_blocks[i] = std::lower_bound(chunk_offsets.begin(), chunk_offsets.end(),
+                                           target) - chunk_offsets.begin();
+    }
+    chunk_blocks[num_blocks] = num_chunks;
+}
+
+void SellCSigmaMatrix::multiply (const Vector &v, Vector &r) const
+{
+    ASSERT(v.size() == cols());
+    ASSERT(r.size() == rows());
+
+    if (entries.empty()) {
+        r.zero();
+        return;
+    }
+
+    switch (multiply_mode) {
+    case CRSMatrix::MULTIPLY_SERIAL:
+        multiply_serial(v, r);
+        break;
+    case CRSMatrix::MULTIPLY_ISPC:
+        ispc::sell_multiply(&entries[0], &columns[0], &chunk_offsets[0],
+                            &chunk_widths[0], &permutation[0], _chunk_height,
+                            rows(), 0, chunk_widths.size(), &v[0], &r[0]);
+        break;
+    case CRSMatrix::MULTIPLY_ISPC_TASKS:
+        ispc::sell_multiply_tasks(&entries[0], &columns[0], &chunk_offsets[0],
+                                  &chunk_widths[0], &permutation[0], 
+                                  _chunk_height, rows(), &chunk_blocks[0],
+                                  chunk_blocks.size() - 1, &v[0], &r[0]);
+        break;
+    }
+}
+
+void SellCSigmaMatrix::multiply_serial (const Vector &v, Vector &r) const
+{
+    int C = _chunk_height;
+    for (int pos = 0; pos < rows(); pos++) {
+        int c = pos / C;
+        int lane = pos % C;
+
+        double sum = 0;
+        for (int j = 0; j < chunk_widths[c]; j++) {
+            int k = chunk_offsets[c] + j * C + lane;
+            sum += v[columns[k]] * entries[k];
+        }
+        r[permutation[pos]] = sum;
+    }
+}
+
+void SellCSigmaMatrix::zero ( ) 
+{
+    std::fill(entries.begin(), entries.end(), 0.0);
+    _nonzeroes = 0;
+}
+
+/**************************************************************\
+| Single precision storage
+\**************************************************************/
+FloatCRSMatrix::FloatCRSMatrix (const CRSMatrix &A) : A(A)
+{
+    entries.assign(A.entries.begin(), A.entries.end());
+}
+
+void FloatCRSMatrix::multiply (const float *v, float *r) const
+{
+    if (entries.empty()) {
+        std::fill(r, r + rows(), 0.f);
+        return;
+    }
+    ispc::sparse_multiply_float_tasks(&entries[0], &A.columns[0], &A.row_offsets[0],
+                                      &A.row_blocks[0], A.row_blocks.size() - 1,
+                                      v, r);
+}
+
+void FloatBasis::multiply_leading_rows (int k, const float *v, float *r,
+                                        ReductionScratch *scratch) const
+{
+    ReductionScratch local;
+    ispc::dense_multiply_float_tasks(&entries[0], k, num_cols, COLUMNS_PER_TASK, v, r,
+                                     reduction_scratch(scratch, local, scratch_size(k)));
+}
+
+size_t FloatBasis::scratch_size (int rows) const
+{
+    return (num_cols + COLUMNS_PER_TASK - 1) / COLUMNS_PER_TASK * rows;
+}
+
+void FloatBasis::subtract_transpose_multiply_leading_rows (int k, const float *h, float *v) const
+{
+    ispc::dense_transpose_multiply_sub_float_tasks(&entries[0], k, num_cols,
+                                                   COLUMNS_PER_TASK, h, v);
+}
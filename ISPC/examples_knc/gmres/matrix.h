@@ -42,18 +42,120 @@
 #include <cstdlib> // malloc, memcpy, etc.
 #include <cmath>   // sqrt
 #include <vector>
+#include <algorithm> // max, fill
 
 #include "debug.h"
 #include "matrix_ispc.h"
 
 
+// Vectors of at least VECTOR_TASK_THRESHOLD entries use the task-parallel
+// kernels, with VECTOR_CHUNK entries per task.  Below that the launch
+// overhead outweighs the extra bandwidth.
+#define VECTOR_TASK_THRESHOLD 65536
+#define VECTOR_CHUNK          16384
+
+// Target size of the row blocks handed to each task by the ispc + tasks
+// sparse multiply, in nonzeroes.
+#define NONZEROES_PER_TASK    16384
+
 class DenseMatrix;
+/**************************************************************\
+| VectorView class
+\**************************************************************/
+// A non-owning window onto size() contiguous doubles: a row of a
+// DenseMatrix, or part of a Vector or of a workspace buffer.  Just a
+// pointer and a length, so it is passed by value and never allocates.
+// Bind a Vector to it to use the vector kernels on its entries.
+class VectorView {
+ public:
+    VectorView () : entries(NULL), _size(0) {}
+    VectorView (double *data, size_t size) : entries(data), _size(size) {}
+
+    double &operator [] (size_t index) const
+    {
+        ASSERT(index < _size);
+        return entries[index];
+    }
+
+    size_t  size () const { return _size; }
+    double *data () const { return entries; }
+
+    // Entries first .. first+length-1
+    VectorView slice (size_t first, size_t length) const
+    {
+        ASSERT(first + length <= _size);
+        return VectorView(entries + first, length);
+    }
+
+ private:
+    double *entries;
+    size_t  _size;
+};
+
+// The same over entries that may not be written, e.g. a row of a const
+// DenseMatrix.  A VectorView converts to one.
+class ConstVectorView {
+ public:
+    ConstVectorView () : entries(NULL), _size(0) {}
+    ConstVectorView (const double *data, size_t size) : entries(data), _size(size) {}
+    ConstVectorView (const VectorView &v) : entries(v.data()), _size(v.size()) {}
+
+    const double &operator [] (size_t index) const
+    {
+        ASSERT(index < _size);
+        return entries[index];
+    }
+
+    size_t        size () const { return _size; }
+    const double *data () const { return entries; }
+
+ private:
+    const double *entries;
+    size_t        _size;
+};
+
+/**************************************************************\
+| ReductionScratch class
+\**************************************************************/
+// The per-task partial sums of the task-parallel reductions (dot
+// products, norms, dense and multivector products), which the kernels
+// add up in task order.  Grows to the largest request and keeps it, so
+// a solver that passes one to every reduction allocates only in its
+// first steps, or never if it is sized up front (see GmresWorkspace).
+// Reductions given none use a temporary.
+class ReductionScratch {
+ public:
+    ReductionScratch () {}
+    explicit ReductionScratch (size_t size) : partial(size) {}
+
+    // At least size doubles
+    double *get (size_t size)
+    {
+        if (partial.size() < size)
+            partial.resize(size);
+        return &partial[0];
+    }
+
+ private:
+    std::vector<double> partial;
+};
+
+// scratch, or local if there is none, holding at least size doubles
+inline double *reduction_scratch (ReductionScratch *scratch, ReductionScratch &local,
+                                  size_t size)
+{
+    return (scratch != NULL ? scratch : &local)->get(size);
+}
+
 /**************************************************************\
 | Vector class
 \**************************************************************/
 class Vector {
  public:
     static Vector *vector_from_mtf(char *path);
+
+    // Writes a Matrix Market array, with the shortest decimal form that
+    // reads back exactly, or for a path ending in .bin the raw doubles.
     void to_mtf (char *path);
 
     Vector(size_t size, bool alloc_mem=true) 
@@ -83,8 +185,41 @@ class Vector {
             }
         }
 
+    // A Vector over the entries of v, which it does not own; nothing is
+    // allocated, so this is cheap enough to do per row or per step.
+    explicit Vector(const VectorView &v)
+        {
+            _size      = v.size();
+            shared_ptr = true;
+            entries    = v.data();
+        }
+
+    // The same for read-only entries, which must then only be used
+    // through a const Vector (e.g. bound to a const Vector &)
+    explicit Vector(const ConstVectorView &v)
+        {
+            _size      = v.size();
+            shared_ptr = true;
+            entries    = const_cast<double *>(v.data());
+        }
+
     ~Vector() { if (!shared_ptr) free(entries); }
 
+    // Points a non-owning Vector at v instead
+    void bind (const VectorView &v)
+    {
+        ASSERT(shared_ptr);
+        entries = v.data();
+        _size   = v.size();
+    }
+
+    VectorView view () { return VectorView(entries, _size); }
+    VectorView view (size_t first, size_t length)
+    {
+        ASSERT(first + length <= _size);
+        return VectorView(entries + first, length);
+    }
+
     const double & operator [] (size_t index) const 
     { 
         ASSERT(index < _size); 
@@ -111,52 +246,118 @@ class Vector {
 
     size_t size() const {return _size; }
 
-    double dot (const Vector &b) const 
+    // Doubles of ReductionScratch the reductions below need for n entries
+    static size_t scratch_size (size_t n)
+    {
+        return 2 * ((n + VECTOR_CHUNK - 1) / VECTOR_CHUNK);
+    }
+
+    double dot (const Vector &b, ReductionScratch *scratch = NULL) const 
     {
         ASSERT(b.size() == this->size());
-        return ispc::vector_dot(entries, b.entries, size());
+        return dot(b.entries, scratch);
     }
 
-    double dot (const double * const b) const 
+    double dot (const double * const b, ReductionScratch *scratch = NULL) const 
     {
+        if (tasks()) {
+            ReductionScratch local;
+            return ispc::vector_dot_tasks(entries, b, size(), VECTOR_CHUNK,
+                                          reduction_scratch(scratch, local, 
+                                                            scratch_size(size())));
+        }
         return ispc::vector_dot(entries, b, size());
     }
 
+    // this . b and |this| in one pass
+    void dot_norm (const Vector &b, double &dot, double &norm,
+                   ReductionScratch *scratch = NULL) const
+    {
+        ASSERT(b.size() == this->size());
+        double result[2];
+        if (tasks()) {
+            ReductionScratch local;
+            ispc::vector_dot_norm_tasks(entries, b.entries, size(), VECTOR_CHUNK, result,
+                                        reduction_scratch(scratch, local, 
+                                                          scratch_size(size())));
+        }
+        else
+            ispc::vector_dot_norm(entries, b.entries, size(), result);
+        dot  = result[0];
+        norm = sqrt(result[1]);
+    }
+
     void zero () 
     {
-        ispc::zero(entries, size()); 
+        if (tasks())
+            ispc::zero_tasks(entries, size(), VECTOR_CHUNK);
+        else
+            ispc::zero(entries, size()); 
     }
 
-    double norm () const { return sqrtf(dot(entries)); }
+    double norm (ReductionScratch *scratch = NULL) const 
+    {
+        return sqrt(dot(entries, scratch)); 
+    }
 
-    void normalize () { this->divide(this->norm()); }
+    void normalize (ReductionScratch *scratch = NULL) { this->divide(this->norm(scratch)); }
 
     void add (const Vector &a) 
     {
         ASSERT(size() == a.size());
-        ispc::vector_add(entries, a.entries, size());
+        if (tasks())
+            ispc::vector_add_tasks(entries, a.entries, size(), VECTOR_CHUNK);
+        else
+            ispc::vector_add(entries, a.entries, size());
     }
 
     void subtract (const Vector &s)
     {
         ASSERT(size() == s.size());
-        ispc::vector_sub(entries, s.entries, size());
+        if (tasks())
+            ispc::vector_sub_tasks(entries, s.entries, size(), VECTOR_CHUNK);
+        else
+            ispc::vector_sub(entries, s.entries, size());
     }
 
     void multiply (double scalar) 
     {
-        ispc::vector_mult(entries, scalar, size());
+        if (tasks())
+            ispc::vector_mult_tasks(entries, scalar, size(), VECTOR_CHUNK);
+        else
+            ispc::vector_mult(entries, scalar, size());
     }
 
     void divide (double scalar) 
     {
-        ispc::vector_div(entries, scalar, size());
+        if (tasks())
+            ispc::vector_div_tasks(entries, scalar, size(), VECTOR_CHUNK);
+        else
+            ispc::vector_div(entries, scalar, size());
     }
 
     // Note: x may be longer than *(this)
     void add_ax (double a, const Vector &x) {
         ASSERT(x.size() >= size());
-        ispc::vector_add_ax(entries, a, x.entries, size());
+        if (tasks())
+            ispc::vector_add_ax_tasks(entries, a, x.entries, size(), VECTOR_CHUNK);
+        else
+            ispc::vector_add_ax(entries, a, x.entries, size());
+    }
+
+    // this += a x, returning the updated this . y, in one pass
+    double add_ax_dot (double a, const Vector &x, const Vector &y,
+                       ReductionScratch *scratch = NULL) {
+        ASSERT(x.size() >= size());
+        ASSERT(y.size() >= size());
+        if (tasks()) {
+            ReductionScratch local;
+            return ispc::vector_add_ax_dot_tasks(entries, a, x.entries, y.entries,
+                                                 size(), VECTOR_CHUNK,
+                                                 reduction_scratch(scratch, local, 
+                                                                   scratch_size(size())));
+        }
+        return ispc::vector_add_ax_dot(entries, a, x.entries, y.entries, size());
     }
 
     // Note that copy only copies the first size() elements of the
@@ -167,14 +368,152 @@ class Vector {
         memcpy(entries, other.entries, size() * sizeof(double));
     }
 
+    // this[i] = v[perm[i]], i.e. v reordered by perm (new -> old index),
+    // and the inverse, this[perm[i]] = v[i].
+    void permute (const Vector &v, const std::vector<int> &perm) {
+        ASSERT(v.size() == size() && perm.size() == size());
+        for (int i = 0; i < size(); i++)
+            entries[i] = v.entries[perm[i]];
+    }
+
+    void unpermute (const Vector &v, const std::vector<int> &perm) {
+        ASSERT(v.size() == size() && perm.size() == size());
+        for (int i = 0; i < size(); i++)
+            entries[perm[i]] = v.entries[i];
+    }
+
     friend class DenseMatrix;
 
  private:
+    // Whether to use the task-parallel kernels
+    bool tasks () const { return _size >= VECTOR_TASK_THRESHOLD; }
+
     size_t  _size;
     bool     shared_ptr;
     double  *entries;
 };
 
+/**************************************************************\
+| MultiVector class (k vectors, e.g. several right-hand sides)
+\**************************************************************/
+// Column-interleaved: entry (i, j) is at i*cols() + j, so a sparse
+// matrix entry A(r, c) multiplies the cols() contiguous values of row c.
+// The column-wise operations take one coefficient per column.
+class MultiVector {
+ public:
+    static MultiVector *multivector_from_mtf (char *path);
+    void to_mtf (char *path);   // as Vector::to_mtf, column by column
+
+    MultiVector (size_t rows, size_t cols) :
+        num_rows(rows), num_cols(cols), entries(rows * cols) { }
+
+    size_t rows () const { return num_rows; }
+    size_t cols () const { return num_cols; }
+
+    double &operator () (size_t r, size_t c)
+    {
+        ASSERT(r < num_rows && c < num_cols);
+        return entries[r * num_cols + c];
+    }
+
+    const double &operator () (size_t r, size_t c) const
+    {
+        ASSERT(r < num_rows && c < num_cols);
+        return entries[r * num_cols + c];
+    }
+
+    double       *data ()       { return &entries[0]; }
+    const double *data () const { return &entries[0]; }
+
+    void zero () { std::fill(entries.begin(), entries.end(), 0.); }
+
+    void copy (const MultiVector &other) {
+        ASSERT(other.rows() == rows() && other.cols() == cols());
+        entries = other.entries;
+    }
+
+    void swap (MultiVector &other) {
+        ASSERT(other.rows() == rows() && other.cols() == cols());
+        entries.swap(other.entries);
+    }
+
+    void column (size_t c, Vector &v) const {
+        ASSERT(v.size() == rows());
+        for (size_t i = 0; i < rows(); i++)
+            v[i] = entries[i * num_cols + c];
+    }
+
+    void set_column (size_t c, const Vector &v) {
+        ASSERT(v.size() == rows());
+        for (size_t i = 0; i < rows(); i++)
+            entries[i * num_cols + c] = v[i];
+    }
+
+    // The column-wise operations below (but add_mult) take a
+    // ReductionScratch, for their partial sums and coefficients
+    // result[j] = column j of this . column j of b
+    void dot (const MultiVector &b, double *result, ReductionScratch *scratch = NULL) const {
+        ASSERT(b.rows() == rows() && b.cols() == cols());
+        ReductionScratch local;
+        ispc::multi_dot_tasks(data(), b.data(), rows(), cols(), rows_per_task(), result,
+                              reduction_scratch(scratch, local, scratch_size()));
+    }
+
+    // result = this^T b, cols() x cols(), row-major
+    void inner (const MultiVector &b, double *result, ReductionScratch *scratch = NULL) const {
+        ASSERT(b.rows() == rows() && b.cols() == cols());
+        ReductionScratch local;
+        ispc::multi_inner_tasks(data(), b.data(), rows(), cols(), rows_per_task(), result,
+                                reduction_scratch(scratch, local, scratch_size()));
+    }
+
+    // column j += a[j] * column j of x
+    void add_ax (const double *a, const MultiVector &x, ReductionScratch *scratch = NULL) {
+        ASSERT(x.rows() == rows() && x.cols() == cols());
+        ReductionScratch local;
+        ispc::multi_add_ax_tasks(data(), a, x.data(), rows(), cols(), rows_per_task(),
+                                 reduction_scratch(scratch, local, scratch_size()));
+    }
+
+    // column j += a[j] * column j of x, returning the updated column j
+    // . column j of y in result[j], in one pass
+    void add_ax_dot (const double *a, const MultiVector &x, const MultiVector &y,
+                     double *result, ReductionScratch *scratch = NULL) {
+        ASSERT(x.rows() == rows() && x.cols() == cols());
+        ASSERT(y.rows() == rows() && y.cols() == cols());
+        ReductionScratch local;
+        ispc::multi_add_ax_dot_tasks(data(), a, x.data(), y.data(), rows(), cols(),
+                                     rows_per_task(), result,
+                                     reduction_scratch(scratch, local, scratch_size()));
+    }
+
+    // column j *= a[j]
+    void scale (const double *a, ReductionScratch *scratch = NULL) {
+        ReductionScratch local;
+        ispc::multi_scale_tasks(data(), a, rows(), cols(), rows_per_task(),
+                                reduction_scratch(scratch, local, scratch_size()));
+    }
+
+    // this += v T, for a cols() x cols() row-major T
+    void add_mult (const MultiVector &v, const double *T) {
+        ASSERT(v.rows() == rows() && v.cols() == cols());
+        ispc::multi_add_mult_tasks(data(), v.data(), T, rows(), cols(), rows_per_task());
+    }
+
+ private:
+    int rows_per_task () const {
+        return std::max(1, VECTOR_CHUNK / std::max(1, (int)num_cols));
+    }
+
+    size_t scratch_size () const {
+        return ispc::multi_scratch_size(rows(), cols(), rows_per_task());
+    }
+
+    size_t num_rows;
+    size_t num_cols;
+    std::vector<double> entries;
+};
+
 
 /**************************************************************\
 | Matrix base class
@@ -188,7 +527,7 @@ class Matrix {
             num_rows = size_r; 
             num_cols = size_c; 
         }
-    ~Matrix(){}
+    virtual ~Matrix(){}
 
     size_t rows() const { return num_rows; }
     size_t cols() const { return num_cols; }
@@ -201,6 +540,18 @@ class Matrix {
     size_t num_cols;
 };
 
+/**************************************************************\
+| Preconditioner base class
+\**************************************************************/
+// An approximation M of a matrix A that is cheap to invert; apply()
+// computes z = M^-1 r.
+class Preconditioner {
+ public:
+    virtual ~Preconditioner() {}
+
+    virtual void apply (const Vector &r, Vector &z) const = 0;
+};
+
 /**************************************************************\
 | DenseMatrix class
 \**************************************************************/
@@ -211,16 +562,50 @@ class DenseMatrix : public Matrix {
  DenseMatrix(size_t size_r, size_t size_c) : Matrix(size_r, size_c) 
         {
             entries = (double *) malloc(size_r * size_c * sizeof(double));
+            shared_ptr = false;
         }
 
  DenseMatrix(size_t size_r, size_t size_c, const double *content) : Matrix (size_r, size_c)
         {
             entries = (double *) malloc(size_r * size_c * sizeof(double));
             memcpy(entries, content, size_r * size_c * sizeof(double));
+            shared_ptr = false;
         }
 
+    // Row-major over storage, which it does not own (e.g. part of a
+    // preallocated workspace)
+ DenseMatrix(size_t size_r, size_t size_c, const VectorView &storage) : Matrix (size_r, size_c)
+        {
+            ASSERT(storage.size() >= size_r * size_c);
+            entries = storage.data();
+            shared_ptr = true;
+        }
+
+    ~DenseMatrix() { if (!shared_ptr) free(entries); }
+
     virtual void multiply (const Vector &v, Vector &r) const;
 
+    // r = R v and v -= R^T h, where R is the leading r.size() (resp.
+    // h.size()) rows of this matrix.  Blocked and task-parallel over the
+    // columns, for orthogonalizing against a basis stored in the rows.
+    // The products take a ReductionScratch of scratch_size(rows, count)
+    // doubles for their partial sums, rows being the leading rows used
+    // and count the block size.
+    void multiply_leading_rows (const Vector &v, Vector &r,
+                                ReductionScratch *scratch = NULL) const;
+    void subtract_transpose_multiply_leading_rows (const Vector &h, Vector &v) const;
+
+    // The same for a block P of count rows starting at row first, with a
+    // single reduction: r = R P^T (k x count, row-major) for the leading k
+    // rows R, P -= h^T R, and P = L P for a count x count lower triangular L.
+    void multiply_leading_rows_block (int k, int first, int count, double *r,
+                                      ReductionScratch *scratch = NULL) const;
+    void subtract_transpose_multiply_leading_rows_block (int k, const double *h,
+                                                         int first, int count);
+    void lower_multiply_rows_block (const double *L, int first, int count);
+
+    size_t scratch_size (int rows, int count = 1) const;
+
     double &operator () (unsigned int r, unsigned int c)
     {
         return *(entries + r * num_cols + c);
@@ -231,11 +616,21 @@ class DenseMatrix : public Matrix {
         return *(entries + r * num_cols + c);			
     }
 
-    const Vector *row(size_t row) const;
-    void          row(size_t row, Vector &r);
-    void      set_row(size_t row, const Vector &v);
+    // A view of row 'row'; writes through it go to the matrix
+    VectorView row (size_t row)
+    {
+        ASSERT(row < num_rows);
+        return VectorView(entries + row * num_cols, num_cols);
+    }
 
-    virtual void zero() { ispc::zero(entries, rows() * cols()); }
+    ConstVectorView row (size_t row) const
+    {
+        ASSERT(row < num_rows);
+        return ConstVectorView(entries + row * num_cols, num_cols);
+    }
+    void set_row(size_t row, const Vector &v);
+
+    virtual void zero() { memset(entries, 0, rows() * cols() * sizeof(double)); }
 
     void copy (const DenseMatrix &other) 
     {
@@ -249,31 +644,277 @@ class DenseMatrix : public Matrix {
     bool shared_ptr;
 };
 
+/**************************************************************\
+| HessenbergMatrix class
+\**************************************************************/
+// A matrix that is zero below its first 'subdiagonals' subdiagonals, as
+// built by Arnoldi (one subdiagonal, or k for block GMRES with k
+// vectors).  Stored packed and column-major: column c holds only rows
+// 0 .. c+subdiagonals, contiguously, so the Givens updates and the back
+// substitution run down a column instead of striding across rows.
+class HessenbergMatrix : public Matrix {
+ public:
+    HessenbergMatrix(size_t size_r, size_t size_c, int subdiagonals = 1);
+
+    virtual void multiply (const Vector &v, Vector &r) const;
+    virtual void zero () { std::fill(entries.begin(), entries.end(), 0.); }
+
+    int subdiagonals () const { return num_sub; }
+
+    // Column c is column_length(c) contiguous entries, from row 0
+    int column_length (size_t c) const { return offsets[c+1] - offsets[c]; }
+    double       *column (size_t c)       { return &entries[offsets[c]]; }
+    const double *column (size_t c) const { return &entries[offsets[c]]; }
+
+    double &operator () (unsigned int r, unsigned int c)
+    {
+        ASSERT(c < num_cols && (int) r < column_length(c));
+        return entries[offsets[c] + r];
+    }
+
+    // Entries below the stored band read as zero
+    double operator () (unsigned int r, unsigned int c) const
+    {
+        return (int) r < column_length(c) ? entries[offsets[c] + r] : 0.;
+    }
+
+ private:
+    int num_sub;
+    std::vector<size_t> offsets;
+    std::vector<double> entries;
+};
+
 /**************************************************************\
 | CSRMatrix (compressed row storage, a sparse matrix format)
 \**************************************************************/
 class CRSMatrix : public Matrix { 
+    friend class SellCSigmaMatrix;
+    friend class FloatCRSMatrix;
+    friend class JacobiPreconditioner;
+    friend class BlockJacobiPreconditioner;
+    friend class ILU0Preconditioner;
+
  public:
+    // Which implementation multiply() uses.
+    enum MultiplyMode {
+        MULTIPLY_SERIAL,
+        MULTIPLY_ISPC,
+        MULTIPLY_ISPC_TASKS
+    };
+
     CRSMatrix (size_t size_r, size_t size_c, size_t nonzeroes) :
     Matrix(size_r, size_c) 
         {
             _nonzeroes = nonzeroes;
             entries.resize(nonzeroes);
             columns.resize(nonzeroes);
-            row_offsets.resize(size_r);
+            row_offsets.resize(size_r + 1);
+            row_offsets[size_r] = nonzeroes;
+            multiply_mode = MULTIPLY_ISPC_TASKS;
         }
 
     virtual void multiply(const Vector &v, Vector &r) const;
 
+    // R = A V for all columns of V at once (SpMM): each entry of A is
+    // read once per row instead of once per right-hand side.
+    void multiply (const MultiVector &V, MultiVector &R) const;
+
     virtual void zero();
 
-    static CRSMatrix *matrix_from_mtf (char *path);
+    size_t nonzeroes() const { return _nonzeroes; }
+
+    int row_length (size_t row) const { return row_offsets[row+1] - row_offsets[row]; }
+
+    const int *row_columns (size_t row) const { return &columns[row_offsets[row]]; }
+
+    // Largest |row - column| over the nonzeroes
+    int bandwidth () const;
+
+    // Whether A(c, r) == A(r, c) for every nonzero, e.g. before using CG
+    bool is_symmetric () const;
+
+    // A reverse Cuthill-McKee ordering of the rows (new -> old index),
+    // which reduces the bandwidth of the structurally symmetrized matrix
+    // and so keeps the v[columns[i]] accesses of multiply() local.
+    std::vector<int> rcm_ordering () const;
+
+    // P A P^T, where row i of the result is row perm[i] of A
+    CRSMatrix *permute (const std::vector<int> &perm) const;
+
+    void set_multiply_mode (MultiplyMode mode) { multiply_mode = mode; }
+
+    // Splits the rows into num_blocks ranges with about the same number
+    // of nonzeroes each; MULTIPLY_ISPC_TASKS runs one task per range.
+    void partition_rows (int num_blocks);
+
+    // With use_cache, the matrix is read from (or else saved to) a binary
+    // copy next to the .mtx file, path.crs, which skips parsing entirely.
+    static CRSMatrix *matrix_from_mtf (char *path, bool use_cache = false);
+
+    // A synthetic test matrix (see generate.cpp), from a specification
+    // kind:n[:param]:
+    //   poisson2d:n         5-point Laplacian on an n x n grid
+    //   poisson3d:n         7-point Laplacian on an n x n x n grid
+    //   poisson3d-27:n      27-point Laplacian on an n x n x n grid
+    //   convdiff:n[:beta]   2D convection-diffusion, 5-point, nonsymmetric
+    //                       by beta in [0, 1) (default .5)
+    //   banded:n[:width]    n rows, random within half-bandwidth width
+    //                       (default 8), diagonally dominant
+    //   powerlaw:n[:alpha]  n rows with power-law lengths, exponent alpha
+    //                       > 1 (default 2.5), random columns, dominant
+    // Returns NULL (after printing why) for a bad specification.
+    static CRSMatrix *generate (const char *spec);
 
  private:
+    static CRSMatrix *from_cache (char *path);
+    void to_cache (char *path) const;
+
+    void multiply_serial (const Vector &v, Vector &r) const;
+
     unsigned int        _nonzeroes;
+    std::vector<double>  entries;
+    std::vector<int>     row_offsets;  // rows()+1 entries
+    std::vector<int>     columns;
+    std::vector<int>     row_blocks;
+    MultiplyMode         multiply_mode;
+};
+
+/**************************************************************\
+| SellCSigmaMatrix (sliced ELLPACK, a SIMD-friendly sparse format)
+\**************************************************************/
+// Rows are grouped into chunks of chunk_height() rows, one per program
+// instance of the ispc gang, and each chunk is stored column-major and
+// padded to its longest row: a gang walks its chunk in lockstep with
+// contiguous loads of entries and columns.  To keep the padding small,
+// rows are first sorted by decreasing length within windows of sigma rows.
+class SellCSigmaMatrix : public Matrix {
+ public:
+    SellCSigmaMatrix (const CRSMatrix &A, int sigma);
+
+    virtual void multiply (const Vector &v, Vector &r) const;
+
+    virtual void zero ();
+
+    size_t nonzeroes() const { return _nonzeroes; }
+
+    // Nonzeroes plus padding
+    size_t stored_entries() const { return entries.size(); }
+
+    int chunk_height() const { return _chunk_height; }
+
+    void set_multiply_mode (CRSMatrix::MultiplyMode mode) { multiply_mode = mode; }
+
+ private:
+    void multiply_serial (const Vector &v, Vector &r) const;
+
+    int                  _chunk_height;
+    unsigned int         _nonzeroes;
+    std::vector<double>  entries;
+    std::vector<int>     columns;
+    std::vector<int>     chunk_offsets;  // num_chunks+1 entries
+    std::vector<int>     chunk_widths;
+    std::vector<int>     permutation;    // sorted position -> row
+    std::vector<int>     chunk_blocks;
+    CRSMatrix::MultiplyMode multiply_mode;
+};
+
+/**************************************************************\
+| Single precision storage (mixed-precision gmres)
+\**************************************************************/
+// The values of a CRSMatrix rounded to float; the structure (and the task
+// partition) is shared with the CRSMatrix, which must outlive this.
+class FloatCRSMatrix {
+ public:
+    FloatCRSMatrix (const CRSMatrix &A);
+
+    size_t rows() const { return A.rows(); }
+
+    void multiply (const float *v, float *r) const;
+
+ private:
+    const CRSMatrix    &A;
+    std::vector<float>  entries;
+};
+
+// A row-major float matrix whose rows hold a Krylov basis, with the
+// blocked products of DenseMatrix over its leading k rows.
+class FloatBasis {
+ public:
+    FloatBasis (size_t rows, size_t cols) : num_cols(cols), entries(rows * cols) { }
+
+    float *row (size_t r) { return &entries[r * num_cols]; }
+
+    size_t scratch_size (int rows) const;
+
+    // r = Q_k v and v -= Q_k^T h; the first as DenseMatrix's
+    void multiply_leading_rows (int k, const float *v, float *r,
+                                ReductionScratch *scratch = NULL) const;
+    void subtract_transpose_multiply_leading_rows (int k, const float *h, float *v) const;
+
+ private:
+    size_t              num_cols;
+    std::vector<float>  entries;
+};
+
+/**************************************************************\
+| Preconditioners built from a CRSMatrix
+\**************************************************************/
+// M = diag(A)
+class JacobiPreconditioner : public Preconditioner {
+ public:
+    JacobiPreconditioner (const CRSMatrix &A);
+
+    virtual void apply (const Vector &r, Vector &z) const;
+
+ private:
+    std::vector<double> inv_diag;
+};
+
+// M = the block_size x block_size diagonal blocks of A (the last one may
+// be smaller).  The blocks are inverted up front, so apply() is one dense
+// matrix-vector product per block.
+class BlockJacobiPreconditioner : public Preconditioner {
+ public:
+    BlockJacobiPreconditioner (const CRSMatrix &A, int block_size);
+
+    virtual void apply (const Vector &r, Vector &z) const;
+
+ private:
+    int                 block_size;
+    std::vector<double> inv_blocks;  // block_size entries per row of A
+};
+
+// M = LU, the incomplete LU factorization of A with no fill-in, stored in
+// A's sparsity pattern (L has an implied unit diagonal).  The triangular
+// solves run level by level: the rows in a level only depend on rows in
+// earlier levels, so each level is solved in parallel.
+class ILU0Preconditioner : public Preconditioner {
+ public:
+    ILU0Preconditioner (const CRSMatrix &A);
+
+    virtual void apply (const Vector &r, Vector &z) const;
+
+    // False if A has a row without a diagonal entry, which ILU(0) needs;
+    // the preconditioner must not be applied then.
+    bool ok () const { return valid; }
+
+    int lower_levels () const { return lower_level_offsets.size() - 1; }
+    int upper_levels () const { return upper_level_offsets.size() - 1; }
+
+ private:
+    void solve (const std::vector<int> &level_rows,
+                const std::vector<int> &level_offsets, bool upper,
+                double *x) const;
+
     std::vector<double>  entries;
     std::vector<int>     row_offsets;
     std::vector<int>     columns;
+    std::vector<int>     diag;         // position of each row's diagonal
+    std::vector<int>     lower_level_rows;
+    std::vector<int>     lower_level_offsets;
+    std::vector<int>     upper_level_rows;
+    std::vector<int>     upper_level_offsets;
+    bool                 valid;
 };
 
 #endif
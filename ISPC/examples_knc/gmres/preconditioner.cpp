@@ -0,0 +1,281 @@
+/*
+  Copyright (c) 2012, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  
+*/
+
+
+/**************************************************************\
+| Includes
+\**************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "matrix.h"
+#include "matrix_ispc.h"
+
+// Levels with more rows than this are split across tasks.
+#define ROWS_PER_TASK 1024
+
+/**************************************************************\
+| JacobiPreconditioner methods
+\**************************************************************/
+JacobiPreconditioner::JacobiPreconditioner (const CRSMatrix &A)
+{
+    ASSERT(A.rows() == A.cols());
+    inv_diag.assign(A.rows(), 1.0);
+
+    for (int row = 0; row < A.rows(); row++)
+        for (int j = A.row_offsets[row]; j < A.row_offsets[row+1]; j++)
+            if (A.columns[j] == row && A.entries[j] != 0)
+                inv_diag[row] = 1.0 / A.entries[j];
+}
+
+void JacobiPreconditioner::apply (const Vector &r, Vector &z) const
+{
+    ASSERT(r.size() == inv_diag.size());
+    ASSERT(z.size() == inv_diag.size());
+    ispc::vector_mult_elements(&z[0], &r[0], &inv_diag[0], z.size());
+}
+
+/**************************************************************\
+| BlockJacobiPreconditioner methods
+\**************************************************************/
+// Inverts the n x n row-major matrix a in place by Gauss-Jordan
+// elimination with partial pivoting.  Returns false if a is singular.
+static bool invert_block (double *a, int n)
+{
+    std::vector<double> inv(n * n, 0);
+    for (int i = 0; i < n; i++)
+        inv[i * n + i] = 1;
+
+    for (int col = 0; col < n; col++) {
+        int pivot = col;
+        for (int i = col + 1; i < n; i++)
+            if (fabs(a[i * n + col]) > fabs(a[pivot * n + col]))
+                pivot = i;
+        if (a[pivot * n + col] == 0)
+            return false;
+
+        if (pivot != col)
+            for (int k = 0; k < n; k++) {
+                std::swap(a[pivot * n + k], a[col * n + k]);
+                std::swap(inv[pivot * n + k], inv[col * n + k]);
+            }
+
+        double d = 1.0 / a[col * n + col];
+        for (int k = 0; k < n; k++) {
+            a[col * n + k] *= d;
+            inv[col * n + k] *= d;
+        }
+
+        for (int i = 0; i < n; i++) {
+            double f = a[i * n + col];
+            if (i == col || f == 0)
+                continue;
+            for (int k = 0; k < n; k++) {
+                a[i * n + k] -= f * a[col * n + k];
+                inv[i * n + k] -= f * inv[col * n + k];
+            }
+        }
+    }
+
+    std::copy(inv.begin(), inv.end(), a);
+    return true;
+}
+
+BlockJacobiPreconditioner::BlockJacobiPreconditioner (const CRSMatrix &A,
+                                                      int block_size)
+{
+    ASSERT(A.rows() == A.cols());
+    ASSERT(block_size > 0);
+    this->block_size = block_size;
+
+    int n = A.rows();
+    inv_blocks.assign((size_t) n * block_size, 0);
+
+    std::vector<double> block(block_size * block_size);
+    for (int start = 0; start < n; start += block_size) {
+        int bs = std::min(block_size, n - start);
+
+        std::fill(block.begin(), block.end(), 0);
+        for (int i = 0; i < bs; i++) {
+            int row = start + i;
+            for (int j = A.row_offsets[row]; j < A.row_offsets[row+1]; j++)
+                if (A.columns[j] >= start && A.columns[j] < start + bs)
+                    block[i * bs + A.columns[j] - start] = A.entries[j];
+        }
+
+        if (!invert_block(&block[0], bs)) {
+            DEBUG_PRINT("BlockJacobiPreconditioner: block at row %d is "
+                        "singular, using the identity\n", start);
+            std::fill(block.begin(), block.end(), 0);
+            for (int i = 0; i < bs; i++)
+                block[i * bs + i] = 1;
+        }
+
+        for (int i = 0; i < bs; i++)
+            std::copy(&block[i * bs], &block[i * bs] + bs,
+                      &inv_blocks[(size_t) (start + i) * block_size]);
+    }
+}
+
+void BlockJacobiPreconditioner::apply (const Vector &r, Vector &z) const
+{
+    ASSERT(r.size() == z.size());
+    ASSERT(z.size() * block_size == inv_blocks.size());
+    ispc::block_diagonal_multiply(&inv_blocks[0], block_size, z.size(),
+                                  &r[0], &z[0]);
+}
+
+/**************************************************************\
+| ILU0Preconditioner methods
+\**************************************************************/
+// Buckets rows by level.  level[row] is the level of each row; on return
+// rows holds the rows of level l at [offsets[l], offsets[l+1]).
+static void bucket_levels (const std::vector<int> &level,
+                           std::vector<int> &rows, std::vector<int> &offsets)
+{
+    int num_levels = 0;
+    for (int row = 0; row < level.size(); row++)
+        num_levels = std::max(num_levels, level[row] + 1);
+
+    offsets.assign(num_levels + 1, 0);
+    for (int row = 0; row < level.size(); row++)
+        offsets[level[row] + 1]++;
+    for (int l = 0; l < num_levels; l++)
+        offsets[l + 1] += offsets[l];
+
+    std::vector<int> next(offsets.begin(), offsets.end() - 1);
+    rows.resize(level.size());
+    for (int row = 0; row < level.size(); row++)
+        rows[next[level[row]]++] = row;
+}
+
+ILU0Preconditioner::ILU0Preconditioner (const CRSMatrix &A) : valid(false)
+{
+    ASSERT(A.rows() == A.cols());
+    int n = A.rows();
+
+    entries     = A.entries;
+    row_offsets = A.row_offsets;
+    columns     = A.columns;
+
+    // Columns are sorted within each row (matrix_from_mtf sorts them),
+    // so the diagonal splits a row into its L and U parts.
+    diag.resize(n);
+    for (int row = 0; row < n; row++) {
+        int j = row_offsets[row];
+        while (j < row_offsets[row+1] && columns[j] < row)
+            j++;
+        if (j == row_offsets[row+1] || columns[j] != row) {
+            fprintf(stderr, "ILU0Preconditioner: row %d has no diagonal "
+                    "entry\n", row);
+            return;
+        }
+        diag[row] = j;
+    }
+
+    // IKJ variant of Gaussian elimination restricted to A's pattern
+    // (Saad, Iterative Methods for Sparse Linear Systems, 10.3.2).
+    std::vector<int> position(n, -1);
+    for (int i = 0; i < n; i++) {
+        for (int j = row_offsets[i]; j < row_offsets[i+1]; j++)
+            position[columns[j]] = j;
+
+        for (int j = row_offsets[i]; j < diag[i]; j++) {
+            int k = columns[j];
+            entries[j] /= entries[diag[k]];
+            for (int jj = diag[k] + 1; jj < row_offsets[k+1]; jj++)
+                if (position[columns[jj]] >= 0)
+                    entries[position[columns[jj]]] -= entries[j] * entries[jj];
+        }
+
+        if (entries[diag[i]] == 0) {
+            DEBUG_PRINT("ILU0Preconditioner: zero pivot in row %d\n", i);
+            entries[diag[i]] = 1;
+        }
+
+        for (int j = row_offsets[i]; j < row_offsets[i+1]; j++)
+            position[columns[j]] = -1;
+    }
+
+    // A row of L can be solved once the rows it references are; likewise
+    // for U from the bottom up.
+    std::vector<int> level(n);
+    for (int row = 0; row < n; row++) {
+        level[row] = 0;
+        for (int j = row_offsets[row]; j < diag[row]; j++)
+            level[row] = std::max(level[row], level[columns[j]] + 1);
+    }
+    bucket_levels(level, lower_level_rows, lower_level_offsets);
+
+    for (int row = n - 1; row >= 0; row--) {
+        level[row] = 0;
+        for (int j = diag[row] + 1; j < row_offsets[row+1]; j++)
+            level[row] = std::max(level[row], level[columns[j]] + 1);
+    }
+    bucket_levels(level, upper_level_rows, upper_level_offsets);
+    valid = true;
+}
+
+void ILU0Preconditioner::solve (const std::vector<int> &level_rows,
+                                const std::vector<int> &level_offsets,
+                                bool upper, double *x) const
+{
+    for (int l = 0; l + 1 < level_offsets.size(); l++) {
+        int begin = level_offsets[l];
+        int end   = level_offsets[l+1];
+
+        if (end - begin > ROWS_PER_TASK)
+            ispc::triangular_solve_level_tasks(&entries[0], &columns[0],
+                                               &row_offsets[0], &diag[0],
+                                               &level_rows[0], begin, end,
+                                               ROWS_PER_TASK, upper, x);
+        else
+            ispc::triangular_solve_level(&entries[0], &columns[0],
+                                         &row_offsets[0], &diag[0],
+                                         &level_rows[0], begin, end,
+                                         upper, x);
+    }
+}
+
+void ILU0Preconditioner::apply (const Vector &r, Vector &z) const
+{
+    ASSERT(r.size() == diag.size());
+    ASSERT(z.size() == diag.size());
+
+    z.copy(r);
+    solve(lower_level_rows, lower_level_offsets, false, &z[0]);
+    solve(upper_level_rows, upper_level_offsets, true, &z[0]);
+}
@@ -0,0 +1,1558 @@
+/*
+  Copyright (c) 2010-2012, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  
+*/
+
+// Entry points for the generic-N targets.  The including header defines
+// __vec_i1, __vec_i8 ... __vec_d for its width; everything below is
+// written once against those names.
+
+///////////////////////////////////////////////////////////////////////////
+// macros...
+
+// Each of these stamps out one named entry point for one type; the loop
+// itself lives in the matching template in generic-lanes.h.
+
+#define UNARY_OP(TYPE, NAME, FUNC)                                  \
+static FORCEINLINE TYPE NAME(TYPE v) {                              \
+    return lUnaryOp(v, FUNC);                                       \
+}
+
+#define BINARY_OP(TYPE, NAME, OP)                                   \
+static FORCEINLINE TYPE NAME(TYPE a, TYPE b) {                      \
+    return lBinaryOp<OP, TYPE::ElementType>(a, b);                  \
+}
+
+#define BINARY_OP_CAST(TYPE, CAST, NAME, OP)                        \
+static FORCEINLINE TYPE NAME(TYPE a, TYPE b) {                      \
+    return lBinaryOp<OP, CAST>(a, b);                               \
+}
+
+#define BINARY_OP_FUNC(TYPE, NAME, FUNC)                            \
+static FORCEINLINE TYPE NAME(TYPE a, TYPE b) {                      \
+    return lBinaryFunc(a, b, FUNC);                                 \
+}
+
+#define CMP_OP(TYPE, SUFFIX, CAST, NAME, OP)                        \
+static FORCEINLINE __vec_i1 NAME##_##SUFFIX(TYPE a, TYPE b) {       \
+    return lCmpOp<OP, CAST, __vec_i1>(a, b);                        \
+}                                                                   \
+static FORCEINLINE __vec_i1 NAME##_##SUFFIX##_and_mask(TYPE a, TYPE b,  \
+                                                __vec_i1 mask) {    \
+    __vec_i1 ret = lCmpOp<OP, CAST, __vec_i1>(a, b);                \
+    ret.v &= mask.v;                                                \
+    return ret;                                                     \
+}
+
+#define INSERT_EXTRACT(VTYPE, STYPE)                                  \
+static FORCEINLINE STYPE __extract_element(VTYPE v, int index) {      \
+    return v.v[index];                                                \
+}                                                                     \
+static FORCEINLINE void __insert_element(VTYPE *v, int index, STYPE val) { \
+    v->v[index] = val;                                                \
+}
+
+#define INSERT_EXTRACT_SCALAR(VTYPE, STYPE)                           \
+static FORCEINLINE STYPE __extract_element(VTYPE v, int index) {      \
+    return ((STYPE *)&v)[index];                                      \
+}                                                                     \
+static FORCEINLINE void __insert_element(VTYPE *v, int index, STYPE val) { \
+    ((STYPE *)v)[index] = val;                                        \
+}
+
+#define LOAD_STORE(VTYPE, STYPE)                       \
+template <int ALIGN>                                   \
+static FORCEINLINE VTYPE __load(const VTYPE *p) {      \
+    return lLoad<VTYPE>((const STYPE *)p);             \
+}                                                      \
+template <int ALIGN>                                   \
+static FORCEINLINE void __store(VTYPE *p, VTYPE v) {   \
+    lStore((STYPE *)p, v);                             \
+}
+
+#define REDUCE_ADD(TYPE, VTYPE, NAME)           \
+static FORCEINLINE TYPE NAME(VTYPE v) {         \
+    return lReduceAdd<TYPE>(v);                 \
+}
+
+#define REDUCE_MINMAX(TYPE, VTYPE, NAME, OP)    \
+static FORCEINLINE TYPE NAME(VTYPE v) {         \
+    return lReduceMinMax<OP, TYPE>(v);          \
+}
+
+#define SELECT(TYPE)                                                \
+static FORCEINLINE TYPE __select(__vec_i1 mask, TYPE a, TYPE b) {   \
+    return lSelect(mask, a, b);                                     \
+}                                                                   \
+static FORCEINLINE TYPE __select(bool cond, TYPE a, TYPE b) {       \
+    return cond ? a : b;                                            \
+}
+
+#define SHIFT_UNIFORM(TYPE, CAST, NAME, OP)                         \
+static FORCEINLINE TYPE NAME(TYPE a, int32_t b) {                   \
+    return lShiftUniform<OP, CAST>(a, b);                           \
+}
+
+#define SMEAR(VTYPE, NAME, STYPE)                                  \
+template <class RetVecType> VTYPE __smear_##NAME(STYPE);           \
+template <> FORCEINLINE VTYPE __smear_##NAME<VTYPE>(STYPE v) {     \
+    return lSmear<VTYPE>(v);                                       \
+}
+
+#define SETZERO(VTYPE, NAME)                                       \
+template <class RetVecType> VTYPE __setzero_##NAME();              \
+template <> FORCEINLINE VTYPE __setzero_##NAME<VTYPE>() {          \
+    return lSmear<VTYPE>((VTYPE::ElementType)0);                    \
+}
+
+#define UNDEF(VTYPE, NAME)                                         \
+template <class RetVecType> VTYPE __undef_##NAME();                \
+template <> FORCEINLINE VTYPE __undef_##NAME<VTYPE>() {            \
+    return VTYPE();                                                \
+}
+
+#define BROADCAST(VTYPE, NAME, STYPE)                              \
+static FORCEINLINE VTYPE __broadcast_##NAME(VTYPE v, int index) {  \
+    return lBroadcast(v, index);                                   \
+}
+
+#define ROTATE(VTYPE, NAME, STYPE)                                 \
+static FORCEINLINE VTYPE __rotate_##NAME(VTYPE v, int index) {     \
+    return lRotate(v, index);                                      \
+}
+
+#define SHUFFLES(VTYPE, NAME, STYPE)                               \
+static FORCEINLINE VTYPE __shuffle_##NAME(VTYPE v, __vec_i32 index) {  \
+    return lShuffle(v, index);                                     \
+}                                                                  \
+static FORCEINLINE VTYPE __shuffle2_##NAME(VTYPE v0, VTYPE v1,     \
+                                           __vec_i32 index) {      \
+    return lShuffle2(v0, v1, index);                               \
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+INSERT_EXTRACT_SCALAR(__vec1_i8, int8_t)
+INSERT_EXTRACT_SCALAR(__vec1_i16, int16_t)
+INSERT_EXTRACT_SCALAR(__vec1_i32, int32_t)
+INSERT_EXTRACT_SCALAR(__vec1_i64, int64_t)
+INSERT_EXTRACT_SCALAR(__vec1_f, float)
+INSERT_EXTRACT_SCALAR(__vec1_d, double)
+
+///////////////////////////////////////////////////////////////////////////
+// mask ops
+
+typedef __vec_i1::MaskBits __mask_bits_t;
+
+static FORCEINLINE uint64_t __movmsk(__vec_i1 mask) {
+    return (uint64_t)mask.v;
+}
+
+static FORCEINLINE bool __any(__vec_i1 mask) {
+    return (mask.v!=0);
+}
+
+static FORCEINLINE bool __all(__vec_i1 mask) {
+    return (mask.v==(__mask_bits_t)~(__mask_bits_t)0);
+}
+
+static FORCEINLINE bool __none(__vec_i1 mask) {
+    return (mask.v==0);
+}
+
+static FORCEINLINE __vec_i1 __equal_i1(__vec_i1 a, __vec_i1 b) {
+    __vec_i1 r;
+    r.v = (a.v & b.v) | (~a.v & ~b.v);
+    return r;
+}
+
+static FORCEINLINE __vec_i1 __and(__vec_i1 a, __vec_i1 b) {
+    __vec_i1 r;
+    r.v = a.v & b.v;
+    return r;
+}
+
+static FORCEINLINE __vec_i1 __xor(__vec_i1 a, __vec_i1 b) {
+    __vec_i1 r;
+    r.v = a.v ^ b.v;
+    return r;
+}
+
+static FORCEINLINE __vec_i1 __or(__vec_i1 a, __vec_i1 b) {
+    __vec_i1 r;
+    r.v = a.v | b.v;
+    return r;
+}
+
+static FORCEINLINE __vec_i1 __not(__vec_i1 v) {
+    __vec_i1 r;
+    r.v = ~v.v;
+    return r;
+}
+
+static FORCEINLINE __vec_i1 __and_not1(__vec_i1 a, __vec_i1 b) {
+    __vec_i1 r;
+    r.v = ~a.v & b.v;
+    return r;
+}
+
+static FORCEINLINE __vec_i1 __and_not2(__vec_i1 a, __vec_i1 b) {
+    __vec_i1 r;
+    r.v = a.v & ~b.v;
+    return r;
+}
+
+static FORCEINLINE __vec_i1 __select(__vec_i1 mask, __vec_i1 a,
+                                     __vec_i1 b) {
+    __vec_i1 r;
+    r.v = (a.v & mask.v) | (b.v & ~mask.v);
+    return r;
+}
+
+static FORCEINLINE __vec_i1 __select(bool cond, __vec_i1 a, __vec_i1 b) {
+    return cond ? a : b;
+}
+
+static FORCEINLINE bool __extract_element(__vec_i1 vec, int index) {
+    return lLaneOn(vec.v, index);
+}
+
+static FORCEINLINE void __insert_element(__vec_i1 *vec, int index,
+                                         bool val) {
+    if (val == false)
+        vec->v &= ~lLaneBit<__mask_bits_t>(index);
+    else
+        vec->v |= lLaneBit<__mask_bits_t>(index);
+}
+
+template <int ALIGN> static FORCEINLINE __vec_i1 __load(const __vec_i1 *p) {
+    __mask_bits_t *ptr = (__mask_bits_t *)p;
+    __vec_i1 r;
+    r.v = *ptr;
+    return r;
+}
+
+template <int ALIGN> static FORCEINLINE void __store(__vec_i1 *p, __vec_i1 v) {
+    __mask_bits_t *ptr = (__mask_bits_t *)p;
+    *ptr = v.v;
+}
+
+template <class RetVecType> __vec_i1 __smear_i1(int i);
+template <> FORCEINLINE __vec_i1 __smear_i1<__vec_i1>(int v) {
+    return __vec_i1((v & 1) ? (__mask_bits_t)~(__mask_bits_t)0 : 0);
+}
+
+template <class RetVecType> __vec_i1 __setzero_i1();
+template <> FORCEINLINE __vec_i1 __setzero_i1<__vec_i1>() {
+    return __vec_i1((__mask_bits_t)0);
+}
+
+template <class RetVecType> __vec_i1 __undef_i1();
+template <> FORCEINLINE __vec_i1 __undef_i1<__vec_i1>() {
+    return __vec_i1();
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+// int8
+
+BINARY_OP(__vec_i8, __add, lAdd)
+BINARY_OP(__vec_i8, __sub, lSub)
+BINARY_OP(__vec_i8, __mul, lMul)
+
+BINARY_OP(__vec_i8, __or, lOr)
+BINARY_OP(__vec_i8, __and, lAnd)
+BINARY_OP(__vec_i8, __xor, lXor)
+BINARY_OP(__vec_i8, __shl, lShl)
+
+BINARY_OP_CAST(__vec_i8, uint8_t, __udiv, lDiv)
+BINARY_OP_CAST(__vec_i8, int8_t,  __sdiv, lDiv)
+
+BINARY_OP_CAST(__vec_i8, uint8_t, __urem, lRem)
+BINARY_OP_CAST(__vec_i8, int8_t,  __srem, lRem)
+BINARY_OP_CAST(__vec_i8, uint8_t, __lshr, lShr)
+BINARY_OP_CAST(__vec_i8, int8_t,  __ashr, lShr)
+
+SHIFT_UNIFORM(__vec_i8, uint8_t, __lshr, lShr)
+SHIFT_UNIFORM(__vec_i8, int8_t, __ashr, lShr)
+SHIFT_UNIFORM(__vec_i8, int8_t, __shl, lShl)
+
+CMP_OP(__vec_i8, i8, int8_t,  __equal, lEqual)
+CMP_OP(__vec_i8, i8, int8_t,  __not_equal, lNotEqual)
+CMP_OP(__vec_i8, i8, uint8_t, __unsigned_less_equal, lLessEqual)
+CMP_OP(__vec_i8, i8, int8_t,  __signed_less_equal, lLessEqual)
+CMP_OP(__vec_i8, i8, uint8_t, __unsigned_greater_equal, lGreaterEqual)
+CMP_OP(__vec_i8, i8, int8_t,  __signed_greater_equal, lGreaterEqual)
+CMP_OP(__vec_i8, i8, uint8_t, __unsigned_less_than, lLessThan)
+CMP_OP(__vec_i8, i8, int8_t,  __signed_less_than, lLessThan)
+CMP_OP(__vec_i8, i8, uint8_t, __unsigned_greater_than, lGreaterThan)
+CMP_OP(__vec_i8, i8, int8_t,  __signed_greater_than, lGreaterThan)
+
+SELECT(__vec_i8)
+INSERT_EXTRACT(__vec_i8, int8_t)
+SMEAR(__vec_i8, i8, int8_t)
+SETZERO(__vec_i8, i8)
+UNDEF(__vec_i8, i8)
+BROADCAST(__vec_i8, i8, int8_t)
+ROTATE(__vec_i8, i8, int8_t)
+SHUFFLES(__vec_i8, i8, int8_t)
+LOAD_STORE(__vec_i8, int8_t)
+
+///////////////////////////////////////////////////////////////////////////
+// int16
+
+BINARY_OP(__vec_i16, __add, lAdd)
+BINARY_OP(__vec_i16, __sub, lSub)
+BINARY_OP(__vec_i16, __mul, lMul)
+
+BINARY_OP(__vec_i16, __or, lOr)
+BINARY_OP(__vec_i16, __and, lAnd)
+BINARY_OP(__vec_i16, __xor, lXor)
+BINARY_OP(__vec_i16, __shl, lShl)
+
+BINARY_OP_CAST(__vec_i16, uint16_t, __udiv, lDiv)
+BINARY_OP_CAST(__vec_i16, int16_t,  __sdiv, lDiv)
+
+BINARY_OP_CAST(__vec_i16, uint16_t, __urem, lRem)
+BINARY_OP_CAST(__vec_i16, int16_t,  __srem, lRem)
+BINARY_OP_CAST(__vec_i16, uint16_t, __lshr, lShr)
+BINARY_OP_CAST(__vec_i16, int16_t,  __ashr, lShr)
+
+SHIFT_UNIFORM(__vec_i16, uint16_t, __lshr, lShr)
+SHIFT_UNIFORM(__vec_i16, int16_t, __ashr, lShr)
+SHIFT_UNIFORM(__vec_i16, int16_t, __shl, lShl)
+
+CMP_OP(__vec_i16, i16, int16_t,  __equal, lEqual)
+CMP_OP(__vec_i16, i16, int16_t,  __not_equal, lNotEqual)
+CMP_OP(__vec_i16, i16, uint16_t, __unsigned_less_equal, lLessEqual)
+CMP_OP(__vec_i16, i16, int16_t,  __signed_less_equal, lLessEqual)
+CMP_OP(__vec_i16, i16, uint16_t, __unsigned_greater_equal, lGreaterEqual)
+CMP_OP(__vec_i16, i16, int16_t,  __signed_greater_equal, lGreaterEqual)
+CMP_OP(__vec_i16, i16, uint16_t, __unsigned_less_than, lLessThan)
+CMP_OP(__vec_i16, i16, int16_t,  __signed_less_than, lLessThan)
+CMP_OP(__vec_i16, i16, uint16_t, __unsigned_greater_than, lGreaterThan)
+CMP_OP(__vec_i16, i16, int16_t,  __signed_greater_than, lGreaterThan)
+
+SELECT(__vec_i16)
+INSERT_EXTRACT(__vec_i16, int16_t)
+SMEAR(__vec_i16, i16, int16_t)
+SETZERO(__vec_i16, i16)
+UNDEF(__vec_i16, i16)
+BROADCAST(__vec_i16, i16, int16_t)
+ROTATE(__vec_i16, i16, int16_t)
+SHUFFLES(__vec_i16, i16, int16_t)
+LOAD_STORE(__vec_i16, int16_t)
+
+///////////////////////////////////////////////////////////////////////////
+// int32
+
+BINARY_OP(__vec_i32, __add, lAdd)
+BINARY_OP(__vec_i32, __sub, lSub)
+BINARY_OP(__vec_i32, __mul, lMul)
+
+BINARY_OP(__vec_i32, __or, lOr)
+BINARY_OP(__vec_i32, __and, lAnd)
+BINARY_OP(__vec_i32, __xor, lXor)
+BINARY_OP(__vec_i32, __shl, lShl)
+
+BINARY_OP_CAST(__vec_i32, uint32_t, __udiv, lDiv)
+BINARY_OP_CAST(__vec_i32, int32_t,  __sdiv, lDiv)
+
+BINARY_OP_CAST(__vec_i32, uint32_t, __urem, lRem)
+BINARY_OP_CAST(__vec_i32, int32_t,  __srem, lRem)
+BINARY_OP_CAST(__vec_i32, uint32_t, __lshr, lShr)
+BINARY_OP_CAST(__vec_i32, int32_t,  __ashr, lShr)
+
+SHIFT_UNIFORM(__vec_i32, uint32_t, __lshr, lShr)
+SHIFT_UNIFORM(__vec_i32, int32_t, __ashr, lShr)
+SHIFT_UNIFORM(__vec_i32, int32_t, __shl, lShl)
+
+CMP_OP(__vec_i32, i32, int32_t,  __equal, lEqual)
+CMP_OP(__vec_i32, i32, int32_t,  __not_equal, lNotEqual)
+CMP_OP(__vec_i32, i32, uint32_t, __unsigned_less_equal, lLessEqual)
+CMP_OP(__vec_i32, i32, int32_t,  __signed_less_equal, lLessEqual)
+CMP_OP(__vec_i32, i32, uint32_t, __unsigned_greater_equal, lGreaterEqual)
+CMP_OP(__vec_i32, i32, int32_t,  __signed_greater_equal, lGreaterEqual)
+CMP_OP(__vec_i32, i32, uint32_t, __unsigned_less_than, lLessThan)
+CMP_OP(__vec_i32, i32, int32_t,  __signed_less_than, lLessThan)
+CMP_OP(__vec_i32, i32, uint32_t, __unsigned_greater_than, lGreaterThan)
+CMP_OP(__vec_i32, i32, int32_t,  __signed_greater_than, lGreaterThan)
+
+SELECT(__vec_i32)
+INSERT_EXTRACT(__vec_i32, int32_t)
+SMEAR(__vec_i32, i32, int32_t)
+SETZERO(__vec_i32, i32)
+UNDEF(__vec_i32, i32)
+BROADCAST(__vec_i32, i32, int32_t)
+ROTATE(__vec_i32, i32, int32_t)
+SHUFFLES(__vec_i32, i32, int32_t)
+LOAD_STORE(__vec_i32, int32_t)
+
+///////////////////////////////////////////////////////////////////////////
+// int64
+
+BINARY_OP(__vec_i64, __add, lAdd)
+BINARY_OP(__vec_i64, __sub, lSub)
+BINARY_OP(__vec_i64, __mul, lMul)
+
+BINARY_OP(__vec_i64, __or, lOr)
+BINARY_OP(__vec_i64, __and, lAnd)
+BINARY_OP(__vec_i64, __xor, lXor)
+BINARY_OP(__vec_i64, __shl, lShl)
+
+BINARY_OP_CAST(__vec_i64, uint64_t, __udiv, lDiv)
+BINARY_OP_CAST(__vec_i64, int64_t,  __sdiv, lDiv)
+
+BINARY_OP_CAST(__vec_i64, uint64_t, __urem, lRem)
+BINARY_OP_CAST(__vec_i64, int64_t,  __srem, lRem)
+BINARY_OP_CAST(__vec_i64, uint64_t, __lshr, lShr)
+BINARY_OP_CAST(__vec_i64, int64_t,  __ashr, lShr)
+
+SHIFT_UNIFORM(__vec_i64, uint64_t, __lshr, lShr)
+SHIFT_UNIFORM(__vec_i64, int64_t, __ashr, lShr)
+SHIFT_UNIFORM(__vec_i64, int64_t, __shl, lShl)
+
+CMP_OP(__vec_i64, i64, int64_t,  __equal, lEqual)
+CMP_OP(__vec_i64, i64, int64_t,  __not_equal, lNotEqual)
+CMP_OP(__vec_i64, i64, uint64_t, __unsigned_less_equal, lLessEqual)
+CMP_OP(__vec_i64, i64, int64_t,  __signed_less_equal, lLessEqual)
+CMP_OP(__vec_i64, i64, uint64_t, __unsigned_greater_equal, lGreaterEqual)
+CMP_OP(__vec_i64, i64, int64_t,  __signed_greater_equal, lGreaterEqual)
+CMP_OP(__vec_i64, i64, uint64_t, __unsigned_less_than, lLessThan)
+CMP_OP(__vec_i64, i64, int64_t,  __signed_less_than, lLessThan)
+CMP_OP(__vec_i64, i64, uint64_t, __unsigned_greater_than, lGreaterThan)
+CMP_OP(__vec_i64, i64, int64_t,  __signed_greater_than, lGreaterThan)
+
+SELECT(__vec_i64)
+INSERT_EXTRACT(__vec_i64, int64_t)
+SMEAR(__vec_i64, i64, int64_t)
+SETZERO(__vec_i64, i64)
+UNDEF(__vec_i64, i64)
+BROADCAST(__vec_i64, i64, int64_t)
+ROTATE(__vec_i64, i64, int64_t)
+SHUFFLES(__vec_i64, i64, int64_t)
+LOAD_STORE(__vec_i64, int64_t)
+
+///////////////////////////////////////////////////////////////////////////
+// float
+
+BINARY_OP(__vec_f, __add, lAdd)
+BINARY_OP(__vec_f, __sub, lSub)
+BINARY_OP(__vec_f, __mul, lMul)
+BINARY_OP(__vec_f, __div, lDiv)
+
+CMP_OP(__vec_f, float, float, __equal, lEqual)
+CMP_OP(__vec_f, float, float, __not_equal, lNotEqual)
+CMP_OP(__vec_f, float, float, __less_than, lLessThan)
+CMP_OP(__vec_f, float, float, __less_equal, lLessEqual)
+CMP_OP(__vec_f, float, float, __greater_than, lGreaterThan)
+CMP_OP(__vec_f, float, float, __greater_equal, lGreaterEqual)
+
+static FORCEINLINE __vec_i1 __ordered_float(__vec_f a, __vec_f b) {
+    return lCmpOp<lOrdered, float, __vec_i1>(a, b);
+}
+
+static FORCEINLINE __vec_i1 __unordered_float(__vec_f a, __vec_f b) {
+    return lCmpOp<lUnordered, float, __vec_i1>(a, b);
+}
+
+#if 0
+      case Instruction::FRem: intrinsic = "__frem"; break;
+#endif
+
+SELECT(__vec_f)
+INSERT_EXTRACT(__vec_f, float)
+SMEAR(__vec_f, float, float)
+SETZERO(__vec_f, float)
+UNDEF(__vec_f, float)
+BROADCAST(__vec_f, float, float)
+ROTATE(__vec_f, float, float)
+SHUFFLES(__vec_f, float, float)
+LOAD_STORE(__vec_f, float)
+
+static FORCEINLINE float __exp_uniform_float(float v) {
+    return expf(v);
+}
+
+static FORCEINLINE __vec_f __exp_varying_float(__vec_f v) {
+    return lUnaryOp(v, __exp_uniform_float);
+}
+
+static FORCEINLINE float __log_uniform_float(float v) {
+    return logf(v);
+}
+
+static FORCEINLINE __vec_f __log_varying_float(__vec_f v) {
+    return lUnaryOp(v, __log_uniform_float);
+}
+
+static FORCEINLINE float __pow_uniform_float(float a, float b) {
+    return powf(a, b);
+}
+
+static FORCEINLINE __vec_f __pow_varying_float(__vec_f a, __vec_f b) {
+    return lBinaryFunc(a, b, __pow_uniform_float);
+}
+
+static FORCEINLINE int __intbits(float v) {
+    union {
+        float f;
+        int i;
+    } u;
+    u.f = v;
+    return u.i;
+}
+
+static FORCEINLINE float __floatbits(int v) {
+    union {
+        float f;
+        int i;
+    } u;
+    u.i = v;
+    return u.f;
+}
+
+static FORCEINLINE float __half_to_float_uniform(int16_t h) {
+    static const uint32_t shifted_exp = 0x7c00 << 13; // exponent mask after shift
+
+    int32_t o = ((int32_t)(h & 0x7fff)) << 13;     // exponent/mantissa bits
+    uint32_t exp = shifted_exp & o;   // just the exponent
+    o += (127 - 15) << 23;        // exponent adjust
+
+    // handle exponent special cases
+    if (exp == shifted_exp) // Inf/NaN?
+        o += (128 - 16) << 23;    // extra exp adjust
+    else if (exp == 0) { // Zero/Denormal?
+        o += 1 << 23;             // extra exp adjust
+        o = __intbits(__floatbits(o) - __floatbits(113 << 23)); // renormalize
+    }
+
+    o |= ((int32_t)(h & 0x8000)) << 16;    // sign bit
+    return __floatbits(o);
+}
+
+
+static FORCEINLINE __vec_f __half_to_float_varying(__vec_i16 v) {
+    __vec_f ret;
+    for (int i = 0; i < __vec_f::Lanes; ++i)
+        ret.v[i] = __half_to_float_uniform(v.v[i]);
+    return ret;
+}
+
+
+static FORCEINLINE int16_t __float_to_half_uniform(float f) {
+    uint32_t sign_mask = 0x80000000u;
+    int32_t o;
+
+    int32_t fint = __intbits(f);
+    int32_t sign = fint & sign_mask;
+    fint ^= sign;
+
+    int32_t f32infty = 255 << 23;
+    o = (fint > f32infty) ? 0x7e00 : 0x7c00; 
+
+    // (De)normalized number or zero
+    // update fint unconditionally to save the blending; we don't need it
+    // anymore for the Inf/NaN case anyway.
+    const uint32_t round_mask = ~0xfffu; 
+    const int32_t magic = 15 << 23;
+    const int32_t f16infty = 31 << 23;
+
+    int32_t fint2 = __intbits(__floatbits(fint & round_mask) * __floatbits(magic)) - round_mask;
+    fint2 = (fint2 > f16infty) ? f16infty : fint2; // Clamp to signed infinity if overflowed
+
+    if (fint < f32infty)
+        o = fint2 >> 13; // Take the bits!
+
+    return (o | (sign >> 16));
+}
+
+
+static FORCEINLINE __vec_i16 __float_to_half_varying(__vec_f v) {
+    __vec_i16 ret;
+    for (int i = 0; i < __vec_i16::Lanes; ++i)
+        ret.v[i] = __float_to_half_uniform(v.v[i]);
+    return ret;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+// double
+
+BINARY_OP(__vec_d, __add, lAdd)
+BINARY_OP(__vec_d, __sub, lSub)
+BINARY_OP(__vec_d, __mul, lMul)
+BINARY_OP(__vec_d, __div, lDiv)
+
+CMP_OP(__vec_d, double, double, __equal, lEqual)
+CMP_OP(__vec_d, double, double, __not_equal, lNotEqual)
+CMP_OP(__vec_d, double, double, __less_than, lLessThan)
+CMP_OP(__vec_d, double, double, __less_equal, lLessEqual)
+CMP_OP(__vec_d, double, double, __greater_than, lGreaterThan)
+CMP_OP(__vec_d, double, double, __greater_equal, lGreaterEqual)
+
+static FORCEINLINE __vec_i1 __ordered_double(__vec_d a, __vec_d b) {
+    return lCmpOp<lOrdered, double, __vec_i1>(a, b);
+}
+
+static FORCEINLINE __vec_i1 __unordered_double(__vec_d a, __vec_d b) {
+    return lCmpOp<lUnordered, double, __vec_i1>(a, b);
+}
+
+#if 0
+      case Instruction::FRem: intrinsic = "__frem"; break;
+#endif
+
+SELECT(__vec_d)
+INSERT_EXTRACT(__vec_d, double)
+SMEAR(__vec_d, double, double)
+SETZERO(__vec_d, double)
+UNDEF(__vec_d, double)
+BROADCAST(__vec_d, double, double)
+ROTATE(__vec_d, double, double)
+SHUFFLES(__vec_d, double, double)
+LOAD_STORE(__vec_d, double)
+
+///////////////////////////////////////////////////////////////////////////
+// casts
+
+
+#define CAST(TO, STO, FROM, SFROM, FUNC)        \
+static FORCEINLINE TO FUNC(TO, FROM val) {      \
+    return lCast<TO, STO, SFROM>(val);          \
+}
+
+// sign extension conversions
+CAST(__vec_i64, int64_t, __vec_i32, int32_t, __cast_sext)
+CAST(__vec_i64, int64_t, __vec_i16, int16_t, __cast_sext)
+CAST(__vec_i64, int64_t, __vec_i8,  int8_t,  __cast_sext)
+CAST(__vec_i32, int32_t, __vec_i16, int16_t, __cast_sext)
+CAST(__vec_i32, int32_t, __vec_i8,  int8_t,  __cast_sext)
+CAST(__vec_i16, int16_t, __vec_i8,  int8_t,  __cast_sext)
+
+#define CAST_SEXT_I1(TYPE)                                  \
+static FORCEINLINE TYPE __cast_sext(TYPE, __vec_i1 v) {     \
+    return lCastFromMask<TYPE>(v, (TYPE::ElementType)~0);   \
+}
+
+CAST_SEXT_I1(__vec_i8)
+CAST_SEXT_I1(__vec_i16)
+CAST_SEXT_I1(__vec_i32)
+CAST_SEXT_I1(__vec_i64)
+
+// zero extension
+CAST(__vec_i64, uint64_t, __vec_i32, uint32_t, __cast_zext)
+CAST(__vec_i64, uint64_t, __vec_i16, uint16_t, __cast_zext)
+CAST(__vec_i64, uint64_t, __vec_i8,  uint8_t,  __cast_zext)
+CAST(__vec_i32, uint32_t, __vec_i16, uint16_t, __cast_zext)
+CAST(__vec_i32, uint32_t, __vec_i8,  uint8_t,  __cast_zext)
+CAST(__vec_i16, uint16_t, __vec_i8,  uint8_t,  __cast_zext)
+
+#define CAST_ZEXT_I1(TYPE)                                  \
+static FORCEINLINE TYPE __cast_zext(TYPE, __vec_i1 v) {     \
+    return lCastFromMask<TYPE>(v, 1);                       \
+}
+
+CAST_ZEXT_I1(__vec_i8)
+CAST_ZEXT_I1(__vec_i16)
+CAST_ZEXT_I1(__vec_i32)
+CAST_ZEXT_I1(__vec_i64)
+
+// truncations
+CAST(__vec_i32, int32_t, __vec_i64, int64_t, __cast_trunc)
+CAST(__vec_i16, int16_t, __vec_i64, int64_t, __cast_trunc)
+CAST(__vec_i8,  int8_t,  __vec_i64, int64_t, __cast_trunc)
+CAST(__vec_i16, int16_t, __vec_i32, int32_t, __cast_trunc)
+CAST(__vec_i8,  int8_t,  __vec_i32, int32_t, __cast_trunc)
+CAST(__vec_i8,  int8_t,  __vec_i16, int16_t, __cast_trunc)
+
+// signed int to float/double
+CAST(__vec_f, float, __vec_i8,   int8_t,  __cast_sitofp)
+CAST(__vec_f, float, __vec_i16,  int16_t, __cast_sitofp)
+CAST(__vec_f, float, __vec_i32,  int32_t, __cast_sitofp)
+CAST(__vec_f, float, __vec_i64,  int64_t, __cast_sitofp)
+CAST(__vec_d, double, __vec_i8,  int8_t,  __cast_sitofp)
+CAST(__vec_d, double, __vec_i16, int16_t, __cast_sitofp)
+CAST(__vec_d, double, __vec_i32, int32_t, __cast_sitofp)
+CAST(__vec_d, double, __vec_i64, int64_t, __cast_sitofp)
+
+// unsigned int to float/double
+CAST(__vec_f, float, __vec_i8,   uint8_t,  __cast_uitofp)
+CAST(__vec_f, float, __vec_i16,  uint16_t, __cast_uitofp)
+CAST(__vec_f, float, __vec_i32,  uint32_t, __cast_uitofp)
+CAST(__vec_f, float, __vec_i64,  uint64_t, __cast_uitofp)
+CAST(__vec_d, double, __vec_i8,  uint8_t,  __cast_uitofp)
+CAST(__vec_d, double, __vec_i16, uint16_t, __cast_uitofp)
+CAST(__vec_d, double, __vec_i32, uint32_t, __cast_uitofp)
+CAST(__vec_d, double, __vec_i64, uint64_t, __cast_uitofp)
+
+static FORCEINLINE __vec_f __cast_uitofp(__vec_f, __vec_i1 v) {
+    return lCastFromMask<__vec_f>(v, 1.f);
+}
+
+// float/double to signed int
+CAST(__vec_i8,  int8_t,  __vec_f, float, __cast_fptosi)
+CAST(__vec_i16, int16_t, __vec_f, float, __cast_fptosi)
+CAST(__vec_i32, int32_t, __vec_f, float, __cast_fptosi)
+CAST(__vec_i64, int64_t, __vec_f, float, __cast_fptosi)
+CAST(__vec_i8,  int8_t,  __vec_d, double, __cast_fptosi)
+CAST(__vec_i16, int16_t, __vec_d, double, __cast_fptosi)
+CAST(__vec_i32, int32_t, __vec_d, double, __cast_fptosi)
+CAST(__vec_i64, int64_t, __vec_d, double, __cast_fptosi)
+
+// float/double to unsigned int
+CAST(__vec_i8,  uint8_t,  __vec_f, float, __cast_fptoui)
+CAST(__vec_i16, uint16_t, __vec_f, float, __cast_fptoui)
+CAST(__vec_i32, uint32_t, __vec_f, float, __cast_fptoui)
+CAST(__vec_i64, uint64_t, __vec_f, float, __cast_fptoui)
+CAST(__vec_i8,  uint8_t,  __vec_d, double, __cast_fptoui)
+CAST(__vec_i16, uint16_t, __vec_d, double, __cast_fptoui)
+CAST(__vec_i32, uint32_t, __vec_d, double, __cast_fptoui)
+CAST(__vec_i64, uint64_t, __vec_d, double, __cast_fptoui)
+
+// float/double conversions
+CAST(__vec_f, float,  __vec_d, double, __cast_fptrunc)
+CAST(__vec_d, double, __vec_f, float,  __cast_fpext)
+
+typedef union {
+    int32_t i32;
+    float f;
+    int64_t i64;
+    double d;
+} BitcastUnion;
+
+#define CAST_BITS(TO, TO_ELT, FROM, FROM_ELT)       \
+static FORCEINLINE TO __cast_bits(TO, FROM val) {   \
+    TO r;                                           \
+    for (int i = 0; i < TO::Lanes; ++i) {           \
+        BitcastUnion u;                             \
+        u.FROM_ELT = val.v[i];                      \
+        r.v[i] = u.TO_ELT;                          \
+    }                                               \
+    return r;                                       \
+}
+
+CAST_BITS(__vec_f,   f,   __vec_i32, i32)
+CAST_BITS(__vec_i32, i32, __vec_f,   f)
+CAST_BITS(__vec_d,   d,   __vec_i64, i64)
+CAST_BITS(__vec_i64, i64, __vec_d,   d)
+
+#define CAST_BITS_SCALAR(TO, FROM)                  \
+static FORCEINLINE TO __cast_bits(TO, FROM v) {     \
+    union {                                         \
+    TO to;                                          \
+    FROM from;                                      \
+    } u;                                            \
+    u.from = v;                                     \
+    return u.to;                                    \
+}
+
+CAST_BITS_SCALAR(uint32_t, float)
+CAST_BITS_SCALAR(int32_t, float)
+CAST_BITS_SCALAR(float, uint32_t)
+CAST_BITS_SCALAR(float, int32_t)
+CAST_BITS_SCALAR(uint64_t, double)
+CAST_BITS_SCALAR(int64_t, double)
+CAST_BITS_SCALAR(double, uint64_t)
+CAST_BITS_SCALAR(double, int64_t)
+
+///////////////////////////////////////////////////////////////////////////
+// various math functions
+
+static FORCEINLINE void __fastmath() {
+}
+
+static FORCEINLINE float __round_uniform_float(float v) {
+    return roundf(v);
+}
+
+static FORCEINLINE float __floor_uniform_float(float v)  {
+    return floorf(v);
+}
+
+static FORCEINLINE float __ceil_uniform_float(float v) {
+    return ceilf(v);
+}
+
+static FORCEINLINE double __round_uniform_double(double v) {
+    return round(v);
+}
+
+static FORCEINLINE double __floor_uniform_double(double v) {
+    return floor(v);
+}
+
+static FORCEINLINE double __ceil_uniform_double(double v) {
+    return ceil(v);
+}
+
+UNARY_OP(__vec_f, __round_varying_float, __round_uniform_float)
+UNARY_OP(__vec_f, __floor_varying_float, __floor_uniform_float)
+UNARY_OP(__vec_f, __ceil_varying_float, __ceil_uniform_float)
+UNARY_OP(__vec_d, __round_varying_double, __round_uniform_double)
+UNARY_OP(__vec_d, __floor_varying_double, __floor_uniform_double)
+UNARY_OP(__vec_d, __ceil_varying_double, __ceil_uniform_double)
+
+// min/max
+
+static FORCEINLINE float __min_uniform_float(float a, float b) { return (a<b) ? a : b; }
+static FORCEINLINE float __max_uniform_float(float a, float b) { return (a>b) ? a : b; }
+static FORCEINLINE double __min_uniform_double(double a, double b) { return (a<b) ? a : b; }
+static FORCEINLINE double __max_uniform_double(double a, double b) { return (a>b) ? a : b; }
+
+static FORCEINLINE int32_t __min_uniform_int32(int32_t a, int32_t b) { return (a<b) ? a : b; }
+static FORCEINLINE int32_t __max_uniform_int32(int32_t a, int32_t b) { return (a>b) ? a : b; }
+static FORCEINLINE int32_t __min_uniform_uint32(uint32_t a, uint32_t b) { return (a<b) ? a : b; }
+static FORCEINLINE int32_t __max_uniform_uint32(uint32_t a, uint32_t b) { return (a>b) ? a : b; }
+
+static FORCEINLINE int64_t __min_uniform_int64(int64_t a, int64_t b) { return (a<b) ? a : b; }
+static FORCEINLINE int64_t __max_uniform_int64(int64_t a, int64_t b) { return (a>b) ? a : b; }
+static FORCEINLINE int64_t __min_uniform_uint64(uint64_t a, uint64_t b) { return (a<b) ? a : b; }
+static FORCEINLINE int64_t __max_uniform_uint64(uint64_t a, uint64_t b) { return (a>b) ? a : b; }
+
+
+BINARY_OP_FUNC(__vec_f, __max_varying_float, __max_uniform_float)
+BINARY_OP_FUNC(__vec_f, __min_varying_float, __min_uniform_float)
+BINARY_OP_FUNC(__vec_d, __max_varying_double, __max_uniform_double)
+BINARY_OP_FUNC(__vec_d, __min_varying_double, __min_uniform_double)
+
+BINARY_OP_FUNC(__vec_i32, __max_varying_int32, __max_uniform_int32)
+BINARY_OP_FUNC(__vec_i32, __min_varying_int32, __min_uniform_int32)
+BINARY_OP_FUNC(__vec_i32, __max_varying_uint32, __max_uniform_uint32)
+BINARY_OP_FUNC(__vec_i32, __min_varying_uint32, __min_uniform_uint32)
+
+BINARY_OP_FUNC(__vec_i64, __max_varying_int64, __max_uniform_int64)
+BINARY_OP_FUNC(__vec_i64, __min_varying_int64, __min_uniform_int64)
+BINARY_OP_FUNC(__vec_i64, __max_varying_uint64, __max_uniform_uint64)
+BINARY_OP_FUNC(__vec_i64, __min_varying_uint64, __min_uniform_uint64)
+
+// sqrt/rsqrt/rcp
+
+static FORCEINLINE float __rsqrt_uniform_float(float v) {
+    return 1.f / sqrtf(v);
+}
+
+static FORCEINLINE float __rcp_uniform_float(float v) {
+    return 1.f / v;
+}
+
+static FORCEINLINE float __sqrt_uniform_float(float v) {
+    return sqrtf(v);
+}
+
+static FORCEINLINE double __sqrt_uniform_double(double v) {
+    return sqrt(v);
+}
+
+UNARY_OP(__vec_f, __rcp_varying_float, __rcp_uniform_float)
+UNARY_OP(__vec_f, __rsqrt_varying_float, __rsqrt_uniform_float)
+UNARY_OP(__vec_f, __sqrt_varying_float, __sqrt_uniform_float)
+UNARY_OP(__vec_d, __sqrt_varying_double, __sqrt_uniform_double)
+
+///////////////////////////////////////////////////////////////////////////
+// bit ops
+
+static FORCEINLINE int32_t __popcnt_int32(uint32_t v) {
+#ifdef _MSC_VER
+    return __popcnt(v);
+#else
+    return __builtin_popcount(v);
+#endif
+}
+
+static FORCEINLINE int32_t __popcnt_int64(uint64_t v) {
+#ifdef _MSC_VER
+    return (int32_t)__popcnt64(v);
+#else
+    return __builtin_popcountll(v);
+#endif
+}
+
+static FORCEINLINE int32_t __count_trailing_zeros_i32(uint32_t v) {
+    if (v == 0)
+        return 32;
+
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward(&i, v);
+    return i;
+#else
+    return __builtin_ctz(v);
+#endif
+}
+
+static FORCEINLINE int64_t __count_trailing_zeros_i64(uint64_t v) {
+    if (v == 0)
+        return 64;
+
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward64(&i, v);
+    return i;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+static FORCEINLINE int32_t __count_leading_zeros_i32(uint32_t v) {
+    if (v == 0)
+        return 32;
+
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanReverse(&i, v);
+    return 31 - i;
+#else
+    return __builtin_clz(v);
+#endif
+}
+
+static FORCEINLINE int64_t __count_leading_zeros_i64(uint64_t v) {
+    if (v == 0)
+        return 64;
+
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanReverse64(&i, v);
+    return 63 - i;
+#else
+    return __builtin_clzll(v);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////
+// reductions
+
+REDUCE_ADD(float, __vec_f, __reduce_add_float)
+REDUCE_MINMAX(float, __vec_f, __reduce_min_float, lLessThan)
+REDUCE_MINMAX(float, __vec_f, __reduce_max_float, lGreaterThan)
+
+REDUCE_ADD(double, __vec_d, __reduce_add_double)
+REDUCE_MINMAX(double, __vec_d, __reduce_min_double, lLessThan)
+REDUCE_MINMAX(double, __vec_d, __reduce_max_double, lGreaterThan)
+
+REDUCE_ADD(uint32_t, __vec_i32, __reduce_add_int32)
+REDUCE_MINMAX(int32_t, __vec_i32, __reduce_min_int32, lLessThan)
+REDUCE_MINMAX(int32_t, __vec_i32, __reduce_max_int32, lGreaterThan)
+
+REDUCE_ADD(uint32_t, __vec_i32, __reduce_add_uint32)
+REDUCE_MINMAX(uint32_t, __vec_i32, __reduce_min_uint32, lLessThan)
+REDUCE_MINMAX(uint32_t, __vec_i32, __reduce_max_uint32, lGreaterThan)
+
+REDUCE_ADD(uint64_t, __vec_i64, __reduce_add_int64)
+REDUCE_MINMAX(int64_t, __vec_i64, __reduce_min_int64, lLessThan)
+REDUCE_MINMAX(int64_t, __vec_i64, __reduce_max_int64, lGreaterThan)
+
+REDUCE_ADD(uint64_t, __vec_i64, __reduce_add_uint64)
+REDUCE_MINMAX(uint64_t, __vec_i64, __reduce_min_uint64, lLessThan)
+REDUCE_MINMAX(uint64_t, __vec_i64, __reduce_max_uint64, lGreaterThan)
+
+///////////////////////////////////////////////////////////////////////////
+// masked load/store
+
+static FORCEINLINE __vec_i8 __masked_load_i8(void *p, __vec_i1 mask) {
+    return lMaskedLoad<__vec_i8>(p, mask);
+}
+
+static FORCEINLINE __vec_i16 __masked_load_i16(void *p, __vec_i1 mask) {
+    return lMaskedLoad<__vec_i16>(p, mask);
+}
+
+static FORCEINLINE __vec_i32 __masked_load_i32(void *p, __vec_i1 mask) {
+    return lMaskedLoad<__vec_i32>(p, mask);
+}
+
+static FORCEINLINE __vec_f __masked_load_float(void *p, __vec_i1 mask) {
+    return lMaskedLoad<__vec_f>(p, mask);
+}
+
+static FORCEINLINE __vec_i64 __masked_load_i64(void *p, __vec_i1 mask) {
+    return lMaskedLoad<__vec_i64>(p, mask);
+}
+
+static FORCEINLINE __vec_d __masked_load_double(void *p, __vec_i1 mask) {
+    return lMaskedLoad<__vec_d>(p, mask);
+}
+
+static FORCEINLINE void __masked_store_i8(void *p, __vec_i8 val,
+                                          __vec_i1 mask) {
+    lMaskedStore(p, val, mask);
+}
+
+static FORCEINLINE void __masked_store_i16(void *p, __vec_i16 val,
+                                           __vec_i1 mask) {
+    lMaskedStore(p, val, mask);
+}
+
+static FORCEINLINE void __masked_store_i32(void *p, __vec_i32 val,
+                                           __vec_i1 mask) {
+    lMaskedStore(p, val, mask);
+}
+
+static FORCEINLINE void __masked_store_float(void *p, __vec_f val,
+                                             __vec_i1 mask) {
+    lMaskedStore(p, val, mask);
+}
+
+static FORCEINLINE void __masked_store_i64(void *p, __vec_i64 val,
+                                           __vec_i1 mask) {
+    lMaskedStore(p, val, mask);
+}
+
+static FORCEINLINE void __masked_store_double(void *p, __vec_d val,
+                                              __vec_i1 mask) {
+    lMaskedStore(p, val, mask);
+}
+
+static FORCEINLINE void __masked_store_blend_i8(void *p, __vec_i8 val,
+                                                __vec_i1 mask) {
+    __masked_store_i8(p, val, mask);
+}
+
+static FORCEINLINE void __masked_store_blend_i16(void *p, __vec_i16 val,
+                                                 __vec_i1 mask) {
+    __masked_store_i16(p, val, mask);
+}
+
+static FORCEINLINE void __masked_store_blend_i32(void *p, __vec_i32 val,
+                                                 __vec_i1 mask) {
+    __masked_store_i32(p, val, mask);
+}
+
+static FORCEINLINE void __masked_store_blend_float(void *p, __vec_f val,
+                                                   __vec_i1 mask) {
+    __masked_store_float(p, val, mask);
+}
+
+static FORCEINLINE void __masked_store_blend_i64(void *p, __vec_i64 val,
+                                                 __vec_i1 mask) {
+    __masked_store_i64(p, val, mask);
+}
+
+static FORCEINLINE void __masked_store_blend_double(void *p, __vec_d val,
+                                                    __vec_i1 mask) {
+    __masked_store_double(p, val, mask);
+}
+
+///////////////////////////////////////////////////////////////////////////
+// gather/scatter
+
+// offsets * offsetScale is in bytes (for all of these)
+
+#define GATHER_BASE_OFFSETS(VTYPE, STYPE, OTYPE, FUNC)                  \
+static FORCEINLINE VTYPE FUNC(unsigned char *b, uint32_t scale,         \
+                              OTYPE offset, __vec_i1 mask) {            \
+    return lGatherBaseOffsets<VTYPE>(b, scale, offset, mask);           \
+}
+
+// 64-bit offsets go through lGather64, which uses the qword-index
+// hardware gathers for 32- and 64-bit elements when they're available.
+#define GATHER_BASE_OFFSETS64(VTYPE, STYPE, FUNC)                       \
+static FORCEINLINE VTYPE FUNC(unsigned char *b, uint32_t scale,         \
+                              __vec_i64 offset, __vec_i1 mask) {        \
+    return lGather64<__isa_native, sizeof(STYPE)>::gather<VTYPE>(       \
+        b, scale, offset, mask);                                        \
+}
+    
+
+GATHER_BASE_OFFSETS(__vec_i8,  int8_t,  __vec_i32, __gather_base_offsets32_i8)
+GATHER_BASE_OFFSETS64(__vec_i8,  int8_t,  __gather_base_offsets64_i8)
+GATHER_BASE_OFFSETS(__vec_i16, int16_t, __vec_i32, __gather_base_offsets32_i16)
+GATHER_BASE_OFFSETS64(__vec_i16, int16_t, __gather_base_offsets64_i16)
+GATHER_BASE_OFFSETS(__vec_i32, int32_t, __vec_i32, __gather_base_offsets32_i32)
+GATHER_BASE_OFFSETS64(__vec_i32, int32_t, __gather_base_offsets64_i32)
+GATHER_BASE_OFFSETS(__vec_f,   float,   __vec_i32, __gather_base_offsets32_float)
+GATHER_BASE_OFFSETS64(__vec_f,   float,   __gather_base_offsets64_float)
+GATHER_BASE_OFFSETS(__vec_i64, int64_t, __vec_i32, __gather_base_offsets32_i64)
+GATHER_BASE_OFFSETS64(__vec_i64, int64_t, __gather_base_offsets64_i64)
+GATHER_BASE_OFFSETS(__vec_d,   double,  __vec_i32, __gather_base_offsets32_double)
+GATHER_BASE_OFFSETS64(__vec_d,   double,  __gather_base_offsets64_double)
+
+#define GATHER_GENERAL(VTYPE, STYPE, PTRTYPE, FUNC)                      \
+static FORCEINLINE VTYPE FUNC(PTRTYPE ptrs, __vec_i1 mask) {            \
+    return lGather<VTYPE>(ptrs, mask);                                  \
+}
+
+GATHER_GENERAL(__vec_i8,  int8_t,  __vec_i32, __gather32_i8)
+GATHER_GENERAL(__vec_i8,  int8_t,  __vec_i64, __gather64_i8)
+GATHER_GENERAL(__vec_i16, int16_t, __vec_i32, __gather32_i16)
+GATHER_GENERAL(__vec_i16, int16_t, __vec_i64, __gather64_i16)
+GATHER_GENERAL(__vec_i32, int32_t, __vec_i32, __gather32_i32)
+GATHER_GENERAL(__vec_i32, int32_t, __vec_i64, __gather64_i32)
+GATHER_GENERAL(__vec_f,   float,   __vec_i32, __gather32_float)
+GATHER_GENERAL(__vec_f,   float,   __vec_i64, __gather64_float)
+GATHER_GENERAL(__vec_i64, int64_t, __vec_i32, __gather32_i64)
+GATHER_GENERAL(__vec_i64, int64_t, __vec_i64, __gather64_i64)
+GATHER_GENERAL(__vec_d,   double,  __vec_i32, __gather32_double)
+GATHER_GENERAL(__vec_d,   double,  __vec_i64, __gather64_double)
+
+// scatter
+
+#define SCATTER_BASE_OFFSETS(VTYPE, STYPE, OTYPE, FUNC)                 \
+static FORCEINLINE void FUNC(unsigned char *b, uint32_t scale,          \
+                             OTYPE offset, VTYPE val,                   \
+                             __vec_i1 mask) {                           \
+    lScatterBaseOffsets(b, scale, offset, val, mask);                   \
+}
+
+#define SCATTER_BASE_OFFSETS64(VTYPE, STYPE, FUNC)                      \
+static FORCEINLINE void FUNC(unsigned char *b, uint32_t scale,          \
+                             __vec_i64 offset, VTYPE val,               \
+                             __vec_i1 mask) {                           \
+    lGather64<__isa_native, sizeof(STYPE)>::scatter(b, scale, offset,   \
+                                                    val, mask);         \
+}
+    
+
+SCATTER_BASE_OFFSETS(__vec_i8,  int8_t,  __vec_i32, __scatter_base_offsets32_i8)
+SCATTER_BASE_OFFSETS64(__vec_i8,  int8_t,  __scatter_base_offsets64_i8)
+SCATTER_BASE_OFFSETS(__vec_i16, int16_t, __vec_i32, __scatter_base_offsets32_i16)
+SCATTER_BASE_OFFSETS64(__vec_i16, int16_t, __scatter_base_offsets64_i16)
+SCATTER_BASE_OFFSETS(__vec_i32, int32_t, __vec_i32, __scatter_base_offsets32_i32)
+SCATTER_BASE_OFFSETS64(__vec_i32, int32_t, __scatter_base_offsets64_i32)
+SCATTER_BASE_OFFSETS(__vec_f,   float,   __vec_i32, __scatter_base_offsets32_float)
+SCATTER_BASE_OFFSETS64(__vec_f,   float,   __scatter_base_offsets64_float)
+SCATTER_BASE_OFFSETS(__vec_i64, int64_t, __vec_i32, __scatter_base_offsets32_i64)
+SCATTER_BASE_OFFSETS64(__vec_i64, int64_t, __scatter_base_offsets64_i64)
+SCATTER_BASE_OFFSETS(__vec_d,   double,  __vec_i32, __scatter_base_offsets32_double)
+SCATTER_BASE_OFFSETS64(__vec_d,   double,  __scatter_base_offsets64_double)
+
+#define SCATTER_GENERAL(VTYPE, STYPE, PTRTYPE, FUNC)                     \
+static FORCEINLINE void FUNC(PTRTYPE ptrs, VTYPE val, __vec_i1 mask) {  \
+    lScatter(ptrs, val, mask);                                          \
+}
+
+SCATTER_GENERAL(__vec_i8,  int8_t,  __vec_i32, __scatter32_i8)
+SCATTER_GENERAL(__vec_i8,  int8_t,  __vec_i64, __scatter64_i8)
+SCATTER_GENERAL(__vec_i16, int16_t, __vec_i32, __scatter32_i16)
+SCATTER_GENERAL(__vec_i16, int16_t, __vec_i64, __scatter64_i16)
+SCATTER_GENERAL(__vec_i32, int32_t, __vec_i32, __scatter32_i32)
+SCATTER_GENERAL(__vec_i32, int32_t, __vec_i64, __scatter64_i32)
+SCATTER_GENERAL(__vec_f,   float,   __vec_i32, __scatter32_float)
+SCATTER_GENERAL(__vec_f,   float,   __vec_i64, __scatter64_float)
+SCATTER_GENERAL(__vec_i64, int64_t, __vec_i32, __scatter32_i64)
+SCATTER_GENERAL(__vec_i64, int64_t, __vec_i64, __scatter64_i64)
+SCATTER_GENERAL(__vec_d,   double,  __vec_i32, __scatter32_double)
+SCATTER_GENERAL(__vec_d,   double,  __vec_i64, __scatter64_double)
+
+///////////////////////////////////////////////////////////////////////////
+// packed load/store
+
+// Only the set bits of the mask are visited; see lPacked in
+// generic-lanes.h for the AVX-512 expand/compress version.
+
+static FORCEINLINE int32_t __packed_load_active(int32_t *ptr, __vec_i32 *val,
+                                                __vec_i1 mask) {
+    return lPacked<__isa_native>::load(ptr, val, mask);
+}
+
+static FORCEINLINE int32_t __packed_store_active(int32_t *ptr, __vec_i32 val,
+                                                 __vec_i1 mask) {
+    return lPacked<__isa_native>::store(ptr, val, mask);
+}
+
+static FORCEINLINE int32_t __packed_load_active(uint32_t *ptr,
+                                                __vec_i32 *val,
+                                                __vec_i1 mask) {
+    return __packed_load_active((int32_t *)ptr, val, mask);
+}
+
+static FORCEINLINE int32_t __packed_store_active(uint32_t *ptr,
+                                                 __vec_i32 val,
+                                                 __vec_i1 mask) {
+    return __packed_store_active((int32_t *)ptr, val, mask);
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+// aos/soa
+
+static FORCEINLINE void __soa_to_aos3_float(__vec_f v0, __vec_f v1, __vec_f v2,
+                                            float *ptr) {
+    for (int i = 0; i < __vec_f::Lanes; ++i) {
+        *ptr++ = __extract_element(v0, i);
+        *ptr++ = __extract_element(v1, i);
+        *ptr++ = __extract_element(v2, i);
+    }
+}
+
+static FORCEINLINE void __aos_to_soa3_float(float *ptr, __vec_f *out0, __vec_f *out1,
+                                            __vec_f *out2) {
+    for (int i = 0; i < __vec_f::Lanes; ++i) {
+        __insert_element(out0, i, *ptr++);
+        __insert_element(out1, i, *ptr++);
+        __insert_element(out2, i, *ptr++);
+    }
+}
+
+static FORCEINLINE void __soa_to_aos4_float(__vec_f v0, __vec_f v1, __vec_f v2,
+                                            __vec_f v3, float *ptr) {
+    for (int i = 0; i < __vec_f::Lanes; ++i) {
+        *ptr++ = __extract_element(v0, i);
+        *ptr++ = __extract_element(v1, i);
+        *ptr++ = __extract_element(v2, i);
+        *ptr++ = __extract_element(v3, i);
+    }
+}
+
+static FORCEINLINE void __aos_to_soa4_float(float *ptr, __vec_f *out0, __vec_f *out1,
+                                            __vec_f *out2, __vec_f *out3) {
+    for (int i = 0; i < __vec_f::Lanes; ++i) {
+        __insert_element(out0, i, *ptr++);
+        __insert_element(out1, i, *ptr++);
+        __insert_element(out2, i, *ptr++);
+        __insert_element(out3, i, *ptr++);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////
+// prefetch
+
+// The prefetch distance is the caller's business (e.g. prefetch_l2(&a[i +
+// DIST]) in the kernel); these only choose the cache level.
+
+static FORCEINLINE void __prefetch_read_uniform_1(unsigned char *ptr) {
+#ifdef _MSC_VER
+    _mm_prefetch((char *)ptr, _MM_HINT_T0);
+#else
+    __builtin_prefetch(ptr, 0, 3);
+#endif
+}
+
+static FORCEINLINE void __prefetch_read_uniform_2(unsigned char *ptr) {
+#ifdef _MSC_VER
+    _mm_prefetch((char *)ptr, _MM_HINT_T1);
+#else
+    __builtin_prefetch(ptr, 0, 2);
+#endif
+}
+
+static FORCEINLINE void __prefetch_read_uniform_3(unsigned char *ptr) {
+#ifdef _MSC_VER
+    _mm_prefetch((char *)ptr, _MM_HINT_T2);
+#else
+    __builtin_prefetch(ptr, 0, 1);
+#endif
+}
+
+static FORCEINLINE void __prefetch_read_uniform_nt(unsigned char *ptr) {
+#ifdef _MSC_VER
+    _mm_prefetch((char *)ptr, _MM_HINT_NTA);
+#else
+    __builtin_prefetch(ptr, 0, 0);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////
+// streaming stores
+
+// Non-temporal stores for write-once outputs; see lStreaming in
+// generic-lanes.h.  Issue __streaming_store_fence() before the data is
+// consumed by another thread.
+
+static FORCEINLINE void __streaming_store_i32(void *p, __vec_i32 val,
+                                              __vec_i1 mask) {
+    lStreaming<__isa_native>::store(p, val, mask);
+}
+
+static FORCEINLINE void __streaming_store_float(void *p, __vec_f val,
+                                                __vec_i1 mask) {
+    __streaming_store_i32(p, __cast_bits(__vec_i32(), val), mask);
+}
+
+static FORCEINLINE void __streaming_store_i64(void *p, __vec_i64 val,
+                                              __vec_i1 mask) {
+    lStreaming<__isa_native>::store(p, val, mask);
+}
+
+static FORCEINLINE void __streaming_store_double(void *p, __vec_d val,
+                                                 __vec_i1 mask) {
+    __streaming_store_i64(p, __cast_bits(__vec_i64(), val), mask);
+}
+
+static FORCEINLINE void __streaming_store_fence() {
+    lStreaming<__isa_native>::fence();
+}
+
+///////////////////////////////////////////////////////////////////////////
+// atomics
+
+static FORCEINLINE uint32_t __atomic_add(uint32_t *p, uint32_t v) {
+#ifdef _MSC_VER
+    return InterlockedAdd((LONG volatile *)p, v) - v;
+#else
+    return __sync_fetch_and_add(p, v);
+#endif
+}
+
+static FORCEINLINE uint32_t __atomic_sub(uint32_t *p, uint32_t v) {
+#ifdef _MSC_VER
+    return InterlockedAdd((LONG volatile *)p, -v) + v;
+#else
+    return __sync_fetch_and_sub(p, v);
+#endif
+}
+
+static FORCEINLINE uint32_t __atomic_and(uint32_t *p, uint32_t v) {
+#ifdef _MSC_VER
+    return InterlockedAnd((LONG volatile *)p, v);
+#else
+    return __sync_fetch_and_and(p, v);
+#endif
+}
+
+static FORCEINLINE uint32_t __atomic_or(uint32_t *p, uint32_t v) {
+#ifdef _MSC_VER
+    return InterlockedOr((LONG volatile *)p, v);
+#else
+    return __sync_fetch_and_or(p, v);
+#endif
+}
+
+static FORCEINLINE uint32_t __atomic_xor(uint32_t *p, uint32_t v) {
+#ifdef _MSC_VER
+    return InterlockedXor((LONG volatile *)p, v);
+#else
+    return __sync_fetch_and_xor(p, v);
+#endif
+}
+
+static FORCEINLINE uint32_t __atomic_min(uint32_t *p, uint32_t v) {
+    int32_t old, min;
+    do {
+        old = *((volatile int32_t *)p);
+        min = (old < (int32_t)v) ? old : (int32_t)v;
+#ifdef _MSC_VER
+    } while (InterlockedCompareExchange((LONG volatile *)p, min, old) != old);
+#else
+    } while (__sync_bool_compare_and_swap(p, old, min) == false);
+#endif
+    return old;
+}
+
+static FORCEINLINE uint32_t __atomic_max(uint32_t *p, uint32_t v) {
+    int32_t old, max;
+    do {
+        old = *((volatile int32_t *)p);
+        max = (old > (int32_t)v) ? old : (int32_t)v;
+#ifdef _MSC_VER
+    } while (InterlockedCompareExchange((LONG volatile *)p, max, old) != old);
+#else
+    } while (__sync_bool_compare_and_swap(p, old, max) == false);
+#endif
+    return old;
+}
+
+static FORCEINLINE uint32_t __atomic_umin(uint32_t *p, uint32_t v) {
+    uint32_t old, min;
+    do {
+        old = *((volatile uint32_t *)p);
+        min = (old < v) ? old : v;
+#ifdef _MSC_VER
+    } while (InterlockedCompareExchange((LONG volatile *)p, min, old) != old);
+#else
+    } while (__sync_bool_compare_and_swap(p, old, min) == false);
+#endif
+    return old;
+}
+
+static FORCEINLINE uint32_t __atomic_umax(uint32_t *p, uint32_t v) {
+    uint32_t old, max;
+    do {
+        old = *((volatile uint32_t *)p);
+        max = (old > v) ? old : v;
+#ifdef _MSC_VER
+    } while (InterlockedCompareExchange((LONG volatile *)p, max, old) != old);
+#else
+    } while (__sync_bool_compare_and_swap(p, old, max) == false);
+#endif
+    return old;
+}
+
+static FORCEINLINE uint32_t __atomic_xchg(uint32_t *p, uint32_t v) {
+#ifdef _MSC_VER
+    return InterlockedExchange((LONG volatile *)p, v);
+#else
+    return __sync_lock_test_and_set(p, v);
+#endif
+}
+
+static FORCEINLINE uint32_t __atomic_cmpxchg(uint32_t *p, uint32_t cmpval,
+                                             uint32_t newval) {
+#ifdef _MSC_VER
+    return InterlockedCompareExchange((LONG volatile *)p, newval, cmpval);
+#else
+    return __sync_val_compare_and_swap(p, cmpval, newval);
+#endif
+}
+
+static FORCEINLINE uint64_t __atomic_add(uint64_t *p, uint64_t v) {
+#ifdef _MSC_VER
+    return InterlockedAdd64((LONGLONG volatile *)p, v) - v;
+#else
+    return __sync_fetch_and_add(p, v);
+#endif
+}
+
+static FORCEINLINE uint64_t __atomic_sub(uint64_t *p, uint64_t v) {
+#ifdef _MSC_VER
+    return InterlockedAdd64((LONGLONG volatile *)p, -v) + v;
+#else
+    return __sync_fetch_and_sub(p, v);
+#endif
+}
+
+static FORCEINLINE uint64_t __atomic_and(uint64_t *p, uint64_t v) {
+#ifdef _MSC_VER
+    return InterlockedAnd64((LONGLONG volatile *)p, v) - v;
+#else
+    return __sync_fetch_and_and(p, v);
+#endif
+}
+
+static FORCEINLINE uint64_t __atomic_or(uint64_t *p, uint64_t v) {
+#ifdef _MSC_VER
+    return InterlockedOr64((LONGLONG volatile *)p, v) - v;
+#else
+    return __sync_fetch_and_or(p, v);
+#endif
+}
+
+static FORCEINLINE uint64_t __atomic_xor(uint64_t *p, uint64_t v) {
+#ifdef _MSC_VER
+    return InterlockedXor64((LONGLONG volatile *)p, v) - v;
+#else
+    return __sync_fetch_and_xor(p, v);
+#endif
+}
+
+static FORCEINLINE uint64_t __atomic_min(uint64_t *p, uint64_t v) {
+    int64_t old, min;
+    do {
+        old = *((volatile int64_t *)p);
+        min = (old < (int64_t)v) ? old : (int64_t)v;
+#ifdef _MSC_VER
+    } while (InterlockedCompareExchange64((LONGLONG volatile *)p, min, old) != old);
+#else
+    } while (__sync_bool_compare_and_swap(p, old, min) == false);
+#endif
+    return old;
+}
+
+static FORCEINLINE uint64_t __atomic_max(uint64_t *p, uint64_t v) {
+    int64_t old, max;
+    do {
+        old = *((volatile int64_t *)p);
+        max = (old > (int64_t)v) ? old : (int64_t)v;
+#ifdef _MSC_VER
+    } while (InterlockedCompareExchange64((LONGLONG volatile *)p, max, old) != old);
+#else
+    } while (__sync_bool_compare_and_swap(p, old, max) == false);
+#endif
+    return old;
+}
+
+static FORCEINLINE uint64_t __atomic_umin(uint64_t *p, uint64_t v) {
+    uint64_t old, min;
+    do {
+        old = *((volatile uint64_t *)p);
+        min = (old < v) ? old : v;
+#ifdef _MSC_VER
+    } while (InterlockedCompareExchange64((LONGLONG volatile *)p, min, old) != old);
+#else
+    } while (__sync_bool_compare_and_swap(p, old, min) == false);
+#endif
+    return old;
+}
+
+static FORCEINLINE uint64_t __atomic_umax(uint64_t *p, uint64_t v) {
+    uint64_t old, max;
+    do {
+        old = *((volatile uint64_t *)p);
+        max = (old > v) ? old : v;
+#ifdef _MSC_VER
+    } while (InterlockedCompareExchange64((LONGLONG volatile *)p, max, old) != old);
+#else
+    } while (__sync_bool_compare_and_swap(p, old, max) == false);
+#endif
+    return old;
+}
+
+static FORCEINLINE uint64_t __atomic_xchg(uint64_t *p, uint64_t v) {
+#ifdef _MSC_VER
+    return InterlockedExchange64((LONGLONG volatile *)p, v);
+#else
+    return __sync_lock_test_and_set(p, v);
+#endif
+}
+
+static FORCEINLINE uint64_t __atomic_cmpxchg(uint64_t *p, uint64_t cmpval,
+                                             uint64_t newval) {
+#ifdef _MSC_VER
+    return InterlockedCompareExchange64((LONGLONG volatile *)p, newval, cmpval);
+#else
+    return __sync_val_compare_and_swap(p, cmpval, newval);
+#endif
+}
+
+// Varying atomics: one call updates every active lane's address and
+// returns the old values, with lanes that share an address combined into
+// a single atomic (see lAtomicVarying).  The base/offsets form addresses
+// b + scale * offsets[i], like the gathers; the 64 form takes pointers
+// and groups lanes by pointer.
+
+#define ATOMIC_VARYING(VTYPE, UTYPE, COMBINE, STEP, OP, NAME)           \
+static FORCEINLINE VTYPE NAME##_base_offsets32##OP(unsigned char *b,    \
+                                                   uint32_t scale,      \
+                                                   __vec_i32 offsets,   \
+                                                   VTYPE val,           \
+                                                   __vec_i1 mask) {     \
+    return lAtomicVarying<COMBINE, STEP>(                               \
+        lOffsetAddress<__vec_i32>(b, scale, offsets), offsets,          \
+        val, mask, (UTYPE (*)(UTYPE *, UTYPE))NAME);                    \
+}                                                                       \
+static FORCEINLINE VTYPE NAME##64##OP(__vec_i64 ptrs, VTYPE val,        \
+                                      __vec_i1 mask) {                  \
+    return lAtomicVarying<COMBINE, STEP>(                               \
+        lPointerAddress<__vec_i64>(ptrs), ptrs, val, mask,              \
+        (UTYPE (*)(UTYPE *, UTYPE))NAME);                               \
+}
+
+ATOMIC_VARYING(__vec_i32, uint32_t, lAdd, lAdd, _i32, __atomic_add)
+ATOMIC_VARYING(__vec_i32, uint32_t, lAdd, lSub, _i32, __atomic_sub)
+ATOMIC_VARYING(__vec_i32, uint32_t, lAnd, lAnd, _i32, __atomic_and)
+ATOMIC_VARYING(__vec_i32, uint32_t, lOr,  lOr,  _i32, __atomic_or)
+ATOMIC_VARYING(__vec_i32, uint32_t, lXor, lXor, _i32, __atomic_xor)
+ATOMIC_VARYING(__vec_i64, uint64_t, lAdd, lAdd, _i64, __atomic_add)
+ATOMIC_VARYING(__vec_i64, uint64_t, lAdd, lSub, _i64, __atomic_sub)
+ATOMIC_VARYING(__vec_i64, uint64_t, lAnd, lAnd, _i64, __atomic_and)
+ATOMIC_VARYING(__vec_i64, uint64_t, lOr,  lOr,  _i64, __atomic_or)
+ATOMIC_VARYING(__vec_i64, uint64_t, lXor, lXor, _i64, __atomic_xor)
@@ -0,0 +1,1098 @@
+/*
+  Copyright (c) 2010-2012, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Lane-loop templates shared by generic-16.h, generic-32.h and
+// generic-64.h (and avx2x2.h and avx512x2.h, which are those widths on
+// the matching hosts).  Each target header defines its __vecN_* types
+// (which carry a compile-time Lanes count, and MaskBits for the mask),
+// then includes generic-impl.h to stamp out the entry points ispc calls
+// from the templates here.  Code paths that depend on the host ISA are
+// chosen by specializing on the __isa_native tag rather than by width,
+// and work a register at a time, so every width gets the same fast paths.
+//
+// sse4.h (and generic_defs.h, a link to it), knc.h and knc2x.h do not
+// use these templates: their vector types are the intrinsic register types
+// themselves, and each entry point is written against them.
+
+#ifndef GENERIC_LANES_H
+#define GENERIC_LANES_H
+
+#include <stdint.h>
+#include <math.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif // _MSC_VER
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif // __AVX512F__ || __AVX2__
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
+#ifdef _MSC_VER
+#define FORCEINLINE __forceinline
+#define PRE_ALIGN(x)  /*__declspec(align(x))*/
+#define POST_ALIGN(x)
+#define roundf(x) (floorf(x + .5f))
+#define round(x) (floor(x + .5))
+#else
+#define FORCEINLINE __attribute__((always_inline))
+#define PRE_ALIGN(x)
+#define POST_ALIGN(x)  __attribute__ ((aligned(x)))
+#endif
+
+// The examples build as C++98 by default; Lanes is an integral constant
+// expression either way.
+#if __cplusplus >= 201103L
+#define LANES_CONSTEXPR constexpr
+#else
+#define LANES_CONSTEXPR const
+#endif
+
+///////////////////////////////////////////////////////////////////////////
+// width and ISA parameters
+
+template <int N> struct __mask_bits;
+template <> struct __mask_bits<16> { typedef uint16_t type; };
+template <> struct __mask_bits<32> { typedef uint32_t type; };
+template <> struct __mask_bits<64> { typedef uint64_t type; };
+
+// Backend tags.  __isa_native is what the C++ compiler was told it may
+// use; the lane loops below are written for __isa_scalar and only the
+// operations that don't auto-vectorize get specializations.
+struct __isa_scalar { };
+struct __isa_sse2 { };
+struct __isa_avx2 { };
+struct __isa_avx512 { };
+
+#if defined(__AVX512F__)
+typedef __isa_avx512 __isa_native;
+#elif defined(__AVX2__)
+typedef __isa_avx2 __isa_native;
+#elif defined(__SSE2__)
+typedef __isa_sse2 __isa_native;
+#else
+typedef __isa_scalar __isa_native;
+#endif
+
+template <typename BITS>
+static FORCEINLINE bool lLaneOn(BITS bits, int i) {
+    return ((bits >> i) & 1) != 0;
+}
+
+template <typename BITS>
+static FORCEINLINE BITS lLaneBit(int i) {
+    return (BITS)((BITS)1 << i);
+}
+
+template <typename BITS>
+static FORCEINLINE int lLowestLane(BITS bits) {
+#ifdef _MSC_VER
+    unsigned long i;
+#ifdef _WIN64
+    _BitScanForward64(&i, (uint64_t)bits);
+#else
+    if ((uint32_t)bits != 0)
+        _BitScanForward(&i, (uint32_t)bits);
+    else {
+        _BitScanForward(&i, (uint32_t)((uint64_t)bits >> 32));
+        i += 32;
+    }
+#endif
+    return (int)i;
+#else
+    return __builtin_ctzll((unsigned long long)bits);
+#endif
+}
+
+template <typename BITS>
+static FORCEINLINE int lLaneCount(BITS bits) {
+#ifdef _MSC_VER
+    return (int)(__popcnt((uint32_t)bits) +
+                 __popcnt((uint32_t)((uint64_t)bits >> 32)));
+#else
+    return __builtin_popcountll((unsigned long long)bits);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////
+// per-lane operators
+
+#define LANE_OP(NAME, OP)                                           \
+struct NAME {                                                       \
+    template <typename T>                                           \
+    static FORCEINLINE T apply(T a, T b) { return a OP b; }         \
+};
+
+#define LANE_CMP(NAME, OP)                                          \
+struct NAME {                                                       \
+    template <typename T>                                           \
+    static FORCEINLINE bool apply(T a, T b) { return a OP b; }      \
+};
+
+LANE_OP(lAdd, +)
+LANE_OP(lSub, -)
+LANE_OP(lMul, *)
+LANE_OP(lDiv, /)
+LANE_OP(lRem, %)
+LANE_OP(lOr,  |)
+LANE_OP(lAnd, &)
+LANE_OP(lXor, ^)
+LANE_OP(lShl, <<)
+LANE_OP(lShr, >>)
+
+LANE_CMP(lEqual,        ==)
+LANE_CMP(lNotEqual,     !=)
+LANE_CMP(lLessThan,     <)
+LANE_CMP(lLessEqual,    <=)
+LANE_CMP(lGreaterThan,  >)
+LANE_CMP(lGreaterEqual, >=)
+
+struct lOrdered {
+    template <typename T>
+    static FORCEINLINE bool apply(T a, T b) { return (a == a) && (b == b); }
+};
+
+struct lUnordered {
+    template <typename T>
+    static FORCEINLINE bool apply(T a, T b) { return (a != a) || (b != b); }
+};
+
+///////////////////////////////////////////////////////////////////////////
+// elementwise
+
+template <typename VTYPE, typename STYPE>
+static FORCEINLINE VTYPE lUnaryOp(const VTYPE &v, STYPE (*func)(STYPE)) {
+    VTYPE ret;
+    for (int i = 0; i < VTYPE::Lanes; ++i)
+        ret.v[i] = func(v.v[i]);
+    return ret;
+}
+
+template <typename OP, typename CAST, typename VTYPE>
+static FORCEINLINE VTYPE lBinaryOp(const VTYPE &a, const VTYPE &b) {
+    VTYPE ret;
+    for (int i = 0; i < VTYPE::Lanes; ++i)
+        ret.v[i] = OP::apply((CAST)a.v[i], (CAST)b.v[i]);
+    return ret;
+}
+
+template <typename VTYPE, typename STYPE, typename RTYPE>
+static FORCEINLINE VTYPE lBinaryFunc(const VTYPE &a, const VTYPE &b,
+                                     RTYPE (*func)(STYPE, STYPE)) {
+    VTYPE ret;
+    for (int i = 0; i < VTYPE::Lanes; ++i)
+        ret.v[i] = func(a.v[i], b.v[i]);
+    return ret;
+}
+
+template <typename OP, typename CAST, typename VTYPE>
+static FORCEINLINE VTYPE lShiftUniform(const VTYPE &a, int32_t b) {
+    VTYPE ret;
+    for (int i = 0; i < VTYPE::Lanes; ++i)
+        ret.v[i] = OP::apply((CAST)a.v[i], (CAST)b);
+    return ret;
+}
+
+// A compare of one register's worth of lanes, returning their mask bits;
+// the backends specialize it below.  Lanes is 0 where there is none, and
+// lCmpOp runs the lane loop instead.
+template <typename ISA, typename OP, typename CAST>
+struct lCmpKernel {
+    enum { Lanes = 0 };
+    static FORCEINLINE uint64_t apply(const CAST *a, const CAST *b) {
+        return 0;
+    }
+};
+
+template <typename OP, typename CAST, typename MTYPE, typename VTYPE>
+static FORCEINLINE MTYPE lCmpOp(const VTYPE &a, const VTYPE &b) {
+    typedef typename MTYPE::MaskBits Bits;
+    typedef lCmpKernel<__isa_native, OP, CAST> K;
+    MTYPE ret;
+    ret.v = 0;
+    if (K::Lanes != 0 && VTYPE::Lanes >= K::Lanes) {
+        for (int i = 0; i < VTYPE::Lanes; i += K::Lanes)
+            ret.v |= (Bits)((Bits)K::apply((const CAST *)(a.v + i),
+                                           (const CAST *)(b.v + i)) << i);
+        return ret;
+    }
+    for (int i = 0; i < VTYPE::Lanes; ++i)
+        ret.v |= (Bits)((Bits)OP::apply((CAST)a.v[i], (CAST)b.v[i]) << i);
+    return ret;
+}
+
+template <typename MTYPE, typename VTYPE>
+static FORCEINLINE VTYPE lSelect(MTYPE mask, const VTYPE &a, const VTYPE &b) {
+    VTYPE ret;
+    for (int i = 0; i < VTYPE::Lanes; ++i)
+        ret.v[i] = lLaneOn(mask.v, i) ? a.v[i] : b.v[i];
+    return ret;
+}
+
+template <typename VTYPE, typename STYPE>
+static FORCEINLINE VTYPE lSmear(STYPE s) {
+    VTYPE ret;
+    for (int i = 0; i < VTYPE::Lanes; ++i)
+        ret.v[i] = s;
+    return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////
+// cross-lane
+
+// Lane indices wrap modulo the width; Lanes is always a power of two.
+
+template <typename VTYPE>
+static FORCEINLINE VTYPE lBroadcast(const VTYPE &v, int index) {
+    return lSmear<VTYPE>(v.v[index & (VTYPE::Lanes - 1)]);
+}
+
+template <typename VTYPE>
+static FORCEINLINE VTYPE lRotate(const VTYPE &v, int index) {
+    VTYPE ret;
+    for (int i = 0; i < VTYPE::Lanes; ++i)
+        ret.v[i] = v.v[(i + index) & (VTYPE::Lanes - 1)];
+    return ret;
+}
+
+template <typename VTYPE, typename ITYPE>
+static FORCEINLINE VTYPE lShuffle(const VTYPE &v, const ITYPE &index) {
+    VTYPE ret;
+    for (int i = 0; i < VTYPE::Lanes; ++i)
+        ret.v[i] = v.v[index.v[i] & (VTYPE::Lanes - 1)];
+    return ret;
+}
+
+template <typename VTYPE, typename ITYPE>
+static FORCEINLINE VTYPE lShuffle2(const VTYPE &v0, const VTYPE &v1,
+                                   const ITYPE &index) {
+    VTYPE ret;
+    for (int i = 0; i < VTYPE::Lanes; ++i) {
+        int ii = index.v[i] & (2 * VTYPE::Lanes - 1);
+        ret.v[i] = (ii < VTYPE::Lanes) ? v0.v[ii] : v1.v[ii - VTYPE::Lanes];
+    }
+    return ret;
+}
+
+template <typename STYPE, typename VTYPE>
+static FORCEINLINE STYPE lReduceAdd(const VTYPE &v) {
+    STYPE ret = v.v[0];
+    for (int i = 1; i < VTYPE::Lanes; ++i)
+        ret = ret + v.v[i];
+    return ret;
+}
+
+template <typename OP, typename STYPE, typename VTYPE>
+static FORCEINLINE STYPE lReduceMinMax(const VTYPE &v) {
+    STYPE ret = v.v[0];
+    for (int i = 1; i < VTYPE::Lanes; ++i)
+        ret = OP::apply(ret, (STYPE)v.v[i]) ? ret : (STYPE)v.v[i];
+    return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////
+// conversions
+
+template <typename TO, typename STO, typename SFROM, typename FROM>
+static FORCEINLINE TO lCast(const FROM &val) {
+    TO ret;
+    for (int i = 0; i < TO::Lanes; ++i)
+        ret.v[i] = (STO)((SFROM)(val.v[i]));
+    return ret;
+}
+
+template <typename TO, typename MTYPE>
+static FORCEINLINE TO lCastFromMask(MTYPE m, typename TO::ElementType on) {
+    TO ret;
+    for (int i = 0; i < TO::Lanes; ++i)
+        ret.v[i] = lLaneOn(m.v, i) ? on : 0;
+    return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////
+// memory
+
+template <typename VTYPE, typename STYPE>
+static FORCEINLINE VTYPE lLoad(const STYPE *ptr) {
+    VTYPE ret;
+    for (int i = 0; i < VTYPE::Lanes; ++i)
+        ret.v[i] = ptr[i];
+    return ret;
+}
+
+template <typename VTYPE, typename STYPE>
+static FORCEINLINE void lStore(STYPE *ptr, const VTYPE &v) {
+    for (int i = 0; i < VTYPE::Lanes; ++i)
+        ptr[i] = v.v[i];
+}
+
+template <typename VTYPE, typename MTYPE>
+static FORCEINLINE VTYPE lMaskedLoad(const void *p, MTYPE mask) {
+    typedef typename VTYPE::ElementType STYPE;
+    const STYPE *ptr = (const STYPE *)p;
+    VTYPE ret;
+    for (int i = 0; i < VTYPE::Lanes; ++i)
+        if (lLaneOn(mask.v, i))
+            ret.v[i] = ptr[i];
+    return ret;
+}
+
+template <typename VTYPE, typename MTYPE>
+static FORCEINLINE void lMaskedStore(void *p, const VTYPE &val, MTYPE mask) {
+    typedef typename VTYPE::ElementType STYPE;
+    STYPE *ptr = (STYPE *)p;
+    for (int i = 0; i < VTYPE::Lanes; ++i)
+        if (lLaneOn(mask.v, i))
+            ptr[i] = val.v[i];
+}
+
+// offsets * scale is in bytes
+
+template <typename VTYPE, typename OTYPE, typename MTYPE>
+static FORCEINLINE VTYPE lGatherBaseOffsets(unsigned char *b, uint32_t scale,
+                                            const OTYPE &offset, MTYPE mask) {
+    typedef typename VTYPE::ElementType STYPE;
+    VTYPE ret;
+    int8_t *base = (int8_t *)b;
+    for (int i = 0; i < VTYPE::Lanes; ++i)
+        if (lLaneOn(mask.v, i))
+            ret.v[i] = *(STYPE *)(base + scale * offset.v[i]);
+    return ret;
+}
+
+template <typename VTYPE, typename PTYPE, typename MTYPE>
+static FORCEINLINE VTYPE lGather(const PTYPE &ptrs, MTYPE mask) {
+    typedef typename VTYPE::ElementType STYPE;
+    VTYPE ret;
+    for (int i = 0; i < VTYPE::Lanes; ++i)
+        if (lLaneOn(mask.v, i))
+            ret.v[i] = *(STYPE *)ptrs.v[i];
+    return ret;
+}
+
+template <typename VTYPE, typename OTYPE, typename MTYPE>
+static FORCEINLINE void lScatterBaseOffsets(unsigned char *b, uint32_t scale,
+                                            const OTYPE &offset,
+                                            const VTYPE &val, MTYPE mask) {
+    typedef typename VTYPE::ElementType STYPE;
+    int8_t *base = (int8_t *)b;
+    for (int i = 0; i < VTYPE::Lanes; ++i)
+        if (lLaneOn(mask.v, i))
+            *(STYPE *)(base + scale * offset.v[i]) = val.v[i];
+}
+
+template <typename VTYPE, typename PTYPE, typename MTYPE>
+static FORCEINLINE void lScatter(const PTYPE &ptrs, const VTYPE &val,
+                                 MTYPE mask) {
+    typedef typename VTYPE::ElementType STYPE;
+    for (int i = 0; i < VTYPE::Lanes; ++i)
+        if (lLaneOn(mask.v, i))
+            *(STYPE *)ptrs.v[i] = val.v[i];
+}
+
+///////////////////////////////////////////////////////////////////////////
+// ISA-specialized operations
+
+// Packed load/store only visit the set bits of the mask; the AVX-512
+// version maps each 16-lane chunk to vpexpandd / vpcompressd.
+
+template <typename ISA>
+struct lPacked {
+    template <typename VTYPE, typename MTYPE>
+    static FORCEINLINE int32_t load(int32_t *ptr, VTYPE *val, MTYPE mask) {
+        int count = 0;
+        for (typename MTYPE::MaskBits m = mask.v; m != 0; m &= m - 1)
+            val->v[lLowestLane(m)] = ptr[count++];
+        return count;
+    }
+
+    template <typename VTYPE, typename MTYPE>
+    static FORCEINLINE int32_t store(int32_t *ptr, const VTYPE &val,
+                                     MTYPE mask) {
+        int count = 0;
+        for (typename MTYPE::MaskBits m = mask.v; m != 0; m &= m - 1)
+            ptr[count++] = val.v[lLowestLane(m)];
+        return count;
+    }
+};
+
+#ifdef __AVX512F__
+template <>
+struct lPacked<__isa_avx512> {
+    template <typename VTYPE, typename MTYPE>
+    static FORCEINLINE int32_t load(int32_t *ptr, VTYPE *val, MTYPE mask) {
+        int32_t *start = ptr;
+        for (int i = 0; i < VTYPE::Lanes; i += 16) {
+            __mmask16 m = (__mmask16)(mask.v >> i);
+            __m512i v = _mm512_loadu_si512(val->v + i);
+            v = _mm512_mask_expandloadu_epi32(v, m, ptr);
+            _mm512_storeu_si512(val->v + i, v);
+            ptr += lLaneCount(m);
+        }
+        return (int32_t)(ptr - start);
+    }
+
+    template <typename VTYPE, typename MTYPE>
+    static FORCEINLINE int32_t store(int32_t *ptr, const VTYPE &val,
+                                     MTYPE mask) {
+        int32_t *start = ptr;
+        for (int i = 0; i < VTYPE::Lanes; i += 16) {
+            __mmask16 m = (__mmask16)(mask.v >> i);
+            _mm512_mask_compressstoreu_epi32(ptr, m,
+                                             _mm512_loadu_si512(val.v + i));
+            ptr += lLaneCount(m);
+        }
+        return (int32_t)(ptr - start);
+    }
+};
+#endif // __AVX512F__
+
+// Vectors wider than one register are handled a register at a time, so a
+// width is not tied to a backend: 16 lanes of 32 bits on AVX2 take two
+// ymm registers (AVX2 x2), and 32 lanes on AVX-512 two zmm registers
+// (AVX-512 x2).  avx2x2.h and avx512x2.h name those pairings.
+//
+// Compares go a register at a time through lCmpKernel.  The float
+// predicates are the ordered ones, except not-equal, so NaNs compare as
+// the lane loop's C operators do.  AVX2 only has signed integer eq and gt:
+// the others are built from those, with unsigned operands biased by the
+// sign bit first.
+
+#define CMP_KERNEL(ISA, OP, CAST, LANES, EXPR)                          \
+template <>                                                             \
+struct lCmpKernel<ISA, OP, CAST> {                                      \
+    enum { Lanes = LANES };                                             \
+    static FORCEINLINE uint64_t apply(const CAST *a, const CAST *b) {   \
+        return (uint64_t)(EXPR);                                        \
+    }                                                                   \
+};
+
+#ifdef __AVX2__
+#define CMP_KERNELS_AVX2_FP(CAST, LANES, CMP)                           \
+CMP_KERNEL(__isa_avx2, lEqual,        CAST, LANES, CMP(a, b, _CMP_EQ_OQ))  \
+CMP_KERNEL(__isa_avx2, lNotEqual,     CAST, LANES, CMP(a, b, _CMP_NEQ_UQ)) \
+CMP_KERNEL(__isa_avx2, lLessThan,     CAST, LANES, CMP(a, b, _CMP_LT_OQ))  \
+CMP_KERNEL(__isa_avx2, lLessEqual,    CAST, LANES, CMP(a, b, _CMP_LE_OQ))  \
+CMP_KERNEL(__isa_avx2, lGreaterThan,  CAST, LANES, CMP(a, b, _CMP_GT_OQ))  \
+CMP_KERNEL(__isa_avx2, lGreaterEqual, CAST, LANES, CMP(a, b, _CMP_GE_OQ))  \
+CMP_KERNEL(__isa_avx2, lOrdered,      CAST, LANES, CMP(a, b, _CMP_ORD_Q))  \
+CMP_KERNEL(__isa_avx2, lUnordered,    CAST, LANES, CMP(a, b, _CMP_UNORD_Q))
+
+#define lCmpAvx2Float(a, b, PRED)                                       \
+    _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(a),              \
+                                     _mm256_loadu_ps(b), PRED))
+#define lCmpAvx2Double(a, b, PRED)                                      \
+    _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(a),              \
+                                     _mm256_loadu_pd(b), PRED))
+
+CMP_KERNELS_AVX2_FP(float,  8, lCmpAvx2Float)
+CMP_KERNELS_AVX2_FP(double, 4, lCmpAvx2Double)
+
+#undef lCmpAvx2Float
+#undef lCmpAvx2Double
+#undef CMP_KERNELS_AVX2_FP
+
+template <typename CAST> struct lCmpAvx2Int;
+
+#define CMP_AVX2_INT(CAST, LANES, BIAS, CMPEQ, CMPGT, MOVEMASK, FCAST)  \
+template <>                                                             \
+struct lCmpAvx2Int<CAST> {                                              \
+    enum { Lanes = LANES, All = (1 << LANES) - 1 };                     \
+    static FORCEINLINE __m256i load(const CAST *p) {                    \
+        return _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)p), BIAS); \
+    }                                                                   \
+    static FORCEINLINE int eq(const CAST *a, const CAST *b) {           \
+        return MOVEMASK(FCAST(CMPEQ(load(a), load(b))));                \
+    }                                                                   \
+    static FORCEINLINE int gt(const CAST *a, const CAST *b) {           \
+        return MOVEMASK(FCAST(CMPGT(load(a), load(b))));                \
+    }                                                                   \
+};
+
+CMP_AVX2_INT(int32_t,  8, _mm256_setzero_si256(),
+             _mm256_cmpeq_epi32, _mm256_cmpgt_epi32,
+             _mm256_movemask_ps, _mm256_castsi256_ps)
+CMP_AVX2_INT(uint32_t, 8, _mm256_set1_epi32((int)0x80000000),
+             _mm256_cmpeq_epi32, _mm256_cmpgt_epi32,
+             _mm256_movemask_ps, _mm256_castsi256_ps)
+CMP_AVX2_INT(int64_t,  4, _mm256_setzero_si256(),
+             _mm256_cmpeq_epi64, _mm256_cmpgt_epi64,
+             _mm256_movemask_pd, _mm256_castsi256_pd)
+CMP_AVX2_INT(uint64_t, 4, _mm256_set1_epi64x((long long)0x8000000000000000ULL),
+             _mm256_cmpeq_epi64, _mm256_cmpgt_epi64,
+             _mm256_movemask_pd, _mm256_castsi256_pd)
+
+#define CMP_KERNELS_AVX2_INT(CAST)                                      \
+CMP_KERNEL(__isa_avx2, lEqual,        CAST, lCmpAvx2Int<CAST>::Lanes,   \
+           lCmpAvx2Int<CAST>::eq(a, b))                                 \
+CMP_KERNEL(__isa_avx2, lNotEqual,     CAST, lCmpAvx2Int<CAST>::Lanes,   \
+           lCmpAvx2Int<CAST>::All & ~lCmpAvx2Int<CAST>::eq(a, b))       \
+CMP_KERNEL(__isa_avx2, lGreaterThan,  CAST, lCmpAvx2Int<CAST>::Lanes,   \
+           lCmpAvx2Int<CAST>::gt(a, b))                                 \
+CMP_KERNEL(__isa_avx2, lLessThan,     CAST, lCmpAvx2Int<CAST>::Lanes,   \
+           lCmpAvx2Int<CAST>::gt(b, a))                                 \
+CMP_KERNEL(__isa_avx2, lGreaterEqual, CAST, lCmpAvx2Int<CAST>::Lanes,   \
+           lCmpAvx2Int<CAST>::All & ~lCmpAvx2Int<CAST>::gt(b, a))       \
+CMP_KERNEL(__isa_avx2, lLessEqual,    CAST, lCmpAvx2Int<CAST>::Lanes,   \
+           lCmpAvx2Int<CAST>::All & ~lCmpAvx2Int<CAST>::gt(a, b))
+
+CMP_KERNELS_AVX2_INT(int32_t)
+CMP_KERNELS_AVX2_INT(uint32_t)
+CMP_KERNELS_AVX2_INT(int64_t)
+CMP_KERNELS_AVX2_INT(uint64_t)
+
+#undef CMP_KERNELS_AVX2_INT
+#undef CMP_AVX2_INT
+#endif // __AVX2__
+
+#ifdef __AVX512F__
+#define CMP_KERNELS_AVX512(CAST, LANES, CMP, EQ, NE, LT, LE, GT, GE)    \
+CMP_KERNEL(__isa_avx512, lEqual,        CAST, LANES, CMP(a, b, EQ))     \
+CMP_KERNEL(__isa_avx512, lNotEqual,     CAST, LANES, CMP(a, b, NE))     \
+CMP_KERNEL(__isa_avx512, lLessThan,     CAST, LANES, CMP(a, b, LT))     \
+CMP_KERNEL(__isa_avx512, lLessEqual,    CAST, LANES, CMP(a, b, LE))     \
+CMP_KERNEL(__isa_avx512, lGreaterThan,  CAST, LANES, CMP(a, b, GT))     \
+CMP_KERNEL(__isa_avx512, lGreaterEqual, CAST, LANES, CMP(a, b, GE))
+
+#define CMP_KERNELS_AVX512_FP(CAST, LANES, CMP)                         \
+CMP_KERNELS_AVX512(CAST, LANES, CMP, _CMP_EQ_OQ, _CMP_NEQ_UQ,           \
+                   _CMP_LT_OQ, _CMP_LE_OQ, _CMP_GT_OQ, _CMP_GE_OQ)      \
+CMP_KERNEL(__isa_avx512, lOrdered,   CAST, LANES, CMP(a, b, _CMP_ORD_Q)) \
+CMP_KERNEL(__isa_avx512, lUnordered, CAST, LANES, CMP(a, b, _CMP_UNORD_Q))
+
+#define CMP_KERNELS_AVX512_INT(CAST, LANES, CMP)                        \
+CMP_KERNELS_AVX512(CAST, LANES, CMP, _MM_CMPINT_EQ, _MM_CMPINT_NE,      \
+                   _MM_CMPINT_LT, _MM_CMPINT_LE, _MM_CMPINT_NLE, _MM_CMPINT_NLT)
+
+#define lCmpAvx512Float(a, b, PRED)                                     \
+    _mm512_cmp_ps_mask(_mm512_loadu_ps(a), _mm512_loadu_ps(b), PRED)
+#define lCmpAvx512Double(a, b, PRED)                                    \
+    _mm512_cmp_pd_mask(_mm512_loadu_pd(a), _mm512_loadu_pd(b), PRED)
+#define lCmpAvx512I32(a, b, PRED)                                       \
+    _mm512_cmp_epi32_mask(_mm512_loadu_si512(a), _mm512_loadu_si512(b), PRED)
+#define lCmpAvx512U32(a, b, PRED)                                       \
+    _mm512_cmp_epu32_mask(_mm512_loadu_si512(a), _mm512_loadu_si512(b), PRED)
+#define lCmpAvx512I64(a, b, PRED)                                       \
+    _mm512_cmp_epi64_mask(_mm512_loadu_si512(a), _mm512_loadu_si512(b), PRED)
+#define lCmpAvx512U64(a, b, PRED)                                       \
+    _mm512_cmp_epu64_mask(_mm512_loadu_si512(a), _mm512_loadu_si512(b), PRED)
+
+CMP_KERNELS_AVX512_FP(float,     16, lCmpAvx512Float)
+CMP_KERNELS_AVX512_FP(double,     8, lCmpAvx512Double)
+CMP_KERNELS_AVX512_INT(int32_t,  16, lCmpAvx512I32)
+CMP_KERNELS_AVX512_INT(uint32_t, 16, lCmpAvx512U32)
+CMP_KERNELS_AVX512_INT(int64_t,   8, lCmpAvx512I64)
+CMP_KERNELS_AVX512_INT(uint64_t,  8, lCmpAvx512U64)
+
+#undef lCmpAvx512Float
+#undef lCmpAvx512Double
+#undef lCmpAvx512I32
+#undef lCmpAvx512U32
+#undef lCmpAvx512I64
+#undef lCmpAvx512U64
+#undef CMP_KERNELS_AVX512_INT
+#undef CMP_KERNELS_AVX512_FP
+#undef CMP_KERNELS_AVX512
+#endif // __AVX512F__
+
+#undef CMP_KERNEL
+
+// Non-temporal stores for write-once outputs, so they go to memory
+// without evicting the working set.  With SSE2, a full mask to a 16-byte
+// aligned address uses movntdq and otherwise each active lane is written
+// with movnti; the scalar backend falls back to a masked store.  AVX2 and
+// AVX-512 stream whole ymm / zmm registers when the address is aligned
+// to one and the vector fills at least one.
+
+template <typename ISA>
+struct lStreaming {
+    template <typename VTYPE, typename MTYPE>
+    static FORCEINLINE void store(void *p, const VTYPE &val, MTYPE mask) {
+        lMaskedStore(p, val, mask);
+    }
+
+    static FORCEINLINE void fence() { }
+};
+
+#ifdef __SSE2__
+static FORCEINLINE void lStreamLane(int32_t *p, int32_t v) {
+    _mm_stream_si32((int *)p, v);
+}
+
+static FORCEINLINE void lStreamLane(int64_t *p, int64_t v) {
+#ifdef __x86_64__
+    _mm_stream_si64((long long *)p, v);
+#else
+    *p = v;
+#endif
+}
+
+template <>
+struct lStreaming<__isa_sse2> {
+    template <typename VTYPE, typename MTYPE>
+    static FORCEINLINE void store(void *p, const VTYPE &val, MTYPE mask) {
+        typedef typename VTYPE::ElementType STYPE;
+        typedef typename MTYPE::MaskBits Bits;
+        static const int perVector = 16 / sizeof(STYPE);
+        STYPE *ptr = (STYPE *)p;
+        if (mask.v == (Bits)~(Bits)0 && ((uintptr_t)p & 15) == 0) {
+            for (int i = 0; i < VTYPE::Lanes; i += perVector)
+                _mm_stream_si128((__m128i *)(ptr + i),
+                                 _mm_loadu_si128((__m128i *)(val.v + i)));
+            return;
+        }
+        for (Bits m = mask.v; m != 0; m &= m - 1) {
+            int i = lLowestLane(m);
+            lStreamLane(ptr + i, val.v[i]);
+        }
+    }
+
+    static FORCEINLINE void fence() {
+        _mm_sfence();
+    }
+};
+
+#ifdef __AVX2__
+template <>
+struct lStreaming<__isa_avx2> : public lStreaming<__isa_sse2> {
+    template <typename VTYPE, typename MTYPE>
+    static FORCEINLINE void store(void *p, const VTYPE &val, MTYPE mask) {
+        typedef typename VTYPE::ElementType STYPE;
+        typedef typename MTYPE::MaskBits Bits;
+        static const int perRegister = 32 / sizeof(STYPE);
+        STYPE *ptr = (STYPE *)p;
+        if (VTYPE::Lanes >= perRegister && mask.v == (Bits)~(Bits)0 &&
+            ((uintptr_t)p & 31) == 0) {
+            for (int i = 0; i < VTYPE::Lanes; i += perRegister)
+                _mm256_stream_si256(
+                    (__m256i *)(ptr + i),
+                    _mm256_loadu_si256((const __m256i *)(val.v + i)));
+            return;
+        }
+        lStreaming<__isa_sse2>::store(p, val, mask);
+    }
+};
+#endif // __AVX2__
+
+#ifdef __AVX512F__
+template <>
+struct lStreaming<__isa_avx512> : public lStreaming<__isa_sse2> {
+    template <typename VTYPE, typename MTYPE>
+    static FORCEINLINE void store(void *p, const VTYPE &val, MTYPE mask) {
+        typedef typename VTYPE::ElementType STYPE;
+        typedef typename MTYPE::MaskBits Bits;
+        static const int perRegister = 64 / sizeof(STYPE);
+        STYPE *ptr = (STYPE *)p;
+        if (VTYPE::Lanes >= perRegister && mask.v == (Bits)~(Bits)0 &&
+            ((uintptr_t)p & 63) == 0) {
+            for (int i = 0; i < VTYPE::Lanes; i += perRegister)
+                _mm512_stream_si512((__m512i *)(ptr + i),
+                                    _mm512_loadu_si512(val.v + i));
+            return;
+        }
+        lStreaming<__isa_sse2>::store(p, val, mask);
+    }
+};
+#endif // __AVX512F__
+#endif // __SSE2__
+
+// Gather/scatter with 64-bit offsets.  AVX2 and AVX-512 can take qword
+// indices directly (vpgatherq*, and vpscatterq* on AVX-512) for 32- and
+// 64-bit elements, which saves splitting the offsets into 32-bit halves.
+// The scale is an immediate in those instructions, so lGather64Scaled
+// dispatches the ones they can encode to a kernel templated on it;
+// anything else, and 8- and 16-bit elements, run the lane loop.
+
+template <typename ISA, int SIZE>
+struct lGather64 {
+    template <typename VTYPE, typename OTYPE, typename MTYPE>
+    static FORCEINLINE VTYPE gather(unsigned char *b, uint32_t scale,
+                                    const OTYPE &offset, MTYPE mask) {
+        return lGatherBaseOffsets<VTYPE>(b, scale, offset, mask);
+    }
+
+    template <typename VTYPE, typename OTYPE, typename MTYPE>
+    static FORCEINLINE void scatter(unsigned char *b, uint32_t scale,
+                                    const OTYPE &offset, const VTYPE &val,
+                                    MTYPE mask) {
+        lScatterBaseOffsets(b, scale, offset, val, mask);
+    }
+};
+
+template <typename KERNEL>
+struct lGather64Scaled {
+    template <typename VTYPE, typename OTYPE, typename MTYPE>
+    static FORCEINLINE VTYPE gather(unsigned char *b, uint32_t scale,
+                                    const OTYPE &offset, MTYPE mask) {
+        switch (scale) {
+        case 1: return KERNEL::template gather<1, VTYPE>(b, offset, mask);
+        case 2: return KERNEL::template gather<2, VTYPE>(b, offset, mask);
+        case 4: return KERNEL::template gather<4, VTYPE>(b, offset, mask);
+        case 8: return KERNEL::template gather<8, VTYPE>(b, offset, mask);
+        default: return lGatherBaseOffsets<VTYPE>(b, scale, offset, mask);
+        }
+    }
+
+    template <typename VTYPE, typename OTYPE, typename MTYPE>
+    static FORCEINLINE void scatter(unsigned char *b, uint32_t scale,
+                                    const OTYPE &offset, const VTYPE &val,
+                                    MTYPE mask) {
+        switch (scale) {
+        case 1: KERNEL::template scatter<1>(b, offset, val, mask); break;
+        case 2: KERNEL::template scatter<2>(b, offset, val, mask); break;
+        case 4: KERNEL::template scatter<4>(b, offset, val, mask); break;
+        case 8: KERNEL::template scatter<8>(b, offset, val, mask); break;
+        default: lScatterBaseOffsets(b, scale, offset, val, mask); break;
+        }
+    }
+};
+
+template <typename ISA, int SIZE> struct lGather64Kernel;
+
+#ifdef __AVX2__
+// AVX2 gathers take their mask as a vector; expand four mask bits to
+// all-ones elements.
+static FORCEINLINE __m128i lLaneMask4x32(unsigned int bits) {
+    const __m128i sel = _mm_setr_epi32(1, 2, 4, 8);
+    return _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32((int)bits), sel), sel);
+}
+
+static FORCEINLINE __m256i lLaneMask4x64(unsigned int bits) {
+    const __m256i sel = _mm256_setr_epi64x(1, 2, 4, 8);
+    return _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_set1_epi64x(bits), sel),
+                              sel);
+}
+
+// There is no scatter in AVX2; those stay lane loops.
+
+template <>
+struct lGather64Kernel<__isa_avx2, 4> {
+    template <int SCALE, typename VTYPE, typename OTYPE, typename MTYPE>
+    static FORCEINLINE VTYPE gather(unsigned char *b, const OTYPE &offset,
+                                    MTYPE mask) {
+        VTYPE ret;
+        for (int i = 0; i < VTYPE::Lanes; i += 4) {
+            unsigned int bits = (unsigned int)(mask.v >> i) & 0xf;
+            if (bits == 0)
+                continue;
+            __m256i idx = _mm256_loadu_si256((const __m256i *)(offset.v + i));
+            __m128i r = _mm256_mask_i64gather_epi32(_mm_setzero_si128(),
+                                                    (const int *)b, idx,
+                                                    lLaneMask4x32(bits), SCALE);
+            _mm_storeu_si128((__m128i *)(ret.v + i), r);
+        }
+        return ret;
+    }
+
+    template <int SCALE, typename VTYPE, typename OTYPE, typename MTYPE>
+    static FORCEINLINE void scatter(unsigned char *b, const OTYPE &offset,
+                                    const VTYPE &val, MTYPE mask) {
+        lScatterBaseOffsets(b, SCALE, offset, val, mask);
+    }
+};
+
+template <>
+struct lGather64Kernel<__isa_avx2, 8> {
+    template <int SCALE, typename VTYPE, typename OTYPE, typename MTYPE>
+    static FORCEINLINE VTYPE gather(unsigned char *b, const OTYPE &offset,
+                                    MTYPE mask) {
+        VTYPE ret;
+        for (int i = 0; i < VTYPE::Lanes; i += 4) {
+            unsigned int bits = (unsigned int)(mask.v >> i) & 0xf;
+            if (bits == 0)
+                continue;
+            __m256i idx = _mm256_loadu_si256((const __m256i *)(offset.v + i));
+            __m256i r = _mm256_mask_i64gather_epi64(_mm256_setzero_si256(),
+                                                    (const long long *)b, idx,
+                                                    lLaneMask4x64(bits), SCALE);
+            _mm256_storeu_si256((__m256i *)(ret.v + i), r);
+        }
+        return ret;
+    }
+
+    template <int SCALE, typename VTYPE, typename OTYPE, typename MTYPE>
+    static FORCEINLINE void scatter(unsigned char *b, const OTYPE &offset,
+                                    const VTYPE &val, MTYPE mask) {
+        lScatterBaseOffsets(b, SCALE, offset, val, mask);
+    }
+};
+
+template <> struct lGather64<__isa_avx2, 4>
+    : public lGather64Scaled<lGather64Kernel<__isa_avx2, 4> > { };
+template <> struct lGather64<__isa_avx2, 8>
+    : public lGather64Scaled<lGather64Kernel<__isa_avx2, 8> > { };
+#endif // __AVX2__
+
+#ifdef __AVX512F__
+// Eight qword indices per instruction; overlapping scatter lanes are
+// written in lane order, as in the loop.
+
+template <>
+struct lGather64Kernel<__isa_avx512, 4> {
+    template <int SCALE, typename VTYPE, typename OTYPE, typename MTYPE>
+    static FORCEINLINE VTYPE gather(unsigned char *b, const OTYPE &offset,
+                                    MTYPE mask) {
+        VTYPE ret;
+        for (int i = 0; i < VTYPE::Lanes; i += 8) {
+            __mmask8 m = (__mmask8)(mask.v >> i);
+            if (m == 0)
+                continue;
+            __m512i idx = _mm512_loadu_si512(offset.v + i);
+            __m256i r = _mm512_mask_i64gather_epi32(_mm256_setzero_si256(), m,
+                                                    idx, b, SCALE);
+            _mm256_storeu_si256((__m256i *)(ret.v + i), r);
+        }
+        return ret;
+    }
+
+    template <int SCALE, typename VTYPE, typename OTYPE, typename MTYPE>
+    static FORCEINLINE void scatter(unsigned char *b, const OTYPE &offset,
+                                    const VTYPE &val, MTYPE mask) {
+        for (int i = 0; i < VTYPE::Lanes; i += 8) {
+            __mmask8 m = (__mmask8)(mask.v >> i);
+            if (m == 0)
+                continue;
+            __m512i idx = _mm512_loadu_si512(offset.v + i);
+            __m256i v = _mm256_loadu_si256((const __m256i *)(val.v + i));
+            _mm512_mask_i64scatter_epi32(b, m, idx, v, SCALE);
+        }
+    }
+};
+
+template <>
+struct lGather64Kernel<__isa_avx512, 8> {
+    template <int SCALE, typename VTYPE, typename OTYPE, typename MTYPE>
+    static FORCEINLINE VTYPE gather(unsigned char *b, const OTYPE &offset,
+                                    MTYPE mask) {
+        VTYPE ret;
+        for (int i = 0; i < VTYPE::Lanes; i += 8) {
+            __mmask8 m = (__mmask8)(mask.v >> i);
+            if (m == 0)
+                continue;
+            __m512i idx = _mm512_loadu_si512(offset.v + i);
+            __m512i r = _mm512_mask_i64gather_epi64(_mm512_setzero_si512(), m,
+                                                    idx, b, SCALE);
+            _mm512_storeu_si512(ret.v + i, r);
+        }
+        return ret;
+    }
+
+    template <int SCALE, typename VTYPE, typename OTYPE, typename MTYPE>
+    static FORCEINLINE void scatter(unsigned char *b, const OTYPE &offset,
+                                    const VTYPE &val, MTYPE mask) {
+        for (int i = 0; i < VTYPE::Lanes; i += 8) {
+            __mmask8 m = (__mmask8)(mask.v >> i);
+            if (m == 0)
+                continue;
+            __m512i idx = _mm512_loadu_si512(offset.v + i);
+            _mm512_mask_i64scatter_epi64(b, m, idx,
+                                         _mm512_loadu_si512(val.v + i), SCALE);
+        }
+    }
+};
+
+template <> struct lGather64<__isa_avx512, 4>
+    : public lGather64Scaled<lGather64Kernel<__isa_avx512, 4> > { };
+template <> struct lGather64<__isa_avx512, 8>
+    : public lGather64Scaled<lGather64Kernel<__isa_avx512, 8> > { };
+#endif // __AVX512F__
+
+
+// Vector atomics.  Lanes that target the same address are combined first,
+// so each distinct address costs one locked operation; every lane still
+// gets back the value it would have seen had the lanes' atomics run one
+// after another in lane order.  Addresses are compared by key (32-bit
+// offsets or 64-bit pointers), a chunk of lanes at a time.  The scalar
+// version treats the whole vector as one chunk and finds each group with
+// a loop; AVX-512 compares a register's worth of keys per instruction and,
+// with AVX512CD, uses vpconflict to send lanes whose key is unique in
+// their chunk straight to the atomic.
+
+template <typename ISA, int KSIZE>
+struct lConflict {
+    enum { ChunkLanes = 64 };
+
+    template <typename KTYPE>
+    static FORCEINLINE uint64_t distinct(const KTYPE &key, int c,
+                                         uint64_t todo) {
+        return 0;
+    }
+
+    template <typename KTYPE>
+    static FORCEINLINE uint64_t same(const KTYPE &key, int c, uint64_t todo,
+                                     int lead) {
+        uint64_t match = 0;
+        for (uint64_t m = todo; m != 0; m &= m - 1) {
+            int i = lLowestLane(m);
+            if (key.v[c + i] == key.v[c + lead])
+                match |= lLaneBit<uint64_t>(i);
+        }
+        return match;
+    }
+};
+
+#ifdef __AVX512F__
+template <>
+struct lConflict<__isa_avx512, 4> {
+    enum { ChunkLanes = 16 };
+
+    template <typename KTYPE>
+    static FORCEINLINE uint64_t distinct(const KTYPE &key, int c,
+                                         uint64_t todo) {
+#ifdef __AVX512CD__
+        // conflict[i] has bit j set for each earlier lane j with the same
+        // key; a lane is alone if it has no active earlier match and no
+        // active later lane lists it.
+        __mmask16 active = (__mmask16)todo;
+        __m512i conflict = _mm512_maskz_and_epi32(active,
+            _mm512_conflict_epi32(_mm512_loadu_si512(key.v + c)),
+            _mm512_set1_epi32(active));
+        __mmask16 hasEarlier = _mm512_test_epi32_mask(conflict, conflict);
+        __mmask16 hasLater = (__mmask16)_mm512_reduce_or_epi32(conflict);
+        return (uint64_t)(active & ~hasEarlier & ~hasLater);
+#else
+        return 0;
+#endif
+    }
+
+    template <typename KTYPE>
+    static FORCEINLINE uint64_t same(const KTYPE &key, int c, uint64_t todo,
+                                     int lead) {
+        return _mm512_mask_cmpeq_epi32_mask((__mmask16)todo,
+                                            _mm512_loadu_si512(key.v + c),
+                                            _mm512_set1_epi32(key.v[c + lead]));
+    }
+};
+
+template <>
+struct lConflict<__isa_avx512, 8> {
+    enum { ChunkLanes = 8 };
+
+    template <typename KTYPE>
+    static FORCEINLINE uint64_t distinct(const KTYPE &key, int c,
+                                         uint64_t todo) {
+#ifdef __AVX512CD__
+        __mmask8 active = (__mmask8)todo;
+        __m512i conflict = _mm512_maskz_and_epi64(active,
+            _mm512_conflict_epi64(_mm512_loadu_si512(key.v + c)),
+            _mm512_set1_epi64(active));
+        __mmask8 hasEarlier = _mm512_test_epi64_mask(conflict, conflict);
+        __mmask8 hasLater = (__mmask8)_mm512_reduce_or_epi64(conflict);
+        return (uint64_t)(active & ~hasEarlier & ~hasLater & 0xff);
+#else
+        return 0;
+#endif
+    }
+
+    template <typename KTYPE>
+    static FORCEINLINE uint64_t same(const KTYPE &key, int c, uint64_t todo,
+                                     int lead) {
+        return _mm512_mask_cmpeq_epi64_mask((__mmask8)todo,
+                                            _mm512_loadu_si512(key.v + c),
+                                            _mm512_set1_epi64(key.v[c + lead]));
+    }
+};
+#endif // __AVX512F__
+
+// Where lane i's atomic goes: b + scale * offsets[i] for the base/offsets
+// forms, as in lGatherBaseOffsets, or the lane's own pointer for the 64
+// forms, as in lGather.
+
+template <typename OTYPE>
+struct lOffsetAddress {
+    lOffsetAddress(unsigned char *b, uint32_t s, const OTYPE &o)
+        : base((int8_t *)b), scale(s), offset(o) { }
+    FORCEINLINE void *operator()(int i) const {
+        return base + scale * offset.v[i];
+    }
+    int8_t *base;
+    uint32_t scale;
+    const OTYPE &offset;
+};
+
+template <typename PTYPE>
+struct lPointerAddress {
+    lPointerAddress(const PTYPE &p) : ptrs(p) { }
+    FORCEINLINE void *operator()(int i) const {
+        return (void *)(uintptr_t)ptrs.v[i];
+    }
+    const PTYPE &ptrs;
+};
+
+// COMBINE folds the values of lanes sharing an address into the single
+// operand of the atomic (add for both add and sub); STEP replays each
+// lane's update on the old value to produce what that lane returns.
+// Lanes are grouped by key: the offsets or the pointers themselves.
+
+template <typename COMBINE, typename STEP, typename ADDRESS, typename VTYPE,
+          typename KTYPE, typename MTYPE, typename UTYPE>
+static FORCEINLINE VTYPE lAtomicVarying(const ADDRESS &address,
+                                        const KTYPE &key, const VTYPE &val,
+                                        MTYPE mask,
+                                        UTYPE (*atomic)(UTYPE *, UTYPE)) {
+    typedef typename VTYPE::ElementType STYPE;
+    typedef lConflict<__isa_native, sizeof(typename KTYPE::ElementType)> C;
+    VTYPE ret;
+    for (int c = 0; c < VTYPE::Lanes; c += C::ChunkLanes) {
+        uint64_t todo = (uint64_t)(mask.v >> c);
+        if (C::ChunkLanes < 64)
+            todo &= (((uint64_t)1 << (C::ChunkLanes & 63)) - 1);
+
+        uint64_t alone = C::distinct(key, c, todo);
+        for (uint64_t m = alone; m != 0; m &= m - 1) {
+            int i = c + lLowestLane(m);
+            ret.v[i] = (STYPE)atomic((UTYPE *)address(i), (UTYPE)val.v[i]);
+        }
+        todo &= ~alone;
+
+        while (todo != 0) {
+            int lead = lLowestLane(todo);
+            uint64_t group = C::same(key, c, todo, lead);
+            STYPE total = val.v[c + lead];
+            for (uint64_t m = group & (group - 1); m != 0; m &= m - 1)
+                total = COMBINE::apply(total, val.v[c + lLowestLane(m)]);
+
+            STYPE old = (STYPE)atomic((UTYPE *)address(c + lead), (UTYPE)total);
+            for (uint64_t m = group; m != 0; m &= m - 1) {
+                int i = c + lLowestLane(m);
+                ret.v[i] = old;
+                old = STEP::apply(old, val.v[i]);
+            }
+            todo &= ~group;
+        }
+    }
+    return ret;
+}
+
+#endif // GENERIC_LANES_H
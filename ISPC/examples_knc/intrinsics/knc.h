@@ -1712,22 +1712,36 @@ __gather_base_offsets32_double(uint8_t *base, uint32_t scale, __vec16_i32 offset
 
 /*! gather with 64-bit offsets.
 
-  \todo add optimization that falls back to 32-bit offset gather if
-  upper 32 bits are all 0es (in practice, offsets are usually array
-  indices, and _usually_ <4G even if the compiler cannot statically
-  figure out that this is the case */
+  The 32-bit gathers sign-extend v_lo, so the high half we group lanes
+  by is adjusted to match: offset == (hi << 32) + sext(v_lo).  In
+  practice offsets are array indices and hi is 0 in every active lane
+  even if the compiler cannot statically figure that out; that case is
+  a single 32-bit gather. */
+
+static FORCEINLINE __m512i lOffsets64Hi(__vec16_i64 offsets) {
+    return _mm512_sub_epi32(offsets.v_hi, _mm512_srai_epi32(offsets.v_lo, 31));
+}
+
+static FORCEINLINE bool lOffsets64Fit32(__m512i hi, __vec16_i1 mask) {
+    return _mm512_mask_cmp_epi32_mask(mask, hi, _mm512_setzero_epi32(),
+                                      _MM_CMPINT_NE) == 0;
+}
 
 static FORCEINLINE __vec16_f
 __gather_base_offsets64_float(uint8_t *_base, uint32_t scale, __vec16_i64 offsets,
                               __vec16_i1 mask) {
     // There is no gather instruction with 64-bit offsets in KNC.
     // We have to manually iterate over the upper 32 bits ;-)
+    __m512i hi = lOffsets64Hi(offsets);
+    if (lOffsets64Fit32(hi, mask))
+        return __gather_base_offsets32_float(_base, scale, offsets.v_lo, mask);
+
     __vec16_i1 still_to_do = mask;
     __vec16_f ret;
     while (still_to_do) {
         int first_active_lane = _mm_tzcnt_32((int)still_to_do);
-        const uint &hi32 = ((uint*)&offsets.v_hi)[first_active_lane];
-        __vec16_i1 match = _mm512_mask_cmp_epi32_mask(mask,offsets.v_hi,
+        const uint &hi32 = ((uint*)&hi)[first_active_lane];
+        __vec16_i1 match = _mm512_mask_cmp_epi32_mask(mask,hi,
                                                       __smear_i32<__vec16_i32>((int32_t)hi32),
                                                       _MM_CMPINT_EQ);
         
@@ -1747,12 +1761,16 @@ static FORCEINLINE __vec16_i8
 __gather_base_offsets64_i8(uint8_t *_base, uint32_t scale, __vec16_i64 offsets,
                            __vec16_i1 mask) 
 { 
+    __m512i hi = lOffsets64Hi(offsets);
+    if (lOffsets64Fit32(hi, mask))
+        return __gather_base_offsets32_i8(_base, scale, offsets.v_lo, mask);
+
     __vec16_i1 still_to_do = mask;
     __vec16_i32 tmp;
     while (still_to_do) {
         int first_active_lane = _mm_tzcnt_32((int)still_to_do);
-        const uint &hi32 = ((uint*)&offsets.v_hi)[first_active_lane];
-        __vec16_i1 match = _mm512_mask_cmp_epi32_mask(mask,offsets.v_hi,
+        const uint &hi32 = ((uint*)&hi)[first_active_lane];
+        __vec16_i1 match = _mm512_mask_cmp_epi32_mask(mask,hi,
                                                       __smear_i32<__vec16_i32>((int32_t)hi32),
                                                       _MM_CMPINT_EQ);
     
@@ -1769,15 +1787,41 @@ __gather_base_offsets64_i8(uint8_t *_base, uint32_t scale, __vec16_i64 offsets,
 }
 
 
+// scatter
+
+static FORCEINLINE void
+__scatter_base_offsets32_i32(uint8_t *b, uint32_t scale, __vec16_i32 offsets,
+                             __vec16_i32 val, __vec16_i1 mask)
+{
+    _mm512_mask_i32extscatter_epi32(b, mask, offsets, val, 
+                                    _MM_DOWNCONV_EPI32_NONE, scale, 
+                                    _MM_HINT_NONE);
+}
+
+static FORCEINLINE void 
+__scatter_base_offsets32_float(void *base, uint32_t scale, __vec16_i32 offsets,
+                               __vec16_f val, __vec16_i1 mask) 
+{ 
+    _mm512_mask_i32extscatter_ps(base, mask, offsets, val, 
+                                 _MM_DOWNCONV_PS_NONE, scale,
+                                 _MM_HINT_NONE);
+}
+
 static FORCEINLINE void
 __scatter_base_offsets64_float(uint8_t *_base, uint32_t scale, __vec16_i64 offsets,
                                __vec16_f value,
                                __vec16_i1 mask) { 
+    __m512i hi = lOffsets64Hi(offsets);
+    if (lOffsets64Fit32(hi, mask)) {
+        __scatter_base_offsets32_float(_base, scale, offsets.v_lo, value, mask);
+        return;
+    }
+
     __vec16_i1 still_to_do = mask;
     while (still_to_do) {
         int first_active_lane = _mm_tzcnt_32((int)still_to_do);
-        const uint &hi32 = ((uint*)&offsets.v_hi)[first_active_lane];
-        __vec16_i1 match = _mm512_mask_cmp_epi32_mask(mask,offsets.v_hi,
+        const uint &hi32 = ((uint*)&hi)[first_active_lane];
+        __vec16_i1 match = _mm512_mask_cmp_epi32_mask(mask,hi,
                                                       __smear_i32<__vec16_i32>((int32_t)hi32),
                                                       _MM_CMPINT_EQ);
 
@@ -1795,11 +1839,17 @@ static FORCEINLINE void
 __scatter_base_offsets64_i32(uint8_t *_base, uint32_t scale, __vec16_i64 offsets,
                              __vec16_i32 value,
                              __vec16_i1 mask) { 
+    __m512i hi = lOffsets64Hi(offsets);
+    if (lOffsets64Fit32(hi, mask)) {
+        __scatter_base_offsets32_i32(_base, scale, offsets.v_lo, value, mask);
+        return;
+    }
+
     __vec16_i1 still_to_do = mask;
     while (still_to_do) {
         int first_active_lane = _mm_tzcnt_32((int)still_to_do);
-        const uint &hi32 = ((uint*)&offsets.v_hi)[first_active_lane];
-        __vec16_i1 match = _mm512_mask_cmp_epi32_mask(mask,offsets.v_hi,
+        const uint &hi32 = ((uint*)&hi)[first_active_lane];
+        __vec16_i1 match = _mm512_mask_cmp_epi32_mask(mask,hi,
                                                       __smear_i32<__vec16_i32>((int32_t)hi32),
                                                       _MM_CMPINT_EQ);
     
@@ -1823,35 +1873,17 @@ __gather_base_offsets64_i32(uint8_t *_base, uint32_t scale, __vec16_i64 offsets,
     return (__vec16_i32&)r;
 }
 
-// scatter
-
-static FORCEINLINE void
-__scatter_base_offsets32_i32(uint8_t *b, uint32_t scale, __vec16_i32 offsets,
-                             __vec16_i32 val, __vec16_i1 mask)
-{
-    _mm512_mask_i32extscatter_epi32(b, mask, offsets, val, 
-                                    _MM_DOWNCONV_EPI32_NONE, scale, 
-                                    _MM_HINT_NONE);
-}
-
-static FORCEINLINE void 
-__scatter_base_offsets32_float(void *base, uint32_t scale, __vec16_i32 offsets,
-                               __vec16_f val, __vec16_i1 mask) 
-{ 
-    _mm512_mask_i32extscatter_ps(base, mask, offsets, val, 
-                                 _MM_DOWNCONV_PS_NONE, scale,
-                                 _MM_HINT_NONE);
-}
-
 ///////////////////////////////////////////////////////////////////////////
 // packed load/store
 ///////////////////////////////////////////////////////////////////////////
 
+// Inactive lanes of *val keep their previous contents, so start from the
+// old value and let both unpack halves merge into it.
 static FORCEINLINE int32_t __packed_load_active(uint32_t *p, __vec16_i32 *val,
                                                 __vec16_i1 mask) {
-    __vec16_i32 v;
+    __vec16_i32 v = __load<64>(val);
     v = _mm512_mask_extloadunpacklo_epi32(v, mask, p, _MM_UPCONV_EPI32_NONE, _MM_HINT_NONE);
-    v = _mm512_mask_extloadunpackhi_epi32(_mm512_undefined_epi32(), mask, (uint8_t*)p+64, _MM_UPCONV_EPI32_NONE, _MM_HINT_NONE);
+    v = _mm512_mask_extloadunpackhi_epi32(v, mask, (uint8_t*)p+64, _MM_UPCONV_EPI32_NONE, _MM_HINT_NONE);
     __store<64>(val, v);
     return _mm_countbits_32(uint32_t(mask));
 }
@@ -1863,6 +1895,16 @@ static FORCEINLINE int32_t __packed_store_active(uint32_t *p, __vec16_i32 val,
     return _mm_countbits_32(uint32_t(mask));
 }
 
+static FORCEINLINE int32_t __packed_load_active(int32_t *p, __vec16_i32 *val,
+                                                __vec16_i1 mask) {
+    return __packed_load_active((uint32_t *)p, val, mask);
+}
+
+static FORCEINLINE int32_t __packed_store_active(int32_t *p, __vec16_i32 val,
+                                                 __vec16_i1 mask) {
+    return __packed_store_active((uint32_t *)p, val, mask);
+}
+
 ///////////////////////////////////////////////////////////////////////////
 // prefetch
 ///////////////////////////////////////////////////////////////////////////
@@ -1884,6 +1926,80 @@ static FORCEINLINE void __prefetch_read_uniform_nt(const char *p) {
     // _mm_prefetch(p, _MM_HINT_NTA); // prefetch into L1$ with non-temporal hint
 }
 
+///////////////////////////////////////////////////////////////////////////
+// streaming stores
+///////////////////////////////////////////////////////////////////////////
+
+// Non-temporal stores for write-once outputs.  A full mask to a 64-byte
+// aligned address uses the no-read, non-globally-ordered store, so the
+// line is neither read for ownership nor kept in L2$; partial masks use a
+// masked store with the NT hint.  Unaligned addresses go through the
+// regular masked store.  Issue __streaming_store_fence() before the data
+// is consumed by another thread.
+
+static FORCEINLINE void __streaming_store_i32(void *p, __vec16_i32 val,
+                                              __vec16_i1 mask) {
+    if (((uintptr_t)p & 63) != 0)
+        __masked_store_i32(p, val, mask);
+    else if (__all(mask))
+        _mm512_storenrngo_ps(p, _mm512_castsi512_ps(val.v));
+    else
+        _mm512_mask_extstore_epi32(p, mask, val.v, _MM_DOWNCONV_EPI32_NONE, _MM_HINT_NT);
+}
+
+static FORCEINLINE void __streaming_store_float(void *p, __vec16_f val,
+                                                __vec16_i1 mask) {
+    if (((uintptr_t)p & 63) != 0)
+        __masked_store_float(p, val, mask);
+    else if (__all(mask))
+        _mm512_storenrngo_ps(p, val.v);
+    else
+        _mm512_mask_extstore_ps(p, mask, val.v, _MM_DOWNCONV_PS_NONE, _MM_HINT_NT);
+}
+
+static FORCEINLINE void __streaming_store_double(void *p, __vec16_d val,
+                                                 __vec16_i1 mask) {
+    if (((uintptr_t)p & 63) != 0)
+        __masked_store_double(p, val, mask);
+    else if (__all(mask)) {
+        _mm512_storenrngo_pd(p, val.v1);
+        _mm512_storenrngo_pd((uint8_t*)p+64, val.v2);
+    }
+    else {
+        __vec16_i1 tmp_m = _mm512_kswapb(mask, mask);
+        _mm512_mask_extstore_pd(p, mask, val.v1, _MM_DOWNCONV_PD_NONE, _MM_HINT_NT);
+        _mm512_mask_extstore_pd((uint8_t*)p+64, tmp_m, val.v2, _MM_DOWNCONV_PD_NONE, _MM_HINT_NT);
+    }
+}
+
+static FORCEINLINE void __streaming_store_i64(void *p, __vec16_i64 val,
+                                              __vec16_i1 mask) {
+    // Interleave the 32-bit halves into lane order, as __store<64> does,
+    // and store the bits as doubles
+    __vec16_d bits;
+    __m512i lanes;
+    lanes = _mm512_mask_permutevar_epi32(_mm512_undefined_epi32(), 0xAAAA,
+                                         _mm512_set_16to16_pi(7,7,6,6,5,5,4,4,3,3,2,2,1,1,0,0),
+                                         val.v_hi);
+    lanes = _mm512_mask_permutevar_epi32(lanes, 0x5555,
+                                         _mm512_set_16to16_pi(7,7,6,6,5,5,4,4,3,3,2,2,1,1,0,0),
+                                         val.v_lo);
+    bits.v1 = _mm512_castsi512_pd(lanes);
+    lanes = _mm512_mask_permutevar_epi32(_mm512_undefined_epi32(), 0xAAAA,
+                                         _mm512_set_16to16_pi(15,15,14,14,13,13,12,12,11,11,10,10,9,9,8,8),
+                                         val.v_hi);
+    lanes = _mm512_mask_permutevar_epi32(lanes, 0x5555,
+                                         _mm512_set_16to16_pi(15,15,14,14,13,13,12,12,11,11,10,10,9,9,8,8),
+                                         val.v_lo);
+    bits.v2 = _mm512_castsi512_pd(lanes);
+    __streaming_store_double(p, bits, mask);
+}
+
+static FORCEINLINE void __streaming_store_fence() {
+    // storenrngo stores are weakly ordered; a locked op orders them
+    __sync_synchronize();
+}
+
 ///////////////////////////////////////////////////////////////////////////
 // atomics
 ///////////////////////////////////////////////////////////////////////////
@@ -2106,6 +2222,77 @@ static FORCEINLINE uint64_t __atomic_cmpxchg(uint64_t *p, uint64_t cmpval,
 #endif
 }
 
+// Varying atomics on b + scale * offsets[i], or on 64-bit pointers.  KNC
+// has no vpconflictd, so the lanes sharing the lowest active lane's
+// address are found with one compare (two for pointers, one per 32-bit
+// half) and folded with a reduction; each distinct address then costs a
+// single locked operation.  Each lane gets back the old value it would
+// have seen had the lanes' atomics run one after another in lane order.
+
+static FORCEINLINE int32_t lMaskReduceXor(__vec16_i1 mask, __vec16_i32 v) {
+    int32_t r = 0;
+    for (int m = mask; m != 0; m &= m - 1)
+        r ^= ((int32_t *)&v)[_mm_tzcnt_32(m)];
+    return r;
+}
+
+#define ATOMIC_VARYING_I32(NAME, REDUCE, STEP)                          \
+static FORCEINLINE __vec16_i32                                          \
+NAME##_base_offsets32_i32(uint8_t *b, uint32_t scale,                   \
+                          __vec16_i32 offsets, __vec16_i32 val,         \
+                          __vec16_i1 mask) {                            \
+    __vec16_i32 ret;                                                    \
+    __vec16_i1 still_to_do = mask;                                      \
+    while (still_to_do) {                                               \
+        int lead = _mm_tzcnt_32((int)still_to_do);                      \
+        int32_t offset = ((int32_t *)&offsets)[lead];                   \
+        __vec16_i1 match = _mm512_mask_cmp_epi32_mask(still_to_do, offsets, \
+                                                      _mm512_set1_epi32(offset), \
+                                                      _MM_CMPINT_EQ);   \
+        uint32_t old = NAME((uint32_t *)(b + (int64_t)offset * scale),  \
+                            (uint32_t)REDUCE(match, val));              \
+        for (int m = match; m != 0; m &= m - 1) {                       \
+            int i = _mm_tzcnt_32(m);                                    \
+            ((uint32_t *)&ret)[i] = old;                                \
+            old = old STEP ((uint32_t *)&val)[i];                       \
+        }                                                               \
+        still_to_do = _mm512_kxor(match, still_to_do);                  \
+    }                                                                   \
+    return ret;                                                         \
+}                                                                       \
+                                                                        \
+static FORCEINLINE __vec16_i32                                          \
+NAME##64_i32(__vec16_i64 ptrs, __vec16_i32 val, __vec16_i1 mask) {      \
+    __vec16_i32 ret;                                                    \
+    __vec16_i1 still_to_do = mask;                                      \
+    while (still_to_do) {                                               \
+        int lead = _mm_tzcnt_32((int)still_to_do);                      \
+        uint32_t lo = ((uint32_t *)&ptrs.v_lo)[lead];                   \
+        uint32_t hi = ((uint32_t *)&ptrs.v_hi)[lead];                   \
+        __vec16_i1 match = _mm512_mask_cmp_epi32_mask(still_to_do, ptrs.v_lo, \
+                                                      _mm512_set1_epi32(lo), \
+                                                      _MM_CMPINT_EQ);   \
+        match = _mm512_mask_cmp_epi32_mask(match, ptrs.v_hi,            \
+                                           _mm512_set1_epi32(hi),       \
+                                           _MM_CMPINT_EQ);              \
+        uint32_t old = NAME((uint32_t *)(((uint64_t)hi << 32) | lo),    \
+                            (uint32_t)REDUCE(match, val));              \
+        for (int m = match; m != 0; m &= m - 1) {                       \
+            int i = _mm_tzcnt_32(m);                                    \
+            ((uint32_t *)&ret)[i] = old;                                \
+            old = old STEP ((uint32_t *)&val)[i];                       \
+        }                                                               \
+        still_to_do = _mm512_kxor(match, still_to_do);                  \
+    }                                                                   \
+    return ret;                                                         \
+}
+
+ATOMIC_VARYING_I32(__atomic_add, _mm512_mask_reduce_add_epi32, +)
+ATOMIC_VARYING_I32(__atomic_sub, _mm512_mask_reduce_add_epi32, -)
+ATOMIC_VARYING_I32(__atomic_and, _mm512_mask_reduce_and_epi32, &)
+ATOMIC_VARYING_I32(__atomic_or,  _mm512_mask_reduce_or_epi32,  |)
+ATOMIC_VARYING_I32(__atomic_xor, lMaskReduceXor,               ^)
+
 #undef FORCEINLINE
 #undef PRE_ALIGN
 #undef POST_ALIGN
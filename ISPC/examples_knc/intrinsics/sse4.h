@@ -3645,47 +3645,104 @@ static FORCEINLINE void __scatter64_double(__vec4_i64 ptrs, __vec4_d val,
 ///////////////////////////////////////////////////////////////////////////
 // packed load/store
 
-static FORCEINLINE int32_t __packed_load_active(int32_t *ptr, __vec4_i32 *val,
-                                                __vec4_i1 mask) {
-    int count = 0;
-    uint32_t m = _mm_extract_ps(mask.v, 0);
-    if (m != 0)
-        val->v = _mm_insert_epi32(val->v, ptr[count++], 0);
-
-    m = _mm_extract_ps(mask.v, 1);
-    if (m != 0)
-        val->v = _mm_insert_epi32(val->v, ptr[count++], 1);
-
-    m = _mm_extract_ps(mask.v, 2);
-    if (m != 0)
-        val->v = _mm_insert_epi32(val->v, ptr[count++], 2);
+// pshufb controls indexed by the 4-bit movmsk of the execution mask.
+// lPackedStoreShuffle moves the active lanes down to the bottom of the
+// register; lPackedLoadShuffle spreads consecutive elements back out to
+// the active lanes.  -1 bytes (high bit set) are zeroed by pshufb.
+static const int8_t lPackedStoreShuffle[16][16] = {
+    { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 1, 2, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 4, 5, 6, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 1, 2, 3, 4, 5, 6, 7, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 8, 9, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 1, 2, 3, 8, 9, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 4, 5, 6, 7, 8, 9, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, -1, -1, -1, -1 },
+    { 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 1, 2, 3, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 4, 5, 6, 7, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 1, 2, 3, 4, 5, 6, 7, 12, 13, 14, 15, -1, -1, -1, -1 },
+    { 8, 9, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 1, 2, 3, 8, 9, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1 },
+    { 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1 },
+    { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+};
 
-    m = _mm_extract_ps(mask.v, 3);
-    if (m != 0)
-        val->v = _mm_insert_epi32(val->v, ptr[count++], 3);
+static const int8_t lPackedLoadShuffle[16][16] = {
+    { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 1, 2, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { -1, -1, -1, -1, 0, 1, 2, 3, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { 0, 1, 2, 3, 4, 5, 6, 7, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { -1, -1, -1, -1, -1, -1, -1, -1, 0, 1, 2, 3, -1, -1, -1, -1 },
+    { 0, 1, 2, 3, -1, -1, -1, -1, 4, 5, 6, 7, -1, -1, -1, -1 },
+    { -1, -1, -1, -1, 0, 1, 2, 3, 4, 5, 6, 7, -1, -1, -1, -1 },
+    { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, -1, -1, -1, -1 },
+    { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 1, 2, 3 },
+    { 0, 1, 2, 3, -1, -1, -1, -1, -1, -1, -1, -1, 4, 5, 6, 7 },
+    { -1, -1, -1, -1, 0, 1, 2, 3, -1, -1, -1, -1, 4, 5, 6, 7 },
+    { 0, 1, 2, 3, 4, 5, 6, 7, -1, -1, -1, -1, 8, 9, 10, 11 },
+    { -1, -1, -1, -1, -1, -1, -1, -1, 0, 1, 2, 3, 4, 5, 6, 7 },
+    { 0, 1, 2, 3, -1, -1, -1, -1, 4, 5, 6, 7, 8, 9, 10, 11 },
+    { -1, -1, -1, -1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 },
+    { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+};
 
+static FORCEINLINE int32_t __packed_load_active(int32_t *ptr, __vec4_i32 *val,
+                                                __vec4_i1 mask) {
+    int m = _mm_movemask_ps(mask.v);
+    int count = _mm_popcnt_u32(m);
+
+    // Only touch the count elements that are actually there.
+    __m128i packed;
+    switch (count) {
+    case 0:
+        return 0;
+    case 1:
+        packed = _mm_cvtsi32_si128(ptr[0]);
+        break;
+    case 2:
+        packed = _mm_loadl_epi64((__m128i *)ptr);
+        break;
+    case 3:
+        packed = _mm_insert_epi32(_mm_loadl_epi64((__m128i *)ptr), ptr[2], 2);
+        break;
+    default:
+        packed = _mm_loadu_si128((__m128i *)ptr);
+        break;
+    }
+
+    __m128i shuf = _mm_loadu_si128((__m128i *)lPackedLoadShuffle[m]);
+    __m128i expanded = _mm_shuffle_epi8(packed, shuf);
+    val->v = _mm_blendv_epi8(val->v, expanded, _mm_castps_si128(mask.v));
     return count;
 }
 
 static FORCEINLINE int32_t __packed_store_active(int32_t *ptr, __vec4_i32 val,
                                                  __vec4_i1 mask) {
-    int count = 0;
-    uint32_t m = _mm_extract_ps(mask.v, 0);
-    if (m != 0)
-        ptr[count++] = _mm_extract_epi32(val.v, 0);
-
-    m = _mm_extract_ps(mask.v, 1);
-    if (m != 0)
-        ptr[count++] = _mm_extract_epi32(val.v, 1);
-
-    m = _mm_extract_ps(mask.v, 2);
-    if (m != 0)
-        ptr[count++] = _mm_extract_epi32(val.v, 2);
-
-    m = _mm_extract_ps(mask.v, 3);
-    if (m != 0)
-        ptr[count++] = _mm_extract_epi32(val.v, 3);
-
+    int m = _mm_movemask_ps(mask.v);
+    int count = _mm_popcnt_u32(m);
+
+    __m128i shuf = _mm_loadu_si128((__m128i *)lPackedStoreShuffle[m]);
+    __m128i packed = _mm_shuffle_epi8(val.v, shuf);
+
+    // Don't write past the count elements we own.
+    switch (count) {
+    case 0:
+        break;
+    case 1:
+        ptr[0] = _mm_cvtsi128_si32(packed);
+        break;
+    case 2:
+        _mm_storel_epi64((__m128i *)ptr, packed);
+        break;
+    case 3:
+        _mm_storel_epi64((__m128i *)ptr, packed);
+        ptr[2] = _mm_extract_epi32(packed, 2);
+        break;
+    default:
+        _mm_storeu_si128((__m128i *)ptr, packed);
+        break;
+    }
     return count;
 }
 
@@ -3763,6 +3820,55 @@ static FORCEINLINE void __prefetch_read_uniform_nt(unsigned char *ptr) {
     _mm_prefetch((char *)ptr, _MM_HINT_NTA);
 }
 
+///////////////////////////////////////////////////////////////////////////
+// streaming stores
+
+// Non-temporal stores for write-once outputs, so they go to memory without
+// evicting the working set.  A full mask to a 16-byte aligned address uses
+// movntps/movntdq; partial masks use maskmovdqu, which is non-temporal as
+// well.  Issue __streaming_store_fence() before the data is consumed by
+// another thread.
+
+static FORCEINLINE void __streaming_store_i32(void *p, __vec4_i32 val,
+                                              __vec4_i1 mask) {
+    if (__all(mask) && ((uintptr_t)p & 15) == 0)
+        _mm_stream_si128((__m128i *)p, val.v);
+    else
+        _mm_maskmoveu_si128(val.v, _mm_castps_si128(mask.v), (char *)p);
+}
+
+static FORCEINLINE void __streaming_store_float(void *p, __vec4_f val,
+                                                __vec4_i1 mask) {
+    if (__all(mask) && ((uintptr_t)p & 15) == 0)
+        _mm_stream_ps((float *)p, val.v);
+    else
+        _mm_maskmoveu_si128(_mm_castps_si128(val.v), _mm_castps_si128(mask.v),
+                            (char *)p);
+}
+
+static FORCEINLINE void __streaming_store_i64(void *p, __vec4_i64 val,
+                                              __vec4_i1 mask) {
+    if (__all(mask) && ((uintptr_t)p & 15) == 0) {
+        _mm_stream_si128((__m128i *)p, val.v[0]);
+        _mm_stream_si128((__m128i *)p + 1, val.v[1]);
+    }
+    else {
+        // widen the 32-bit lane mask to cover each 64-bit element
+        __m128i m = _mm_castps_si128(mask.v);
+        _mm_maskmoveu_si128(val.v[0], _mm_unpacklo_epi32(m, m), (char *)p);
+        _mm_maskmoveu_si128(val.v[1], _mm_unpackhi_epi32(m, m), (char *)p + 16);
+    }
+}
+
+static FORCEINLINE void __streaming_store_double(void *p, __vec4_d val,
+                                                 __vec4_i1 mask) {
+    __streaming_store_i64(p, __vec4_i64(val), mask);
+}
+
+static FORCEINLINE void __streaming_store_fence() {
+    _mm_sfence();
+}
+
 ///////////////////////////////////////////////////////////////////////////
 // atomics
 
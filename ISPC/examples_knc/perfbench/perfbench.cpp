@@ -39,6 +39,7 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <algorithm>
 #include "../timing.h"
 
@@ -56,6 +57,13 @@ struct PerfTest {
 
 extern void xyzSumAOS(float *a, int count, float *zeros, float *result);
 extern void xyzSumSOA(float *a, int count, float *zeros, float *result);
+extern void cachedStores(float *a, int count, float *zeros, float *result);
+extern void streamingStores(float *a, int count, float *zeros, float *result);
+extern int packedStoreActive(float *a, int count, float density, int *result);
+extern void histogram(int *keys, int count, int *hist);
+extern void rankKeys(int *keys, int count, int *hist, int *rank);
+extern void rankKeysOffsets(int *keys, int count, int *hist, int *rank);
+extern void rankKeysPointers(int *keys, int count, int *hist, int *rank);
 
 
 static void
@@ -64,6 +72,13 @@ lInitData(float *ptr, int count) {
         ptr[i] = float(i) / (1024.f * 1024.f);
 }
 
+static void
+lInitRandom(float *ptr, int count) {
+    srand(1);
+    for (int i = 0; i < count; ++i)
+        ptr[i] = float(rand()) / (float(RAND_MAX) + 1.f);
+}
+
 static PerfTest tests[] = { 
     { xyzSumAOS, "serial", ispc::xyzSumAOS, "ispc", "AOS vector element sum (with coalescing)" },
     { xyzSumAOS, "serial", ispc::xyzSumAOSStdlib, "ispc", "AOS vector element sum (stdlib swizzle)" },
@@ -73,24 +88,29 @@ static PerfTest tests[] = {
     { ispc::scatters, "scatter", ispc::stores, "vector store", "Memory writes" },
 };
 
-int main() {
-    int count = 3*64*1024;
-    float *a = new float[count];
+// These run over a buffer much larger than the caches, so they measure
+// memory bandwidth rather than the cost of individual accesses.
+static PerfTest bandwidthTests[] = {
+    { ispc::loads, "vector load", ispc::prefetchLoads, "prefetched load", "Streaming reads (64 MB)" },
+    { cachedStores, "cached store", streamingStores, "streaming store", "Write-once stores (64 MB)" },
+};
+
+static void
+lRunTests(PerfTest *tests, int nTests, float *a, int count, int iterations) {
     float zeros[32] = { 0 };
 
-    int nTests = sizeof(tests) / sizeof(tests[0]);
     for (int i = 0; i < nTests; ++i) {
         lInitData(a, count);
         reset_and_start_timer();
         float resultA[3] = { 0, 0, 0 };
-        for (int j = 0; j < 100; ++j)
+        for (int j = 0; j < iterations; ++j)
             tests[i].aFunc(a, count, zeros, resultA);
         double aTime = get_elapsed_mcycles();
 
         lInitData(a, count);
         reset_and_start_timer();
         float resultB[3] = { 0, 0, 0 };
-        for (int j = 0; j < 100; ++j)
+        for (int j = 0; j < iterations; ++j)
             tests[i].bFunc(a, count, zeros, resultB);
         double bTime = get_elapsed_mcycles();
 
@@ -102,6 +122,134 @@ int main() {
                resultSerial[2], resultISPC[0], resultISPC[1], resultISPC[2]);
 #endif
     }
+}
+
+int main() {
+    int count = 3*64*1024;
+    float *a = new float[count];
+
+    lRunTests(tests, sizeof(tests) / sizeof(tests[0]), a, count, 100);
+
+    int bigCount = 16*1024*1024;
+    float *big = new float[bigCount];
+    lRunTests(bandwidthTests, sizeof(bandwidthTests) / sizeof(bandwidthTests[0]),
+              big, bigCount, 10);
+    delete[] big;
+
+    // Stream compaction (packed_store_active) at varying mask densities
+    int *indices = new int[count];
+    float densities[] = { 0.05f, 0.25f, 0.5f, 0.75f, 1.f };
+    int nDensities = sizeof(densities) / sizeof(densities[0]);
+    lInitRandom(a, count);
+    for (int i = 0; i < nDensities; ++i) {
+        reset_and_start_timer();
+        int numA = 0;
+        for (int j = 0; j < 100; ++j)
+            numA = packedStoreActive(a, count, densities[i], indices);
+        double aTime = get_elapsed_mcycles();
+
+        reset_and_start_timer();
+        int numB = 0;
+        for (int j = 0; j < 100; ++j)
+            numB = ispc::packedStoreActive(a, count, densities[i], indices);
+        double bTime = get_elapsed_mcycles();
+
+        char testName[64];
+        sprintf(testName, "Packed store (%d%% active)", int(100.f * densities[i]));
+        printf("%-40s: [%.2f] M cycles %s, [%.2f] M cycles %s (%.2fx speedup).\n",
+               testName, aTime, "serial", bTime, "ispc", aTime/bTime);
+        if (numA != numB)
+            printf("\t*** mismatch: %d serial vs. %d ispc elements\n", numA, numB);
+    }
+    delete[] indices;
+
+    // Histogram-style atomics: per-lane vs. combined-per-bin updates, with
+    // every lane fighting over a few bins and with bins rarely shared.
+    int *keys = new int[count];
+    int binCounts[] = { 4, 64*1024 };
+    int nBinCounts = sizeof(binCounts) / sizeof(binCounts[0]);
+    int *histA = new int[binCounts[nBinCounts-1]];
+    int *histB = new int[binCounts[nBinCounts-1]];
+    int *histRef = new int[binCounts[nBinCounts-1]];
+    int *rankA = new int[count];
+    int *rankB = new int[count];
+    int *rankRef = new int[count];
+    for (int i = 0; i < nBinCounts; ++i) {
+        int nBins = binCounts[i];
+        srand(1);
+        for (int j = 0; j < count; ++j)
+            keys[j] = rand() % nBins;
+        std::fill(histA, histA + nBins, 0);
+        std::fill(histB, histB + nBins, 0);
+        std::fill(histRef, histRef + nBins, 0);
+        histogram(keys, count, histRef);
+
+        reset_and_start_timer();
+        for (int j = 0; j < 100; ++j)
+            ispc::histogramAtomic(keys, count, histA);
+        double aTime = get_elapsed_mcycles();
+
+        reset_and_start_timer();
+        for (int j = 0; j < 100; ++j)
+            ispc::histogramUnique(keys, count, histB);
+        double bTime = get_elapsed_mcycles();
+
+        char testName[64];
+        sprintf(testName, "Histogram atomics (%d bins)", nBins);
+        printf("%-40s: [%.2f] M cycles %s, [%.2f] M cycles %s (%.2fx speedup).\n",
+               testName, aTime, "per-lane", bTime, "per-bin", aTime/bTime);
+        for (int j = 0; j < nBins; ++j)
+            if (histA[j] != 100 * histRef[j] || histB[j] != 100 * histRef[j]) {
+                printf("\t*** mismatch in bin %d: %d per-lane, %d per-bin, "
+                       "%d expected\n", j, histA[j], histB[j], 100 * histRef[j]);
+                break;
+            }
+
+        // The intrinsics headers' varying atomics, whose returned old
+        // values must match the serial loop's lane by lane
+        std::fill(histRef, histRef + nBins, 0);
+        reset_and_start_timer();
+        for (int j = 0; j < 100; ++j)
+            rankKeys(keys, count, histRef, rankRef);
+        double refTime = get_elapsed_mcycles();
+
+        std::fill(histA, histA + nBins, 0);
+        reset_and_start_timer();
+        for (int j = 0; j < 100; ++j)
+            rankKeysOffsets(keys, count, histA, rankA);
+        aTime = get_elapsed_mcycles();
+
+        std::fill(histB, histB + nBins, 0);
+        reset_and_start_timer();
+        for (int j = 0; j < 100; ++j)
+            rankKeysPointers(keys, count, histB, rankB);
+        bTime = get_elapsed_mcycles();
+
+        sprintf(testName, "Varying atomic rank (%d bins)", nBins);
+        printf("%-40s: [%.2f] M cycles %s, [%.2f] M cycles %s (%.2fx speedup).\n",
+               testName, refTime, "serial", aTime, "offsets", refTime/aTime);
+        printf("%-40s: [%.2f] M cycles %s, [%.2f] M cycles %s (%.2fx speedup).\n",
+               "", refTime, "serial", bTime, "pointers", refTime/bTime);
+        for (int j = 0; j < count; ++j)
+            if (rankA[j] != rankRef[j] || rankB[j] != rankRef[j]) {
+                printf("\t*** mismatch at key %d: %d offsets, %d pointers, "
+                       "%d expected\n", j, rankA[j], rankB[j], rankRef[j]);
+                break;
+            }
+        for (int j = 0; j < nBins; ++j)
+            if (histA[j] != histRef[j] || histB[j] != histRef[j]) {
+                printf("\t*** mismatch in bin %d: %d offsets, %d pointers, "
+                       "%d expected\n", j, histA[j], histB[j], histRef[j]);
+                break;
+            }
+    }
+    delete[] rankRef;
+    delete[] rankB;
+    delete[] rankA;
+    delete[] histRef;
+    delete[] histB;
+    delete[] histA;
+    delete[] keys;
 
     return 0;
 }
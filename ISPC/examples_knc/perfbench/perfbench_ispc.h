@@ -22,9 +22,13 @@ namespace ispc { /* namespace */
 extern "C" {
 #endif // __cplusplus
     extern void gathers(float * array, int32_t count, float * zeros, float * result);
+    extern void histogramAtomic(int32_t * keys, int32_t count, int32_t * hist);
+    extern void histogramUnique(int32_t * keys, int32_t count, int32_t * hist);
     extern void loads(float * array, int32_t count, float * zeros, float * result);
     extern void normalizeAOSNoCoalesce(float * array, int32_t count, float * zeroArray);
     extern void normalizeSOA(float * array, int32_t count, float * zeros);
+    extern int32_t packedStoreActive(float * array, int32_t count, float density, int32_t * result);
+    extern void prefetchLoads(float * array, int32_t count, float * zeros, float * result);
     extern void scatters(float * array, int32_t count, float * zeros, float * result);
     extern void stores(float * array, int32_t count, float * zeros, float * result);
     extern void xyzSumAOS(float * array, int32_t count, float * zeros, float * result);
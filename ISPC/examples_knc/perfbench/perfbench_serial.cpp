@@ -32,6 +32,12 @@
 */
 
 #include <math.h>
+#include <stdint.h>
+#ifdef __MIC__
+#include "../intrinsics/knc.h"
+#else
+#include "../intrinsics/generic-16.h"
+#endif
 
 void
 xyzSumAOS(float *a, int count, float *zeros, float *result) {
@@ -59,3 +65,85 @@ xyzSumSOA(float *a, int count, float *zeros, float *result) {
     result[1] = ysum;
     result[2] = zsum;
 }
+
+void
+cachedStores(float *a, int count, float *zeros, float *result) {
+    for (int i = 0; i < count; ++i)
+        a[i] = zeros[0];
+}
+
+// The same stores through the intrinsics headers' __streaming_store_float,
+// 16 lanes at a time from a 64-byte boundary, with a partial mask for the
+// tail.
+void
+streamingStores(float *a, int count, float *zeros, float *result) {
+    __vec16_f z = __smear_float<__vec16_f>(zeros[0]);
+    __vec16_i1 all = __smear_i1<__vec16_i1>(-1);
+    int i = 0;
+    for (; i < count && ((uintptr_t)(a + i) & 63) != 0; ++i)
+        a[i] = zeros[0];
+    for (; i + 16 <= count; i += 16)
+        __streaming_store_float(a + i, z, all);
+    if (i < count)
+        __streaming_store_float(a + i, z, __vec16_i1((uint16_t)((1 << (count - i)) - 1)));
+    __streaming_store_fence();
+}
+
+int
+packedStoreActive(float *a, int count, float density, int *result) {
+    int numActive = 0;
+    for (int i = 0; i < count; ++i)
+        if (a[i] < density)
+            result[numActive++] = i;
+    return numActive;
+}
+
+void
+histogram(int *keys, int count, int *hist) {
+    for (int i = 0; i < count; ++i)
+        ++hist[keys[i]];
+}
+
+// rank[i] = hist[keys[i]]++: each key's position among the equal keys
+// before it, as a counting sort needs.
+void
+rankKeys(int *keys, int count, int *hist, int *rank) {
+    for (int i = 0; i < count; ++i)
+        rank[i] = hist[keys[i]]++;
+}
+
+// The same with the intrinsics headers' varying atomics, 16 keys at a
+// time: the old values they return are the ranks, since lanes that share
+// a bin see each other's increments in lane order.  The base/offsets form
+// takes the keys as offsets from hist; the 64 form takes a pointer per
+// lane.
+void
+rankKeysOffsets(int *keys, int count, int *hist, int *rank) {
+    __vec16_i32 one = __smear_i32<__vec16_i32>(1);
+    __vec16_i1 all = __smear_i1<__vec16_i1>(-1);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __vec16_i32 k = __load<4>((const __vec16_i32 *)(keys + i));
+        __store<4>((__vec16_i32 *)(rank + i),
+                   __atomic_add_base_offsets32_i32((uint8_t *)hist, sizeof(int),
+                                                   k, one, all));
+    }
+    for (; i < count; ++i)
+        rank[i] = hist[keys[i]]++;
+}
+
+void
+rankKeysPointers(int *keys, int count, int *hist, int *rank) {
+    __vec16_i32 one = __smear_i32<__vec16_i32>(1);
+    __vec16_i1 all = __smear_i1<__vec16_i1>(-1);
+    __vec16_i64 base = __smear_i64<__vec16_i64>((int64_t)(intptr_t)hist);
+    __vec16_i64 two = __smear_i64<__vec16_i64>(2);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __vec16_i32 k = __load<4>((const __vec16_i32 *)(keys + i));
+        __vec16_i64 ptrs = __add(base, __shl(__cast_sext(__vec16_i64(), k), two));
+        __store<4>((__vec16_i32 *)(rank + i), __atomic_add64_i32(ptrs, one, all));
+    }
+    for (; i < count; ++i)
+        rank[i] = hist[keys[i]]++;
+}
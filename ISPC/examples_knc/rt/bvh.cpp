@@ -0,0 +1,730 @@
+/*
+  Copyright (c) 2010-2011, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#define NOMINMAX
+#pragma warning (disable: 4244)
+#pragma warning (disable: 4305)
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <algorithm>
+#include <xmmintrin.h>
+#include "bvh.h"
+
+using namespace ispc;
+
+// The ispc task system entrypoints (tasksys.cpp); subtrees and the binning
+// of the top levels are launched as tasks the way ispc-generated code does,
+// with the argument block taken from ISPCAlloc so that it belongs to the
+// launch's task group.
+extern "C" {
+    void *ISPCAlloc(void **handlePtr, int64_t size, int32_t alignment);
+    void ISPCLaunch(void **handlePtr, void *f, void *data, int count);
+    void ISPCSync(void *handle);
+}
+
+// SAH cost of a traversal step, relative to one ray-triangle test
+#define TRAVERSAL_COST 0.125f
+
+#define N_BINS 16
+
+// Leaves with at most this many triangles are kept when no split is cheaper
+#define MAX_PRIMS_IN_NODE 4
+
+// nPrimitives is 8 bits
+#define MAX_LEAF_PRIMS 255
+
+// No leaf is deeper than this, so the 64-entry todo stacks of BVHIntersect
+// and the per-lane traversal (and the 64-level WIDE_TODO_SIZE) suffice.
+#define MAX_DEPTH 63
+
+// Ranges this small are built serially, one task per subtree
+#define SUBTREE_TASK_PRIMS 8192
+
+// Ranges this large are binned by several tasks
+#define PARALLEL_BIN_PRIMS 65536
+#define BIN_CHUNK_PRIMS 16384
+
+
+///////////////////////////////////////////////////////////////////////////
+// Triangle soup input
+
+static bool loadObj(const char *filename, std::vector<float> &soup) {
+    FILE *f = fopen(filename, "r");
+    if (!f) {
+        perror(filename);
+        return false;
+    }
+
+    std::vector<float> verts;
+    std::vector<int> face;
+    char line[4096];
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == 'v' && line[1] == ' ') {
+            float v[3];
+            if (sscanf(line + 2, "%f %f %f", &v[0], &v[1], &v[2]) != 3) {
+                fprintf(stderr, "%s: bad vertex \"%s\"\n", filename, line);
+                fclose(f);
+                return false;
+            }
+            verts.insert(verts.end(), v, v + 3);
+        }
+        else if (line[0] == 'f' && line[1] == ' ') {
+            // Vertex references are "v", "v/t", "v//n" or "v/t/n", 1-based
+            // or negative (relative to the end)
+            face.clear();
+            char *p = line + 2;
+            while (true) {
+                char *end;
+                long index = strtol(p, &end, 10);
+                if (end == p)
+                    break;
+                int nVerts = int(verts.size() / 3);
+                index = (index < 0) ? nVerts + index : index - 1;
+                if (index < 0 || index >= nVerts) {
+                    fprintf(stderr, "%s: bad face \"%s\"\n", filename, line);
+                    fclose(f);
+                    return false;
+                }
+                face.push_back(int(index));
+                p = end;
+                while (*p != '\0' && *p != ' ' && *p != '\t')
+                    ++p;
+            }
+            for (size_t i = 2; i < face.size(); ++i) {
+                soup.insert(soup.end(), &verts[3*face[0]], &verts[3*face[0]] + 3);
+                soup.insert(soup.end(), &verts[3*face[i-1]], &verts[3*face[i-1]] + 3);
+                soup.insert(soup.end(), &verts[3*face[i]], &verts[3*face[i]] + 3);
+            }
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+
+bool loadTriangleSoup(const char *filename, std::vector<float> &soup) {
+    size_t len = strlen(filename);
+    if (len >= 4 && strcmp(filename + len - 4, ".obj") == 0)
+        return loadObj(filename, soup);
+
+    FILE *f = fopen(filename, "rb");
+    if (!f) {
+        perror(filename);
+        return false;
+    }
+    float v[9];
+    size_t n;
+    while ((n = fread(v, sizeof(float), 9, f)) == 9)
+        soup.insert(soup.end(), v, v + 9);
+    fclose(f);
+    if (n != 0) {
+        fprintf(stderr, "%s: size is not a multiple of 9 floats\n", filename);
+        return false;
+    }
+    return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+// Binned SAH build
+
+struct Bounds {
+    float lo[3], hi[3];
+
+    void reset() {
+        lo[0] = lo[1] = lo[2] = FLT_MAX;
+        hi[0] = hi[1] = hi[2] = -FLT_MAX;
+    }
+    void grow(const float p[3]) {
+        for (int a = 0; a < 3; ++a) {
+            lo[a] = std::min(lo[a], p[a]);
+            hi[a] = std::max(hi[a], p[a]);
+        }
+    }
+    void grow(const Bounds &b) {
+        for (int a = 0; a < 3; ++a) {
+            lo[a] = std::min(lo[a], b.lo[a]);
+            hi[a] = std::max(hi[a], b.hi[a]);
+        }
+    }
+    float area() const {
+        if (lo[0] > hi[0])
+            return 0.f;
+        float dx = hi[0] - lo[0], dy = hi[1] - lo[1], dz = hi[2] - lo[2];
+        return 2.f * (dx * dy + dy * dz + dz * dx);
+    }
+};
+
+struct BuildPrim {
+    Bounds bounds;
+    float centroid[3];
+    int index;          // into the soup
+};
+
+// A range of prims, with the bounds of their boxes and of their centroids
+struct BuildRange {
+    int start, end;
+    Bounds bounds, centroids;
+};
+
+struct Bin {
+    Bounds bounds, centroids;
+    int count;
+
+    void reset() {
+        bounds.reset();
+        centroids.reset();
+        count = 0;
+    }
+    void grow(const Bin &b) {
+        bounds.grow(b.bounds);
+        centroids.grow(b.centroids);
+        count += b.count;
+    }
+};
+
+struct AxisBins {
+    Bin bins[3][N_BINS];
+};
+
+static inline int binIndex(const BuildPrim &prim, int axis, const Bounds &centroids,
+                           const float scale[3]) {
+    int b = int((prim.centroid[axis] - centroids.lo[axis]) * scale[axis]);
+    return std::min(b, N_BINS - 1);
+}
+
+static void binScale(const Bounds &centroids, float scale[3]) {
+    for (int a = 0; a < 3; ++a) {
+        float extent = centroids.hi[a] - centroids.lo[a];
+        scale[a] = (extent > 0.f) ? N_BINS / extent : 0.f;
+    }
+}
+
+static void binPrims(const BuildPrim *prims, int start, int end,
+                     const Bounds &centroids, AxisBins &bins) {
+    float scale[3];
+    binScale(centroids, scale);
+    for (int a = 0; a < 3; ++a)
+        for (int b = 0; b < N_BINS; ++b)
+            bins.bins[a][b].reset();
+    for (int i = start; i < end; ++i)
+        for (int a = 0; a < 3; ++a) {
+            Bin &bin = bins.bins[a][binIndex(prims[i], a, centroids, scale)];
+            bin.bounds.grow(prims[i].bounds);
+            bin.centroids.grow(prims[i].centroid);
+            ++bin.count;
+        }
+}
+
+struct BinTaskData {
+    const BuildPrim *prims;
+    const BuildRange *range;
+    int chunkSize;
+    AxisBins *chunkBins;
+};
+
+static void binChunkTask(void *data, int threadIndex, int threadCount,
+                         int taskIndex, int taskCount) {
+    BinTaskData *td = (BinTaskData *)data;
+    int start = td->range->start + taskIndex * td->chunkSize;
+    int end = std::min(start + td->chunkSize, td->range->end);
+    binPrims(td->prims, start, end, td->range->centroids,
+             td->chunkBins[taskIndex]);
+}
+
+// Bins a large range in chunks, one task each, and merges the chunks' bins
+static void binPrimsParallel(const BuildPrim *prims, const BuildRange &range,
+                             AxisBins &bins) {
+    int nChunks = (range.end - range.start + BIN_CHUNK_PRIMS - 1) / BIN_CHUNK_PRIMS;
+    std::vector<AxisBins> chunkBins(nChunks);
+    BinTaskData td = { prims, &range, BIN_CHUNK_PRIMS, &chunkBins[0] };
+    void *handle = NULL;
+    BinTaskData *args = (BinTaskData *)ISPCAlloc(&handle, sizeof(td), 64);
+    *args = td;
+    ISPCLaunch(&handle, (void *)binChunkTask, args, nChunks);
+    ISPCSync(handle);
+
+    for (int a = 0; a < 3; ++a)
+        for (int b = 0; b < N_BINS; ++b) {
+            bins.bins[a][b] = chunkBins[0].bins[a][b];
+            for (int c = 1; c < nChunks; ++c)
+                bins.bins[a][b].grow(chunkBins[c].bins[a][b]);
+        }
+}
+
+struct Split {
+    int axis, bin;      // bins [0, bin] go left
+    Bin left, right;
+};
+
+// Chooses the cheapest binned SAH split of the range; returns false if a
+// leaf is better or the centroids can't be told apart.
+static bool findSplit(const BuildPrim *prims, const BuildRange &range,
+                      bool parallel, Split &split) {
+    int nPrims = range.end - range.start;
+    if (nPrims == 1)
+        return false;
+
+    AxisBins bins;
+    if (parallel && nPrims >= PARALLEL_BIN_PRIMS)
+        binPrimsParallel(prims, range, bins);
+    else
+        binPrims(prims, range.start, range.end, range.centroids, bins);
+
+    float bestCost = FLT_MAX;
+    float invArea = 1.f / std::max(range.bounds.area(), FLT_MIN);
+    for (int a = 0; a < 3; ++a) {
+        if (range.centroids.hi[a] <= range.centroids.lo[a])
+            continue;
+
+        // Sweep from the right to get the cost of each right side, then
+        // from the left
+        float rightCost[N_BINS];
+        Bin right;
+        right.reset();
+        for (int b = N_BINS - 1; b > 0; --b) {
+            right.grow(bins.bins[a][b]);
+            rightCost[b - 1] = right.count * right.bounds.area();
+        }
+        Bin left;
+        left.reset();
+        for (int b = 0; b < N_BINS - 1; ++b) {
+            left.grow(bins.bins[a][b]);
+            if (left.count == 0 || left.count == nPrims)
+                continue;
+            float cost = TRAVERSAL_COST +
+                (left.count * left.bounds.area() + rightCost[b]) * invArea;
+            if (cost < bestCost) {
+                bestCost = cost;
+                split.axis = a;
+                split.bin = b;
+            }
+        }
+    }
+
+    if (bestCost == FLT_MAX)
+        return false;
+    if (nPrims <= MAX_PRIMS_IN_NODE && bestCost >= nPrims)
+        return false;
+
+    split.left.reset();
+    split.right.reset();
+    for (int b = 0; b < N_BINS; ++b)
+        (b <= split.bin ? split.left : split.right).grow(bins.bins[split.axis][b]);
+    return true;
+}
+
+static void rangeBounds(const BuildPrim *prims, BuildRange &range) {
+    range.bounds.reset();
+    range.centroids.reset();
+    for (int i = range.start; i < range.end; ++i) {
+        range.bounds.grow(prims[i].bounds);
+        range.centroids.grow(prims[i].centroid);
+    }
+}
+
+struct CentroidLess {
+    CentroidLess(int a) : axis(a) { }
+    bool operator()(const BuildPrim &a, const BuildPrim &b) const {
+        return a.centroid[axis] < b.centroid[axis];
+    }
+    int axis;
+};
+
+// Splits the range into left and right children.  With binSplit false (no
+// usable SAH split, or too deep) the range is cut in half by centroid order
+// along the widest axis.
+static int partitionRange(BuildPrim *prims, const BuildRange &range,
+                          bool binSplit, const Split &split,
+                          BuildRange &left, BuildRange &right) {
+    int axis;
+    if (binSplit) {
+        float scale[3];
+        binScale(range.centroids, scale);
+        axis = split.axis;
+        int i = range.start, j = range.end - 1;
+        while (i <= j) {
+            if (binIndex(prims[i], axis, range.centroids, scale) <= split.bin)
+                ++i;
+            else
+                std::swap(prims[i], prims[j--]);
+        }
+        left.start = range.start;
+        left.end = right.start = i;
+        right.end = range.end;
+        left.bounds = split.left.bounds;
+        left.centroids = split.left.centroids;
+        right.bounds = split.right.bounds;
+        right.centroids = split.right.centroids;
+    }
+    else {
+        axis = 0;
+        for (int a = 1; a < 3; ++a)
+            if (range.centroids.hi[a] - range.centroids.lo[a] >
+                range.centroids.hi[axis] - range.centroids.lo[axis])
+                axis = a;
+        int mid = (range.start + range.end) / 2;
+        std::nth_element(prims + range.start, prims + mid, prims + range.end,
+                         CentroidLess(axis));
+        left.start = range.start;
+        left.end = right.start = mid;
+        right.end = range.end;
+        rangeBounds(prims, left);
+        rangeBounds(prims, right);
+    }
+    return axis;
+}
+
+static int addNode(std::vector<LinearBVHNode> &nodes, const Bounds &b) {
+    LinearBVHNode node;
+    memset(&node, 0, sizeof(node));
+    for (int a = 0; a < 3; ++a) {
+        node.bounds[0][a] = b.lo[a];
+        node.bounds[1][a] = b.hi[a];
+    }
+    nodes.push_back(node);
+    return int(nodes.size()) - 1;
+}
+
+// Median splits needed before nPrims fit in a leaf
+static int medianLevels(int nPrims) {
+    int levels = 0;
+    for (; nPrims > MAX_LEAF_PRIMS; nPrims = (nPrims + 1) / 2)
+        ++levels;
+    return levels;
+}
+
+// Whether to make a leaf of the range, and if not how to split it.  SAH
+// splits are only taken while median splits below them could still reach
+// leaves by MAX_DEPTH; past that the range is halved, which keeps every
+// node within depth + medianLevels(nPrims) <= MAX_DEPTH, so a range at
+// MAX_DEPTH always fits in a leaf.
+static bool chooseSplit(const BuildPrim *prims, const BuildRange &range,
+                        int depth, bool parallel, bool &binSplit, Split &split) {
+    int nPrims = range.end - range.start;
+    if (depth + medianLevels(nPrims) < MAX_DEPTH) {
+        binSplit = findSplit(prims, range, parallel, split);
+        if (binSplit)
+            return true;
+        if (nPrims <= MAX_LEAF_PRIMS)
+            return false;
+    }
+    binSplit = false;
+    return depth < MAX_DEPTH && nPrims > MAX_PRIMS_IN_NODE;
+}
+
+static void buildRecursive(BuildPrim *prims, const BuildRange &range, int depth,
+                           std::vector<LinearBVHNode> &nodes) {
+    int index = addNode(nodes, range.bounds);
+    bool binSplit;
+    Split split;
+    if (!chooseSplit(prims, range, depth, false, binSplit, split)) {
+        nodes[index].offset = range.start;
+        nodes[index].nPrimitives = range.end - range.start;
+        return;
+    }
+
+    BuildRange left, right;
+    nodes[index].splitAxis = partitionRange(prims, range, binSplit, split,
+                                            left, right);
+    buildRecursive(prims, left, depth + 1, nodes);
+    nodes[index].offset = int(nodes.size());
+    buildRecursive(prims, right, depth + 1, nodes);
+}
+
+struct Subtree {
+    BuildRange range;
+    int depth;
+    int topNode;        // its placeholder in the top levels
+};
+
+// The levels above SUBTREE_TASK_PRIMS are built first, leaving placeholder
+// nodes for the subtrees under them.
+static void buildTop(BuildPrim *prims, const BuildRange &range, int depth,
+                     std::vector<LinearBVHNode> &nodes,
+                     std::vector<Subtree> &subtrees) {
+    int index = addNode(nodes, range.bounds);
+    if (range.end - range.start <= SUBTREE_TASK_PRIMS) {
+        Subtree subtree = { range, depth, index };
+        subtrees.push_back(subtree);
+        return;
+    }
+
+    bool binSplit;
+    Split split;
+    if (!chooseSplit(prims, range, depth, true, binSplit, split)) {
+        nodes[index].offset = range.start;
+        nodes[index].nPrimitives = range.end - range.start;
+        return;
+    }
+
+    BuildRange left, right;
+    nodes[index].splitAxis = partitionRange(prims, range, binSplit, split,
+                                            left, right);
+    buildTop(prims, left, depth + 1, nodes, subtrees);
+    nodes[index].offset = int(nodes.size());
+    buildTop(prims, right, depth + 1, nodes, subtrees);
+}
+
+struct SubtreeTaskData {
+    BuildPrim *prims;
+    const Subtree *subtrees;
+    std::vector<LinearBVHNode> *subtreeNodes;
+};
+
+static void buildSubtreeTask(void *data, int threadIndex, int threadCount,
+                             int taskIndex, int taskCount) {
+    SubtreeTaskData *td = (SubtreeTaskData *)data;
+    const Subtree &subtree = td->subtrees[taskIndex];
+    buildRecursive(td->prims, subtree.range, subtree.depth,
+                   td->subtreeNodes[taskIndex]);
+}
+
+// Lays the top levels out depth first again with each placeholder replaced
+// by its subtree.  Leaf offsets index the shared prim array and so are
+// already final; only interior offsets move.
+static void splice(const std::vector<LinearBVHNode> &top, int topIndex,
+                   const std::vector<int> &subtreeOf,
+                   const std::vector<LinearBVHNode> *subtreeNodes,
+                   std::vector<LinearBVHNode> &nodes) {
+    const LinearBVHNode &node = top[topIndex];
+    if (subtreeOf[topIndex] >= 0) {
+        const std::vector<LinearBVHNode> &sub = subtreeNodes[subtreeOf[topIndex]];
+        unsigned int base = nodes.size();
+        for (size_t i = 0; i < sub.size(); ++i) {
+            nodes.push_back(sub[i]);
+            if (sub[i].nPrimitives == 0)
+                nodes.back().offset += base;
+        }
+    }
+    else if (node.nPrimitives > 0)
+        nodes.push_back(node);
+    else {
+        int index = int(nodes.size());
+        nodes.push_back(node);
+        splice(top, topIndex + 1, subtreeOf, subtreeNodes, nodes);
+        nodes[index].offset = int(nodes.size());
+        splice(top, node.offset, subtreeOf, subtreeNodes, nodes);
+    }
+}
+
+
+void buildBVH(const float *soup, int nTris,
+              std::vector<LinearBVHNode> &nodes,
+              std::vector<Triangle> &triangles) {
+    nodes.clear();
+    triangles.clear();
+    if (nTris == 0)
+        return;
+
+    std::vector<BuildPrim> prims(nTris);
+    BuildRange root = { 0, nTris };
+    root.bounds.reset();
+    root.centroids.reset();
+    for (int i = 0; i < nTris; ++i) {
+        const float *v = soup + 9 * i;
+        BuildPrim &prim = prims[i];
+        prim.bounds.reset();
+        for (int j = 0; j < 3; ++j)
+            prim.bounds.grow(v + 3 * j);
+        for (int a = 0; a < 3; ++a)
+            prim.centroid[a] = .5f * (prim.bounds.lo[a] + prim.bounds.hi[a]);
+        prim.index = i;
+        root.bounds.grow(prim.bounds);
+        root.centroids.grow(prim.centroid);
+    }
+
+    std::vector<LinearBVHNode> top;
+    std::vector<Subtree> subtrees;
+    buildTop(&prims[0], root, 0, top, subtrees);
+
+    std::vector<std::vector<LinearBVHNode> > subtreeNodes(subtrees.size());
+    if (subtrees.size() > 0) {
+        SubtreeTaskData td = { &prims[0], &subtrees[0], &subtreeNodes[0] };
+        void *handle = NULL;
+        SubtreeTaskData *args =
+            (SubtreeTaskData *)ISPCAlloc(&handle, sizeof(td), 64);
+        *args = td;
+        ISPCLaunch(&handle, (void *)buildSubtreeTask, args,
+                   int(subtrees.size()));
+        ISPCSync(handle);
+    }
+
+    std::vector<int> subtreeOf(top.size(), -1);
+    size_t nNodes = top.size();
+    for (size_t i = 0; i < subtrees.size(); ++i) {
+        subtreeOf[subtrees[i].topNode] = int(i);
+        nNodes += subtreeNodes[i].size() - 1;
+    }
+    nodes.reserve(nNodes);
+    splice(top, 0, subtreeOf, &subtreeNodes[0], nodes);
+
+    triangles.resize(nTris);
+    for (int i = 0; i < nTris; ++i) {
+        const float *v = soup + 9 * prims[i].index;
+        Triangle &tri = triangles[i];
+        memset(&tri, 0, sizeof(tri));
+        for (int j = 0; j < 3; ++j)
+            for (int a = 0; a < 3; ++a)
+                tri.p[j][a] = v[3 * j + a];
+        tri.id = prims[i].index + 1;
+    }
+}
+
+
+void triangleVertsSoA(const Triangle triangles[], int nTris,
+                      std::vector<float> &verts) {
+    verts.resize(9 * size_t(nTris));
+    for (int v = 0; v < 3; ++v)
+        for (int a = 0; a < 3; ++a)
+            for (int i = 0; i < nTris; ++i)
+                verts[(3 * v + a) * size_t(nTris) + i] = triangles[i].p[v][a];
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+
+static float nodeArea(const LinearBVHNode &node) {
+    float dx = node.bounds[1][0] - node.bounds[0][0];
+    float dy = node.bounds[1][1] - node.bounds[0][1];
+    float dz = node.bounds[1][2] - node.bounds[0][2];
+    return 2.f * (dx * dy + dy * dz + dz * dx);
+}
+
+
+float bvhSAHCost(const LinearBVHNode nodes[]) {
+    // Walk the tree with an explicit stack, as BVHIntersect does
+    double cost = 0.;
+    int todo[64], todoOffset = 0, nodeNum = 0;
+    while (true) {
+        const LinearBVHNode &node = nodes[nodeNum];
+        if (node.nPrimitives > 0) {
+            cost += nodeArea(node) * node.nPrimitives;
+            if (todoOffset == 0)
+                break;
+            nodeNum = todo[--todoOffset];
+        }
+        else {
+            cost += nodeArea(node) * TRAVERSAL_COST;
+            todo[todoOffset++] = node.offset;
+            nodeNum = nodeNum + 1;
+        }
+    }
+    return float(cost / std::max(nodeArea(nodes[0]), FLT_MIN));
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+// Wide BVH
+
+WideBVH::~WideBVH() {
+    _mm_free(nodes);
+}
+
+
+static inline void setWord(std::vector<float> &words, size_t i, int32_t value) {
+    memcpy(&words[i], &value, sizeof(value));
+}
+
+
+static int collapseNode(const LinearBVHNode nodes[], int nodeNum, int width,
+                        std::vector<float> &words) {
+    int index = int(words.size() / (8 * width));
+    words.resize(words.size() + 8 * width, 0.f);
+
+    int children[8], nChildren = 0;
+    if (nodes[nodeNum].nPrimitives > 0)
+        children[nChildren++] = nodeNum;
+    else {
+        children[nChildren++] = nodeNum + 1;
+        children[nChildren++] = nodes[nodeNum].offset;
+    }
+    while (nChildren < width) {
+        int best = -1;
+        float bestArea = -1.f;
+        for (int i = 0; i < nChildren; ++i) {
+            const LinearBVHNode &child = nodes[children[i]];
+            if (child.nPrimitives == 0 && nodeArea(child) > bestArea) {
+                best = i;
+                bestArea = nodeArea(child);
+            }
+        }
+        if (best < 0)
+            break;
+        int open = children[best];
+        children[best] = open + 1;
+        children[nChildren++] = nodes[open].offset;
+    }
+
+    for (int c = 0; c < width; ++c) {
+        size_t base = size_t(index) * 8 * width;
+        if (c >= nChildren) {
+            setWord(words, base + 7 * width + c, -1);
+            continue;
+        }
+        const LinearBVHNode &child = nodes[children[c]];
+        for (int a = 0; a < 3; ++a) {
+            words[base + a * width + c] = child.bounds[0][a];
+            words[base + (3 + a) * width + c] = child.bounds[1][a];
+        }
+        if (child.nPrimitives > 0) {
+            setWord(words, base + 6 * width + c, child.offset);
+            setWord(words, base + 7 * width + c, child.nPrimitives);
+        }
+        else {
+            // words may move as the child's subtree is added
+            int childIndex = collapseNode(nodes, children[c], width, words);
+            setWord(words, base + 6 * width + c, childIndex);
+            setWord(words, base + 7 * width + c, 0);
+        }
+    }
+    return index;
+}
+
+
+void collapseBVH(const LinearBVHNode nodes[], int width, WideBVH &wide) {
+    std::vector<float> words;
+    collapseNode(nodes, 0, width, words);
+
+    _mm_free(wide.nodes);
+    wide.nodes = (float *)_mm_malloc(words.size() * sizeof(float), 64);
+    memcpy(wide.nodes, &words[0], words.size() * sizeof(float));
+    wide.nNodes = int(words.size() / (8 * width));
+    wide.width = width;
+}
@@ -0,0 +1,86 @@
+/*
+  Copyright (c) 2010-2011, Intel Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are
+  met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    * Neither the name of Intel Corporation nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+   TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+   OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef RT_BVH_H
+#define RT_BVH_H
+
+#include <stddef.h>
+#include <vector>
+#include "rt_ispc.h"
+
+// Reads a triangle soup, 9 floats (three xyz vertices) per triangle.  A
+// filename ending in .obj is parsed as Wavefront OBJ ("v" and "f" records,
+// with larger polygons split into fans); anything else is taken to be the
+// raw floats themselves.
+bool loadTriangleSoup(const char *filename, std::vector<float> &soup);
+
+// Builds a BVH over nTris triangles of the soup with binned SAH, in the
+// depth-first LinearBVHNode layout that BVHIntersect walks: an interior
+// node's first child follows it, and its offset is the second child.
+// Triangles are emitted in leaf order with id = soup index + 1.  Subtrees
+// are built in parallel with the ispc task system.
+void buildBVH(const float *soup, int nTris,
+              std::vector<ispc::LinearBVHNode> &nodes,
+              std::vector<ispc::Triangle> &triangles);
+
+// SAH cost of a BVH relative to its root box, with the cost constants the
+// builder uses, so prebuilt and built trees can be compared.
+float bvhSAHCost(const ispc::LinearBVHNode nodes[]);
+
+// The triangles' vertices SoA, as WatertightLeafIntersect in rt.ispc reads
+// them: component c (xyz of each vertex in turn) of triangle i is at
+// verts[c * nTris + i], so each BVH leaf is a contiguous run of every
+// component.
+void triangleVertsSoA(const ispc::Triangle triangles[], int nTris,
+                      std::vector<float> &verts);
+
+// A BVH collapsed to 4 or 8 children per node, in the SoA layout that
+// WideBVHIntersect in rt.ispc reads: 8 * width 32-bit words per node,
+// 64-byte aligned.
+struct WideBVH {
+    WideBVH() : nodes(NULL), nNodes(0), width(0) { }
+    ~WideBVH();
+
+    float *nodes;
+    int nNodes, width;
+
+private:
+    WideBVH(const WideBVH &);
+    WideBVH &operator=(const WideBVH &);
+};
+
+// Converts a binary BVH by repeatedly opening the largest interior child
+// of each node until it has width children; leaves become leaf children.
+void collapseBVH(const ispc::LinearBVHNode nodes[], int width, WideBVH &wide);
+
+#endif // RT_BVH_H
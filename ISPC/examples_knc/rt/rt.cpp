@@ -44,8 +44,10 @@
 #include <assert.h>
 #include <string.h>
 #include <sys/types.h>
+#include <vector>
 #include "../timing.h"
 #include "rt_ispc.h"
+#include "bvh.h"
 
 using namespace ispc;
 
@@ -95,27 +97,202 @@ static void writeImage(int *idImage, float *depthImage, int width, int height,
 }
 
 
+// A 512x512 view down -z onto the mesh's bounding sphere, for meshes that
+// don't come with a camera file
+static void meshCamera(const std::vector<float> &soup, int &baseWidth,
+                       int &baseHeight, float camera2world[4][4],
+                       float raster2camera[4][4]) {
+    float lo[3] = { 1e30f, 1e30f, 1e30f }, hi[3] = { -1e30f, -1e30f, -1e30f };
+    for (size_t i = 0; i < soup.size(); ++i) {
+        lo[i % 3] = std::min(lo[i % 3], soup[i]);
+        hi[i % 3] = std::max(hi[i % 3], soup[i]);
+    }
+    float radius = .5f * sqrtf((hi[0] - lo[0]) * (hi[0] - lo[0]) +
+                               (hi[1] - lo[1]) * (hi[1] - lo[1]) +
+                               (hi[2] - lo[2]) * (hi[2] - lo[2]));
+    float tanHalfFov = tanf(.39269908f);   // 22.5 degrees
+
+    baseWidth = baseHeight = 512;
+    memset(camera2world, 0, 16 * sizeof(float));
+    camera2world[0][0] = 1.f;
+    camera2world[1][1] = 1.f;
+    camera2world[2][2] = -1.f;
+    camera2world[0][3] = .5f * (lo[0] + hi[0]);
+    camera2world[1][3] = .5f * (lo[1] + hi[1]);
+    camera2world[2][3] = .5f * (lo[2] + hi[2]) + 1.1f * radius / tanHalfFov;
+    camera2world[3][3] = 1.f;
+
+    // Raster (x, y) to a point on the z = 1 plane, y up
+    float s = 2.f * tanHalfFov / baseHeight;
+    memset(raster2camera, 0, 16 * sizeof(float));
+    raster2camera[0][0] = s;
+    raster2camera[0][3] = -.5f * s * baseWidth;
+    raster2camera[1][1] = -s;
+    raster2camera[1][3] = .5f * s * baseHeight;
+    raster2camera[2][3] = 1.f;
+    raster2camera[3][3] = 1.f;
+}
+
+
+static inline unsigned int xorshift(unsigned int &state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+
+// The rays on which a second trace disagrees with the first: a different
+// triangle, or a hit distance off by more than tTolerance relative to the
+// first.  With a tolerance the triangle ids aren't compared, as the
+// watertight test may take the other triangle on an edge they share.
+static int countMismatches(int nRays, const float tHit0[], const int hitId0[],
+                           const float tHit1[], const int hitId1[],
+                           float tTolerance) {
+    int mismatches = 0;
+    for (int i = 0; i < nRays; ++i) {
+        if (fabsf(tHit1[i] - tHit0[i]) > tTolerance * tHit0[i] ||
+            (tTolerance == 0.f && hitId1[i] != hitId0[i]))
+            ++mismatches;
+    }
+    return mismatches;
+}
+
+
+//
+// Traces batches of width x height rays with trace_rays_ispc_tasks: in
+// packets, with one ray per lane, and with one ray per lane and the SoA
+// watertight leaf test.  The rays leave the camera through each pixel,
+// with directions blended toward uniformly random ones by a growing
+// spread, from coherent primary rays (0) to fully random (1).  The hits of
+// the two per-lane modes are checked against the packets'.
+//
+static void rayBenchmark(int width, int height, int baseWidth, int baseHeight,
+                         const float raster2camera[4][4],
+                         const float camera2world[4][4],
+                         const LinearBVHNode nodes[], const Triangle triangles[],
+                         int nTris) {
+    int nRays = width * height;
+    std::vector<float> org(3 * nRays), primary(3 * nRays), dir(3 * nRays);
+    std::vector<float> tHit[3];
+    std::vector<int> hitId[3];
+    for (int mode = 0; mode < 3; ++mode) {
+        tHit[mode].resize(nRays);
+        hitId[mode].resize(nRays);
+    }
+    std::vector<float> triVerts;
+    triangleVertsSoA(triangles, nTris, triVerts);
+
+    // Camera rays as generateRay makes them, with unit directions
+    float widthScale = float(baseWidth) / float(width);
+    float heightScale = float(baseHeight) / float(height);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            float rx = x * widthScale, ry = y * heightScale;
+            float cam[3];
+            cam[0] = raster2camera[0][0] * rx + raster2camera[0][1] * ry + raster2camera[0][3];
+            cam[1] = raster2camera[1][0] * rx + raster2camera[1][1] * ry + raster2camera[1][3];
+            cam[2] = raster2camera[2][3];
+            float *o = &org[3 * (y * width + x)], *d = &primary[3 * (y * width + x)];
+            float len = 0.f;
+            for (int a = 0; a < 3; ++a) {
+                d[a] = camera2world[a][0] * cam[0] + camera2world[a][1] * cam[1] +
+                    camera2world[a][2] * cam[2];
+                o[a] = camera2world[a][3] / camera2world[3][3];
+                len += d[a] * d[a];
+            }
+            len = sqrtf(len);
+            for (int a = 0; a < 3; ++a)
+                d[a] /= len;
+        }
+    }
+
+    static const float spreads[] = { 0.f, .01f, .03f, .1f, .3f, 1.f };
+    float crossover = -1.f;
+    unsigned int rng = 1;
+    for (unsigned int s = 0; s < sizeof(spreads) / sizeof(spreads[0]); ++s) {
+        float spread = spreads[s];
+        for (int i = 0; i < nRays; ++i) {
+            float r[3], len2;
+            do {
+                for (int a = 0; a < 3; ++a)
+                    r[a] = 2.f * (xorshift(rng) * (1.f / 4294967296.f)) - 1.f;
+                len2 = r[0] * r[0] + r[1] * r[1] + r[2] * r[2];
+            } while (len2 > 1.f || len2 < 1e-6f);
+            float invLen = 1.f / sqrtf(len2);
+            for (int a = 0; a < 3; ++a)
+                dir[3 * i + a] = (1.f - spread) * primary[3 * i + a] +
+                    spread * r[a] * invLen;
+        }
+
+        // Packets, one ray per lane, one ray per lane with SoA leaves
+        double minTime[3] = { 1e30, 1e30, 1e30 };
+        for (int mode = 0; mode < 3; ++mode) {
+            for (int i = 0; i < 3; ++i) {
+                reset_and_start_timer();
+                trace_rays_ispc_tasks(nRays, &org[0], &dir[0], &tHit[mode][0],
+                                      &hitId[mode][0], nodes, triangles,
+                                      (mode == 2) ? &triVerts[0] : NULL, nTris,
+                                      mode > 0);
+                double dt = get_elapsed_mcycles();
+                minTime[mode] = std::min(dt, minTime[mode]);
+            }
+        }
+        printf("[rt rays, spread %.2f]:\t\tpackets [%.3f], per lane [%.3f], "
+               "per lane + SoA leaves [%.3f] million cycles for %d rays\n",
+               spread, minTime[0], minTime[1], minTime[2], nRays);
+        int perLaneMismatches = countMismatches(nRays, &tHit[0][0], &hitId[0][0],
+                                                &tHit[1][0], &hitId[1][0], 0.f);
+        int soaMismatches = countMismatches(nRays, &tHit[0][0], &hitId[0][0],
+                                            &tHit[2][0], &hitId[2][0], 1e-4f);
+        printf("\t\t\t\t(hits differing from the packets: %d per lane, %d per "
+               "lane + SoA leaves)\n", perLaneMismatches, soaMismatches);
+        if (crossover < 0.f && std::min(minTime[1], minTime[2]) < minTime[0])
+            crossover = spread;
+    }
+    if (crossover >= 0.f)
+        printf("\t\t\t\t(one ray per lane is faster from spread %.2f on)\n",
+               crossover);
+    else
+        printf("\t\t\t\t(packets are faster at every spread)\n");
+}
+
+
 static void usage() {
-    fprintf(stderr, "rt [--scale=<factor>] <scene name base>\n");
+    fprintf(stderr, "rt [--scale=<factor>] [--build] [--wide=<4|8>] [--rays] <scene name base>\n"
+                    "rt [--scale=<factor>] [--wide=<4|8>] [--rays] --mesh=<obj file or raw triangle floats>\n");
     exit(1);
 }
 
 
 int main(int argc, char *argv[]) {
     float scale = 1.f;
-    const char *filename = NULL;
+    bool build = false, rays = false;
+    int bvhWidth = 0;
+    const char *filename = NULL, *meshname = NULL;
     for (int i = 1; i < argc; ++i) {
         if (strncmp(argv[i], "--scale=", 8) == 0) {
             scale = atof(argv[i] + 8);
             if (scale == 0.f)
                 usage();
         }
+        else if (strcmp(argv[i], "--build") == 0)
+            build = true;
+        else if (strcmp(argv[i], "--rays") == 0)
+            rays = true;
+        else if (strncmp(argv[i], "--mesh=", 7) == 0)
+            meshname = argv[i] + 7;
+        else if (strncmp(argv[i], "--wide=", 7) == 0) {
+            bvhWidth = atoi(argv[i] + 7);
+            if (bvhWidth != 4 && bvhWidth != 8)
+                usage();
+        }
         else if (filename != NULL)
             usage();
         else
             filename = argv[i];
     }
-    if (filename == NULL)
+    if ((filename == NULL) == (meshname == NULL))
         usage();
 
 #define READ(var, n)                                            \
@@ -124,80 +301,100 @@ int main(int argc, char *argv[]) {
         return 1;                                               \
     } else /* eat ; */                                                     
 
-    //
-    // Read the camera specification information from the camera file
-    //
-    char fnbuf[1024];
-    sprintf(fnbuf, "%s.camera", filename);
-    FILE *f = fopen(fnbuf, "rb");
-    if (!f) {
-        perror(fnbuf);
-        return 1;
-    }
-
-    //
-    // Nothing fancy, and trouble if we run on a big-endian system, just
-    // fread in the bits
-    //
     int baseWidth, baseHeight;
     float camera2world[4][4], raster2camera[4][4];
-    READ(baseWidth, 1);
-    READ(baseHeight, 1);
-    READ(camera2world[0][0], 16);
-    READ(raster2camera[0][0], 16);
-
-    //
-    // Read in the serialized BVH 
-    //
-    sprintf(fnbuf, "%s.bvh", filename);
-    f = fopen(fnbuf, "rb");
-    if (!f) {
-        perror(fnbuf);
-        return 1;
+    std::vector<LinearBVHNode> nodes;
+    std::vector<Triangle> triangles;
+    std::vector<float> soup;
+
+    if (meshname != NULL) {
+        if (!loadTriangleSoup(meshname, soup))
+            return 1;
+        if (soup.size() == 0) {
+            fprintf(stderr, "%s: no triangles\n", meshname);
+            return 1;
+        }
+        meshCamera(soup, baseWidth, baseHeight, camera2world, raster2camera);
+        build = true;
     }
+    else {
+        //
+        // Read the camera specification information from the camera file
+        //
+        char fnbuf[1024];
+        sprintf(fnbuf, "%s.camera", filename);
+        FILE *f = fopen(fnbuf, "rb");
+        if (!f) {
+            perror(fnbuf);
+            return 1;
+        }
 
-    // The BVH file starts with an int that gives the total number of BVH
-    // nodes
-    uint nNodes;
-    READ(nNodes, 1);
-
-    LinearBVHNode *nodes = new LinearBVHNode[nNodes];
-    for (unsigned int i = 0; i < nNodes; ++i) {
-        // Each node is 6x floats for a boox, then an integer for an offset
-        // to the second child node, then an integer that encodes the type
-        // of node, the total number of int it if a leaf node, etc.
-        float b[6];
-        READ(b[0], 6);
-        nodes[i].bounds[0][0] = b[0];
-        nodes[i].bounds[0][1] = b[1];
-        nodes[i].bounds[0][2] = b[2];
-        nodes[i].bounds[1][0] = b[3];
-        nodes[i].bounds[1][1] = b[4];
-        nodes[i].bounds[1][2] = b[5];
-        READ(nodes[i].offset, 1);
-        READ(nodes[i].nPrimitives, 1);
-        READ(nodes[i].splitAxis, 1);
-        READ(nodes[i].pad, 1);
-    }
+        //
+        // Nothing fancy, and trouble if we run on a big-endian system, just
+        // fread in the bits
+        //
+        READ(baseWidth, 1);
+        READ(baseHeight, 1);
+        READ(camera2world[0][0], 16);
+        READ(raster2camera[0][0], 16);
+
+        //
+        // Read in the serialized BVH 
+        //
+        sprintf(fnbuf, "%s.bvh", filename);
+        f = fopen(fnbuf, "rb");
+        if (!f) {
+            perror(fnbuf);
+            return 1;
+        }
+
+        // The BVH file starts with an int that gives the total number of BVH
+        // nodes
+        uint nNodes;
+        READ(nNodes, 1);
+
+        nodes.resize(nNodes);
+        for (unsigned int i = 0; i < nNodes; ++i) {
+            // Each node is 6x floats for a boox, then an integer for an offset
+            // to the second child node, then an integer that encodes the type
+            // of node, the total number of int it if a leaf node, etc.
+            float b[6];
+            READ(b[0], 6);
+            nodes[i].bounds[0][0] = b[0];
+            nodes[i].bounds[0][1] = b[1];
+            nodes[i].bounds[0][2] = b[2];
+            nodes[i].bounds[1][0] = b[3];
+            nodes[i].bounds[1][1] = b[4];
+            nodes[i].bounds[1][2] = b[5];
+            READ(nodes[i].offset, 1);
+            READ(nodes[i].nPrimitives, 1);
+            READ(nodes[i].splitAxis, 1);
+            READ(nodes[i].pad, 1);
+        }
 
-    // And then read the triangles 
-    uint nTris;
-    READ(nTris, 1);
-    Triangle *triangles = new Triangle[nTris];
-    for (uint i = 0; i < nTris; ++i) {
-        // 9x floats for the 3 vertices
-        float v[9];
-        READ(v[0], 9);
-        float *vp = v;
-        for (int j = 0; j < 3; ++j) {
-            triangles[i].p[j][0] = *vp++;
-            triangles[i].p[j][1] = *vp++;
-            triangles[i].p[j][2] = *vp++;
+        // And then read the triangles 
+        uint nTris;
+        READ(nTris, 1);
+        triangles.resize(nTris);
+        for (uint i = 0; i < nTris; ++i) {
+            // 9x floats for the 3 vertices
+            float v[9];
+            READ(v[0], 9);
+            float *vp = v;
+            for (int j = 0; j < 3; ++j) {
+                triangles[i].p[j][0] = *vp++;
+                triangles[i].p[j][1] = *vp++;
+                triangles[i].p[j][2] = *vp++;
+            }
+            // And create an object id
+            triangles[i].id = i+1;
+            soup.insert(soup.end(), v, v + 9);
         }
-        // And create an object id
-        triangles[i].id = i+1;
+        fclose(f);
+
+        printf("[bvh %s.bvh]:\t\t%d nodes, SAH cost %.2f\n", filename,
+               (int)nodes.size(), bvhSAHCost(&nodes[0]));
     }
-    fclose(f);
 
     int height = int(baseHeight * scale);
     int width = int(baseWidth * scale);
@@ -207,6 +404,34 @@ int main(int argc, char *argv[]) {
     int *id = new int[width*height];
     float *image = new float[width*height];
 
+    //
+    // With --build, time the prebuilt BVH with ispc + tasks first so the
+    // two trees can be compared, then replace it with one built here from
+    // its triangles.
+    //
+    double minTimePrebuilt = 0.;
+    if (build && meshname == NULL) {
+        minTimePrebuilt = 1e30;
+        for (int i = 0; i < 3; ++i) {
+            reset_and_start_timer();
+            raytrace_ispc_tasks(width, height, baseWidth, baseHeight, raster2camera,
+                                camera2world, image, id, &nodes[0], &triangles[0]);
+            double dt = get_elapsed_mcycles();
+            minTimePrebuilt = std::min(dt, minTimePrebuilt);
+        }
+        printf("[rt ispc + tasks, %s.bvh]:\t[%.3f] million cycles for %d x %d image\n",
+               filename, minTimePrebuilt, width, height);
+    }
+    if (build) {
+        int nTris = int(soup.size() / 9);
+        reset_and_start_timer();
+        buildBVH(&soup[0], nTris, nodes, triangles);
+        double buildTime = get_elapsed_mcycles();
+        printf("[bvh build]:\t\t\t[%.3f] million cycles for %d triangles, "
+               "%d nodes, SAH cost %.2f\n", buildTime, nTris, (int)nodes.size(),
+               bvhSAHCost(&nodes[0]));
+    }
+
     //
     // Run 3 iterations with ispc + 1 core, record the minimum time
     //
@@ -214,7 +439,7 @@ int main(int argc, char *argv[]) {
     for (int i = 0; i < 3; ++i) {
         reset_and_start_timer();
         raytrace_ispc(width, height, baseWidth, baseHeight, raster2camera, 
-                      camera2world, image, id, nodes, triangles);
+                      camera2world, image, id, &nodes[0], &triangles[0]);
         double dt = get_elapsed_mcycles();
         minTimeISPC = std::min(dt, minTimeISPC);
     }
@@ -233,7 +458,7 @@ int main(int argc, char *argv[]) {
     for (int i = 0; i < 3; ++i) {
         reset_and_start_timer();
         raytrace_ispc_tasks(width, height, baseWidth, baseHeight, raster2camera,
-                            camera2world, image, id, nodes, triangles);
+                            camera2world, image, id, &nodes[0], &triangles[0]);
         double dt = get_elapsed_mcycles();
         minTimeISPCtasks = std::min(dt, minTimeISPCtasks);
     }
@@ -245,6 +470,49 @@ int main(int argc, char *argv[]) {
     memset(id, 0, width*height*sizeof(int));
     memset(image, 0, width*height*sizeof(float));
 
+    //
+    // With --wide, collapse the BVH to 4 or 8 children per node and run
+    // the same two ispc versions on it
+    //
+    double minTimeWide = 0., minTimeWideTasks = 0.;
+    if (bvhWidth != 0) {
+        WideBVH wide;
+        reset_and_start_timer();
+        collapseBVH(&nodes[0], bvhWidth, wide);
+        double collapseTime = get_elapsed_mcycles();
+        printf("[bvh collapse]:\t\t\t[%.3f] million cycles for %d BVH%d nodes\n",
+               collapseTime, wide.nNodes, bvhWidth);
+
+        minTimeWide = 1e30;
+        for (int i = 0; i < 3; ++i) {
+            reset_and_start_timer();
+            raytrace_wide_ispc(width, height, baseWidth, baseHeight, raster2camera,
+                               camera2world, image, id, wide.nodes, bvhWidth,
+                               &triangles[0]);
+            double dt = get_elapsed_mcycles();
+            minTimeWide = std::min(dt, minTimeWide);
+        }
+        printf("[rt ispc, 1 core, BVH%d]:\t[%.3f] million cycles for %d x %d image\n",
+               bvhWidth, minTimeWide, width, height);
+
+        minTimeWideTasks = 1e30;
+        for (int i = 0; i < 3; ++i) {
+            reset_and_start_timer();
+            raytrace_wide_ispc_tasks(width, height, baseWidth, baseHeight,
+                                     raster2camera, camera2world, image, id,
+                                     wide.nodes, bvhWidth, &triangles[0]);
+            double dt = get_elapsed_mcycles();
+            minTimeWideTasks = std::min(dt, minTimeWideTasks);
+        }
+        printf("[rt ispc + tasks, BVH%d]:\t[%.3f] million cycles for %d x %d image\n",
+               bvhWidth, minTimeWideTasks, width, height);
+
+        writeImage(id, image, width, height, "rt-ispc-wide.ppm");
+
+        memset(id, 0, width*height*sizeof(int));
+        memset(image, 0, width*height*sizeof(float));
+    }
+
     //
     // And 3 iterations with the serial implementation, reporting the
     // minimum time.
@@ -253,7 +521,7 @@ int main(int argc, char *argv[]) {
     for (int i = 0; i < 3; ++i) {
         reset_and_start_timer();
         raytrace_serial(width, height, baseWidth, baseHeight, raster2camera, 
-                        camera2world, image, id, nodes, triangles);
+                        camera2world, image, id, &nodes[0], &triangles[0]);
         double dt = get_elapsed_mcycles();
         minTimeSerial = std::min(dt, minTimeSerial);
     }
@@ -262,7 +530,18 @@ int main(int argc, char *argv[]) {
     printf("\t\t\t\t(%.2fx speedup from ISPC, %.2fx speedup from ISPC + tasks)\n", 
            minTimeSerial / minTimeISPC, minTimeSerial / minTimeISPCtasks);
 
+    if (bvhWidth != 0)
+        printf("\t\t\t\t(%.2fx speedup from BVH%d with ISPC, %.2fx with ISPC + tasks)\n",
+               minTimeISPC / minTimeWide, bvhWidth, minTimeISPCtasks / minTimeWideTasks);
+    if (minTimePrebuilt > 0.)
+        printf("\t\t\t\t(%.2fx speedup from the built BVH with ISPC + tasks)\n",
+               minTimePrebuilt / minTimeISPCtasks);
+
     writeImage(id, image, width, height, "rt-serial.ppm");
 
+    if (rays)
+        rayBenchmark(width, height, baseWidth, baseHeight, raster2camera,
+                     camera2world, &nodes[0], &triangles[0], (int)triangles.size());
+
     return 0;
 }
@@ -43,6 +43,10 @@ extern "C" {
 #endif // __cplusplus
     extern void raytrace_ispc(int32_t width, int32_t height, int32_t baseWidth, int32_t baseHeight, const float raster2camera[][4], const float camera2world[][4], float * image, int32_t * id, const struct LinearBVHNode * nodes, const struct Triangle * triangles);
     extern void raytrace_ispc_tasks(int32_t width, int32_t height, int32_t baseWidth, int32_t baseHeight, const float raster2camera[][4], const float camera2world[][4], float * image, int32_t * id, const struct LinearBVHNode * nodes, const struct Triangle * triangles);
+    extern void raytrace_wide_ispc(int32_t width, int32_t height, int32_t baseWidth, int32_t baseHeight, const float raster2camera[][4], const float camera2world[][4], float * image, int32_t * id, const float * wideNodes, int32_t bvhWidth, const struct Triangle * triangles);
+    extern void raytrace_wide_ispc_tasks(int32_t width, int32_t height, int32_t baseWidth, int32_t baseHeight, const float raster2camera[][4], const float camera2world[][4], float * image, int32_t * id, const float * wideNodes, int32_t bvhWidth, const struct Triangle * triangles);
+    extern void trace_rays_ispc(int32_t nRays, const float * org, const float * dir, float * tHit, int32_t * hitId, const struct LinearBVHNode * nodes, const struct Triangle * triangles, const float * triVerts, int32_t nTris, int32_t perLane);
+    extern void trace_rays_ispc_tasks(int32_t nRays, const float * org, const float * dir, float * tHit, int32_t * hitId, const struct LinearBVHNode * nodes, const struct Triangle * triangles, const float * triVerts, int32_t nTris, int32_t perLane);
 #if defined(__cplusplus) && !defined(__ISPC_NO_EXTERN_C)
 } /* end extern C */
 #endif // __cplusplus
@@ -1,5 +1,8 @@
 #!/bin/bash
 
-./rt cornell
-./rt sponza
-./rt teapot
+for scene in cornell sponza teapot; do
+    ./rt $scene
+    ./rt --wide=4 $scene
+    ./rt --wide=8 $scene
+    ./rt --rays $scene
+done